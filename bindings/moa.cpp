@@ -1,12 +1,21 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 #include "utils/MOA.hpp"
 
 namespace py = pybind11;
 
 void bind_framework_moa(py::module &m) {
-    py::class_<neuro::MOA>(m, "MOA")
-        .def(py::init<>())
+    py::class_<neuro::MOA> moa(m, "MOA");
+
+    py::enum_<neuro::MOA::Engine>(moa, "Engine")
+        .value("MT19937",           neuro::MOA::MT19937)
+        .value("XOSHIRO256SS",      neuro::MOA::XOSHIRO256SS)
+        .export_values();
+
+    moa.def(py::init<>())
+        .def("Set_Engine",          &neuro::MOA::Set_Engine)
+        .def("Get_Engine",          &neuro::MOA::Get_Engine)
         .def("Random_Double",       &neuro::MOA::Random_Double)
         .def("Random_DoubleI",      &neuro::MOA::Random_DoubleI)
         .def("Random_Integer",      &neuro::MOA::Random_Integer)
@@ -14,7 +23,20 @@ void bind_framework_moa(py::module &m) {
         .def("Random_64",           &neuro::MOA::Random_64)
         .def("Random_128",          &neuro::MOA::Random_128)
         .def("Random_w",            &neuro::MOA::Random_W)
+        .def("Fill_Doubles",        [](neuro::MOA &r, size_t n) {
+            std::vector <double> v(n);
+            r.Fill_Doubles(v.data(), n);
+            return v;
+        })
+        .def("Fill_Normals",        [](neuro::MOA &r, size_t n, double mean, double stddev) {
+            std::vector <double> v(n);
+            r.Fill_Normals(v.data(), n, mean, stddev);
+            return v;
+        }, py::arg("n"), py::arg("mean") = 0.0, py::arg("stddev") = 1.0)
         .def("Seed",                &neuro::MOA::Seed)
+        .def("Substream",           &neuro::MOA::Substream, py::arg("i"))
+        .def("Split",               &neuro::MOA::Split, py::arg("k"))
+        .def("Jump",                &neuro::MOA::Jump)
         .def("Hash",                &neuro::MOA::Hash)
         .def("Get_State",           &neuro::MOA::Get_State)
         .def("Get_Counter",         &neuro::MOA::Get_Counter)
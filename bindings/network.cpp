@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -84,9 +85,18 @@ void bind_framework_network(py::module &m)
 		.def("add_node_property", &PropertyPack::add_node_property)
 		.def("add_edge_property", &PropertyPack::add_edge_property)
 		.def("add_network_property", &PropertyPack::add_network_property)
+		.def("node_handle", &PropertyPack::node_handle)
+		.def("edge_handle", &PropertyPack::edge_handle)
 		.def(py::self == py::self)
 		.def(py::self != py::self);
 
+	py::class_<PropertyHandle>(m, "PropertyHandle")
+		.def_readonly("index", &PropertyHandle::index)
+		.def_readonly("min_value", &PropertyHandle::min_value)
+		.def_readonly("max_value", &PropertyHandle::max_value)
+		.def_readonly("type", &PropertyHandle::type)
+		.def_readonly("name", &PropertyHandle::name);
+
 	py::class_<Node>(m, "Node")
 		.def(py::init<uint32_t, Network*>(), py::arg("idx"), py::arg("n") = nullptr)
 		.def_readonly("id", &Node::id)
@@ -102,6 +112,10 @@ void bind_framework_network(py::module &m)
 		.def("set", py::overload_cast<const string&, double>(&Node::set))
 		.def("get", py::overload_cast<int>(&Node::get))
 		.def("get", py::overload_cast<const string&>(&Node::get))
+		.def("set", py::overload_cast<const PropertyHandle&, double>(&Node::set))
+		.def("get", py::overload_cast<const PropertyHandle&>(&Node::get))
+		.def("get_values", &Node::get_values)
+		.def("set_values", &Node::set_values)
 		.def("is_hidden", &Node::is_hidden)
 		.def("is_input", &Node::is_input)
 		.def("is_output", &Node::is_output);
@@ -119,11 +133,54 @@ void bind_framework_network(py::module &m)
 		.def("set", py::overload_cast<int, double>(&Edge::set))
 		.def("set", py::overload_cast<const string&, double>(&Edge::set))
 		.def("get", py::overload_cast<int>(&Edge::get))
-		.def("get", py::overload_cast<const string&>(&Edge::get));
+		.def("get", py::overload_cast<const string&>(&Edge::get))
+		.def("set", py::overload_cast<const PropertyHandle&, double>(&Edge::set))
+		.def("get", py::overload_cast<const PropertyHandle&>(&Edge::get))
+		.def("get_values", &Edge::get_values)
+		.def("set_values", &Edge::set_values);
+
+	py::class_<NetworkPatch>(m, "NetworkPatch")
+		.def(py::init<>())
+		.def_readwrite("removed_nodes", &NetworkPatch::removed_nodes)
+		.def_readwrite("removed_edges", &NetworkPatch::removed_edges)
+		.def_readwrite("io_changed", &NetworkPatch::io_changed)
+		.def_readwrite("inputs", &NetworkPatch::inputs)
+		.def_readwrite("outputs", &NetworkPatch::outputs)
+		.def("empty", &NetworkPatch::empty)
+		.def("structure_changed", &NetworkPatch::structure_changed)
+		.def("as_json", &NetworkPatch::as_json)
+		.def("from_json", &NetworkPatch::from_json);
+
+	py::class_<NetworkHash>(m, "NetworkHash")
+		.def(py::init<>())
+		.def_readwrite("hi", &NetworkHash::hi)
+		.def_readwrite("lo", &NetworkHash::lo)
+		.def("as_string", &NetworkHash::as_string)
+		.def("__eq__", &NetworkHash::operator==)
+		.def("__hash__", [](const NetworkHash &h) { return std::hash<NetworkHash>()(h); })
+		.def("__repr__", &NetworkHash::as_string);
+
+	py::class_<NetworkAnalysis>(m, "NetworkAnalysis")
+		.def(py::init<>())
+		.def_readonly("components", &NetworkAnalysis::components)
+		.def_readonly("cycles", &NetworkAnalysis::cycles)
+		.def_readonly("levels", &NetworkAnalysis::levels)
+		.def_readonly("critical_delay", &NetworkAnalysis::critical_delay)
+		.def_readonly("critical_path", &NetworkAnalysis::critical_path)
+		.def_readonly("exact", &NetworkAnalysis::exact)
+		.def_readonly("io_cycles", &NetworkAnalysis::io_cycles)
+		.def_readonly("max_edge_delay", &NetworkAnalysis::max_edge_delay)
+		.def_readonly("fan_in", &NetworkAnalysis::fan_in)
+		.def_readonly("fan_out", &NetworkAnalysis::fan_out)
+		.def("as_json", &NetworkAnalysis::as_json);
 
 	py::class_<Network>(m, "Network")
 		.def(py::init<>())
 		.def("__eq__", &Network::operator==)
+		.def("diff", &Network::diff, py::arg("target"))
+		.def("apply_patch", &Network::apply_patch, py::arg("patch"))
+		.def("hash", &Network::hash)
+		.def("analyze", &Network::analyze, py::arg("delay_name") = "Delay")
 
 		.def("read_from_file", [](Network &net, const string& fname) {
             std::ifstream fs(fname);
@@ -145,6 +202,21 @@ void bind_framework_network(py::module &m)
 		.def("pretty_json", &Network::pretty_json)
 		.def("pretty_nodes", &Network::pretty_nodes)
 		.def("pretty_edges", &Network::pretty_edges)
+		.def("write_binary", &Network::write_binary, py::arg("filename"))
+		.def("read_binary", &Network::read_binary, py::arg("filename"))
+		.def("to_binary", [](const Network &self) {
+			vector<uint8_t> buf;
+			self.to_binary(buf);
+			return py::bytes((const char *) buf.data(), buf.size());
+		})
+		.def("from_binary", [](Network &self, const py::bytes &b) {
+			neuro::NetworkImage img;
+			string s = b;
+			vector<uint64_t> aligned((s.size() + 7) / 8);    // The image must be 8-byte aligned
+			memcpy(aligned.data(), s.data(), s.size());
+			img.attach(aligned.data(), s.size());
+			self.from_binary(img);
+		}, py::arg("data"))
 		.def("set_properties", &Network::set_properties)
 		.def("get_properties", &Network::get_properties)
 		.def("is_node_property", &Network::is_node_property)
@@ -153,11 +225,22 @@ void bind_framework_network(py::module &m)
 		.def("get_node_property", &Network::get_node_property, py::return_value_policy::reference)
 		.def("get_edge_property", &Network::get_edge_property, py::return_value_policy::reference)
 		.def("get_network_property", &Network::get_network_property, py::return_value_policy::reference)
+		.def("node_handle", &Network::node_handle)
+		.def("edge_handle", &Network::edge_handle)
+		.def("get_all", [](Network &self, const PropertyHandle &h) {
+			vector <double> vals;
+			self.get_all(h, vals);
+			return vals;
+		}, py::arg("h"))
 		.def("add_node", &Network::add_node, py::return_value_policy::reference)
 		.def("is_node", &Network::is_node)
 		.def("get_node", &Network::get_node, py::return_value_policy::reference)
 		.def("add_or_get_node", &Network::add_or_get_node)
 		.def("remove_node", &Network::remove_node)
+		.def("remove_nodes", &Network::remove_nodes, py::arg("ids"), py::arg("force") = false)
+		.def("reserve", &Network::reserve, py::arg("nodes"), py::arg("edges"))
+		.def("add_nodes", &Network::add_nodes, py::arg("ids"))
+		.def("add_edges", &Network::add_edges, py::arg("edges"))
 		.def("rename_node", &Network::rename_node)
 		.def("add_edge", &Network::add_edge, py::return_value_policy::reference)
 		.def("is_edge", &Network::is_edge)
@@ -178,6 +261,8 @@ void bind_framework_network(py::module &m)
 
 		.def("get_random_node", &Network::get_random_node)
 		.def("get_random_edge", &Network::get_random_edge)
+		.def("get_random_nodes", &Network::get_random_nodes, py::return_value_policy::reference)
+		.def("get_random_edges", &Network::get_random_edges, py::return_value_policy::reference)
 		.def("get_random_input", &Network::get_random_input)
 		.def("get_random_output", &Network::get_random_output)
 
@@ -190,9 +275,13 @@ void bind_framework_network(py::module &m)
 		.def("randomize_property", py::overload_cast<neuro::MOA&, Edge*, const string&>(&Network::randomize_property))
 		.def("randomize_property", py::overload_cast<neuro::MOA&, const Property&, std::vector<double>&>(&Network::randomize_property))
 
-		.def("randomize", &Network::randomize)
+		.def("randomize", py::overload_cast<const json&>(&Network::randomize))
+		.def("randomize", py::overload_cast<const json&, neuro::MOA&>(&Network::randomize))
 		.def("prune", &Network::prune)
 		.def("make_sorted_node_vector", &Network::make_sorted_node_vector)
+		.def("enable_columns", &Network::enable_columns)
+		.def("disable_columns", &Network::disable_columns)
+		.def("columns_enabled", &Network::columns_enabled)
 		.def_readonly("sorted_node_vector", &Network::sorted_node_vector)
 		.def("get_node_map", [](Network &self) {
 				py::dict dict;
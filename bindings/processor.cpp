@@ -1,6 +1,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
+#include <pybind11/numpy.h>
 #include "pybind_json.hpp"
 
 #include "framework.hpp"
@@ -139,6 +140,58 @@ namespace neuro
             PYBIND11_OVERLOAD_PURE(void, Processor, clear_activity, network_id);
         }
 
+        void open_spike_streams(size_t capacity, int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(void, Processor, open_spike_streams, capacity, network_id);
+        }
+
+        SpikeStream *input_stream(int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(SpikeStream *, Processor, input_stream, network_id);
+        }
+
+        SpikeStream *output_stream(int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(SpikeStream *, Processor, output_stream, network_id);
+        }
+
+        void set_synapse_weights(const vector<uint32_t> &pres, const vector<uint32_t> &posts,
+                                 const vector<double> &vals, int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(void, Processor, set_synapse_weights, pres, posts, vals, network_id);
+        }
+
+        void set_neuron_thresholds(const vector<uint32_t> &ids, const vector<double> &vals,
+                                   int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(void, Processor, set_neuron_thresholds, ids, vals, network_id);
+        }
+
+        bool apply_network_patch(const NetworkPatch &patch, int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(bool, Processor, apply_network_patch, patch, network_id);
+        }
+
+        void clone_network(int src_network_id, int dst_network_id) override
+        {
+            PYBIND11_OVERLOAD(void, Processor, clone_network, src_network_id, dst_network_id);
+        }
+
+        BatchResult run_batch(const SpikeBatch &batch, double duration, int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(BatchResult, Processor, run_batch, batch, duration, network_id);
+        }
+
+        vector<uint8_t> save_state(int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(vector<uint8_t>, Processor, save_state, network_id);
+        }
+
+        void restore_state(const vector<uint8_t> &state, int network_id = 0) override
+        {
+            PYBIND11_OVERLOAD(void, Processor, restore_state, state, network_id);
+        }
+
         PropertyPack get_network_properties() const override
         {
 				PYBIND11_OVERLOAD_PURE(PropertyPack, Processor, get_network_properties);
@@ -175,8 +228,6 @@ namespace neuro
 		using std::vector;
 		using std::string;
 
-		// TODO: Add Batch operations
-
 		/* Spikes are essentially 3-tuples of id, time, and value */
 		py::class_<neuro::Spike>(m, "Spike")
 			.def(py::init<int,double,double>(), py::arg("id"), py::arg("time"), py::arg("value"))
@@ -184,6 +235,64 @@ namespace neuro
 			.def_readwrite("time", &neuro::Spike::time)
 			.def_readwrite("value", &neuro::Spike::value);
 
+		/* SpikeBatches hold spikes as arrays of input ids, times and values, optionally split
+		   into samples for run_batch().  add_sample() takes a list of Spikes, or three NumPy
+		   arrays (int32 ids, int32 times, float64 values), or nothing, followed by add_spike(). */
+		py::class_<neuro::SpikeBatch>(m, "SpikeBatch")
+			.def(py::init<>())
+			.def_readwrite("ids", &neuro::SpikeBatch::ids)
+			.def_readwrite("times", &neuro::SpikeBatch::times)
+			.def_readwrite("values", &neuro::SpikeBatch::values)
+			.def_readwrite("starts", &neuro::SpikeBatch::starts)
+			.def_readwrite("normalized", &neuro::SpikeBatch::normalized)
+			.def("add_sample", (void (neuro::SpikeBatch::*)()) &neuro::SpikeBatch::add_sample)
+			.def("add_sample", (void (neuro::SpikeBatch::*)(const vector<neuro::Spike>&)) &neuro::SpikeBatch::add_sample,
+					py::arg("spikes"))
+			.def("add_sample", [](neuro::SpikeBatch &b,
+			                      py::array_t<int32_t, py::array::c_style | py::array::forcecast> ids,
+			                      py::array_t<int32_t, py::array::c_style | py::array::forcecast> times,
+			                      py::array_t<double, py::array::c_style | py::array::forcecast> values) {
+				if (ids.size() != times.size() || ids.size() != values.size()) {
+					throw std::runtime_error("SpikeBatch.add_sample() - ids, times and values must be the same size");
+				}
+				b.add_sample(ids.data(), times.data(), values.data(), ids.size());
+			}, py::arg("ids"), py::arg("times"), py::arg("values"))
+			.def("add_spike", (void (neuro::SpikeBatch::*)(int32_t, int32_t, double)) &neuro::SpikeBatch::add_spike,
+					py::arg("id"), py::arg("time"), py::arg("value"))
+			.def("add_spike", (void (neuro::SpikeBatch::*)(const neuro::Spike&)) &neuro::SpikeBatch::add_spike,
+					py::arg("spike"))
+			.def("num_spikes", &neuro::SpikeBatch::num_spikes)
+			.def("num_samples", &neuro::SpikeBatch::num_samples)
+			.def("clear", &neuro::SpikeBatch::clear);
+
+		py::class_<neuro::BatchResult>(m, "BatchResult")
+			.def_readonly("num_samples", &neuro::BatchResult::num_samples)
+			.def_readonly("num_outputs", &neuro::BatchResult::num_outputs)
+			.def_readonly("counts", &neuro::BatchResult::counts)
+			.def_readonly("last_fires", &neuro::BatchResult::last_fires)
+			.def("count", &neuro::BatchResult::count, py::arg("sample"), py::arg("output"))
+			.def("last_fire", &neuro::BatchResult::last_fire, py::arg("sample"), py::arg("output"));
+
+		/* The streaming spike ports.  pop() returns (id, time, value), or None if the
+		   stream is empty. */
+		py::class_<neuro::SpikeStream>(m, "SpikeStream")
+			.def("push", [](neuro::SpikeStream &ss, int id, uint32_t time, double value) {
+				neuro::StreamSpike s;
+				s.id = id;
+				s.time = time;
+				s.value = value;
+				return ss.push(s);
+			}, py::arg("id"), py::arg("time"), py::arg("value"))
+			.def("pop", [](neuro::SpikeStream &ss) -> py::object {
+				neuro::StreamSpike s;
+				if (!ss.pop(s)) return py::none();
+				return py::make_tuple(s.id, s.time, s.value);
+			})
+			.def("size", &neuro::SpikeStream::size)
+			.def("capacity", &neuro::SpikeStream::capacity)
+			.def("dropped", &neuro::SpikeStream::dropped)
+			.def("rejected", &neuro::SpikeStream::rejected);
+
 		/* Requires a trampoline class for override/inheritance of virutal methods */
 		py::class_<neuro::Processor, neuro::PyProcessor>(m, "Processor")
 			.def(py::init<>())
@@ -207,6 +316,9 @@ namespace neuro
 			.def("apply_spikes",        (void (neuro::Processor::*)(const vector<neuro::Spike>&, bool, int)) &neuro::Processor::apply_spikes,
 					py::arg("spikes"), py::arg("normalized") = true, py::arg("network_id") = 0)
 
+			.def("apply_spikes",        (void (neuro::Processor::*)(const neuro::SpikeBatch&, int)) &neuro::Processor::apply_spikes,
+					py::arg("batch"), py::arg("network_id") = 0)
+
 			.def("run",                 (void (neuro::Processor::*)(double, int)) &neuro::Processor::run,
 					py::arg("duration"), py::arg("network_id") = 0)
 
@@ -231,16 +343,42 @@ namespace neuro
 			.def("clear_activity",      &neuro::Processor::clear_activity,
 					py::arg("network_id") = 0)
 
+			.def("open_spike_streams",  &neuro::Processor::open_spike_streams,
+					py::arg("capacity"), py::arg("network_id") = 0)
+
+			.def("input_stream",        &neuro::Processor::input_stream,
+					py::return_value_policy::reference_internal, py::arg("network_id") = 0)
+
+			.def("output_stream",       &neuro::Processor::output_stream,
+					py::return_value_policy::reference_internal, py::arg("network_id") = 0)
+
+			.def("run_batch",           &neuro::Processor::run_batch,
+					py::arg("batch"), py::arg("duration"), py::arg("network_id") = 0)
+
+			.def("clone_network",       &neuro::Processor::clone_network,
+					py::arg("src_network_id"), py::arg("dst_network_id"))
+
+			.def("save_state", [](neuro::Processor &proc, int network_id) {
+				vector <uint8_t> state = proc.save_state(network_id);
+				return py::bytes((const char *) state.data(), state.size());
+			}, py::arg("network_id") = 0)
+
+			.def("restore_state", [](neuro::Processor &proc, py::bytes b, int network_id) {
+				string s = b;
+				vector <uint8_t> state(s.begin(), s.end());
+				proc.restore_state(state, network_id);
+			}, py::arg("state"), py::arg("network_id") = 0)
+
 			.def("output_count",        &neuro::Processor::output_count,
 					py::arg("output_id"), py::arg("network_id") = 0)
 
-			.def("output_counts",        &neuro::Processor::output_counts,
+			.def("output_counts",        (vector<int> (neuro::Processor::*)(int)) &neuro::Processor::output_counts,
 					py::arg("network_id") = 0)
 
 			.def("output_vector",       &neuro::Processor::output_vector,
 					py::arg("output_id"), py::arg("network_id") = 0)
 
-			.def("output_vectors",       &neuro::Processor::output_vectors,
+			.def("output_vectors",       (vector< vector<double> > (neuro::Processor::*)(int)) &neuro::Processor::output_vectors,
 					py::arg("network_id") = 0)
 
 			.def("total_neuron_counts",  &neuro::Processor::total_neuron_counts,
@@ -249,17 +387,42 @@ namespace neuro
 			.def("total_neuron_accumulates", &neuro::Processor::total_neuron_accumulates,
 					py::arg("network_id") = 0)
 
-			.def("neuron_counts",      &neuro::Processor::neuron_counts,
+			.def("neuron_counts",      (vector<int> (neuro::Processor::*)(int)) &neuro::Processor::neuron_counts,
 					py::arg("network_id") = 0)
 
 			.def("neuron_vectors",      &neuro::Processor::neuron_vectors,
 					py::arg("network_id") = 0)
 
-			.def("neuron_last_fires",      &neuro::Processor::neuron_last_fires,
+			.def("neuron_last_fires",      (vector<double> (neuro::Processor::*)(int)) &neuro::Processor::neuron_last_fires,
 					py::arg("network_id") = 0)
 
-			.def("neuron_charges",      &neuro::Processor::neuron_charges,
+			.def("neuron_charges",      (vector<double> (neuro::Processor::*)(int)) &neuro::Processor::neuron_charges,
 					py::arg("network_id") = 0)
+
+			/* These write into NumPy arrays that you allocate once, and return the number
+			   of entries written.  The arrays must be contiguous and have the right dtype
+			   (int32 for counts, float64 for times and charges, uintp for output_vectors'
+			   counts) -- they aren't converted, since the results would go into a copy. */
+
+			.def("output_last_fires_into", [](neuro::Processor &proc, py::array_t<double, py::array::c_style> out, int network_id) {
+				return proc.output_last_fires(out.mutable_data(), out.size(), network_id);
+			}, py::arg("out").noconvert(), py::arg("network_id") = 0)
+			.def("output_counts_into", [](neuro::Processor &proc, py::array_t<int, py::array::c_style> out, int network_id) {
+				return proc.output_counts(out.mutable_data(), out.size(), network_id);
+			}, py::arg("out").noconvert(), py::arg("network_id") = 0)
+			.def("output_vectors_into", [](neuro::Processor &proc, py::array_t<double, py::array::c_style> times,
+			                               py::array_t<size_t, py::array::c_style> counts, int network_id) {
+				return proc.output_vectors(times.mutable_data(), times.size(), counts.mutable_data(), counts.size(), network_id);
+			}, py::arg("times").noconvert(), py::arg("counts").noconvert(), py::arg("network_id") = 0)
+			.def("neuron_counts_into", [](neuro::Processor &proc, py::array_t<int, py::array::c_style> out, int network_id) {
+				return proc.neuron_counts(out.mutable_data(), out.size(), network_id);
+			}, py::arg("out").noconvert(), py::arg("network_id") = 0)
+			.def("neuron_last_fires_into", [](neuro::Processor &proc, py::array_t<double, py::array::c_style> out, int network_id) {
+				return proc.neuron_last_fires(out.mutable_data(), out.size(), network_id);
+			}, py::arg("out").noconvert(), py::arg("network_id") = 0)
+			.def("neuron_charges_into", [](neuro::Processor &proc, py::array_t<double, py::array::c_style> out, int network_id) {
+				return proc.neuron_charges(out.mutable_data(), out.size(), network_id);
+			}, py::arg("out").noconvert(), py::arg("network_id") = 0)
 			.def("synapse_weights", [](neuro::Processor &proc, int network_id = 0) {
 				vector <uint32_t> pres;
 				vector <uint32_t> posts;
@@ -267,6 +430,12 @@ namespace neuro
 				proc.synapse_weights(pres, posts, vals, network_id);
 				return make_tuple(pres, posts, vals);
 			},  py::arg("network_id")=0)
+			.def("set_synapse_weights", &neuro::Processor::set_synapse_weights,
+					py::arg("pres"), py::arg("posts"), py::arg("vals"), py::arg("network_id") = 0)
+			.def("set_neuron_thresholds", &neuro::Processor::set_neuron_thresholds,
+					py::arg("ids"), py::arg("vals"), py::arg("network_id") = 0)
+			.def("apply_network_patch", &neuro::Processor::apply_network_patch,
+					py::arg("patch"), py::arg("network_id") = 0)
 			/* Below are extra methods provided for ease of use and performance reasons. */
 
         /* Apply binary data as a spikes for each bit place.*/
@@ -34,6 +34,9 @@ void bind_processor_help(py::module &m) {
 	m.def("run_and_track", &neuro::run_and_track,
 		py::arg("duration"), py::arg("p"), py::arg("network_id") = 0);
 
+	m.def("run_realtime", &neuro::run_realtime,
+		py::arg("duration"), py::arg("timestep_period"), py::arg("p"), py::arg("network_id") = 0);
+
 	m.def("apply_spike_raster", &neuro::apply_spike_raster,
 		py::arg("p"), py::arg("in_neuron"), py::arg("sr"), py::arg("network_id") = 0);
 
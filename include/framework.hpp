@@ -7,10 +7,13 @@
 #include <memory>
 #include <exception>
 #include <stdexcept>
+#include <functional>
 
 #include "robinhood/robin_map.h"
 #include "nlohmann/json.hpp"
 #include "utils/MOA.hpp"
+#include "utils/spsc_ring.hpp"
+#include "utils/slab_pool.hpp"
 
 /** 
  * The neuro namespace contains all of the classes defined by and used by the TENNLab
@@ -32,6 +35,7 @@ using std::vector;
 using std::pair;
 using std::tuple;
 using std::unique_ptr;
+using std::shared_ptr;
 using nlohmann::json;
 
 class Property; 
@@ -39,6 +43,10 @@ class PropertyPack;
 class Node;
 class Edge;
 class Network;
+class NetworkPatch;
+struct NetworkHash;
+struct NetworkAnalysis;
+class NetworkImage;
 class Processor;
 struct Spike;
 
@@ -80,9 +88,13 @@ public:
     }
 };
 
-/* Use Hash Tables for storing a sparse collection of nodes / edges */
-typedef tsl::robin_map<uint32_t, unique_ptr<Node>, int_hash> NodeMap;
-typedef tsl::robin_map<Coords, unique_ptr<Edge>, coord_hash> EdgeMap;
+/* Use Hash Tables for storing a sparse collection of nodes / edges.  The nodes and
+   edges themselves come from the network's Slab_Pools, so the unique_ptr's have
+   deleters that give them back to the pool. */
+typedef unique_ptr<Node, Slab_Deleter<Node> > NodePtr;
+typedef unique_ptr<Edge, Slab_Deleter<Edge> > EdgePtr;
+typedef tsl::robin_map<uint32_t, NodePtr, int_hash> NodeMap;
+typedef tsl::robin_map<Coords, EdgePtr, coord_hash> EdgeMap;
 
 /* TMP + Perfect Forwarding for C++11 // built into C++14 */
 template<typename T, typename... Args>
@@ -145,6 +157,29 @@ public:
 bool operator==(const Property &lhs, const Property &rhs);
 bool operator!=(const Property &lhs, const Property &rhs);
 
+/**
+ * A PropertyHandle is a node or edge property that has been looked up once, by name, in a
+ * PropertyPack.  Node::get()/set() and Network::get_all() take these, and they don't have
+ * to look anything up, so use them when you're touching a lot of nodes or edges.
+ * A handle is only good for networks that have the PropertyPack it came from.
+ */
+class PropertyHandle
+{
+public:
+    enum Kind : signed char
+    {
+        NODE = 'N',
+        EDGE = 'E',
+    };
+
+    Kind kind;                       /**< Is this a node or an edge property? */
+    int index;                       /**< Index in the values vector */
+    double min_value;                /**< The property's minimum value */
+    double max_value;                /**< The property's maximum value */
+    Property::Type type;             /**< Integer/Boolean/Double */
+    string name;                     /**< For error messages */
+};
+
 /**
  * A PropertyPack encompasses a grouping of properties for a node, edge, and network 
  * all within the same structure. This ensures you have a coherent set of properties which 
@@ -192,6 +227,11 @@ public:
     int add_edge_property(const string& name, double dmin, double dmax, Property::Type type, int cnt = 1);
     int add_network_property(const string& name, double dmin, double dmax, Property::Type type, int cnt = 1);
 
+    /* Look up a node or edge property once, for Node/Edge get()/set().  These throw if
+       there's no such property. */
+
+    PropertyHandle node_handle(const string& name) const;
+    PropertyHandle edge_handle(const string& name) const;
 };
 
 bool operator==(const PropertyPack &lhs, const PropertyPack &rhs);
@@ -227,13 +267,18 @@ public:
     vector<Edge*> outgoing;         /**< Outgoing edges */
     vector <double> coordinates;    /**< Optional -- useful if you are writing or using a visualization */
     string name;                    /**< Optional -- can be useful for viz's or hand-tooling networks */
+    uint32_t column_slot = 0;       /**< Index into column_nodes(), and the column store */
 
-    /* Getting / Setting values */
+    /* Getting / Setting values.  These work whether or not the network's column store is on. */
 
     void set(int idx, double val);              /**< Set a value by its index in values */
     void set(const string& name, double val);   /**< Set a value by its name in the PropertyPack */
     double get(int idx);                        /**< Get a value by index. */
     double get(const string& name);             /**< Get a value by name. */
+    void set(const PropertyHandle& h, double val); /**< Set a value by its handle */
+    double get(const PropertyHandle& h);        /**< Get a value by its handle */
+    vector <double> get_values() const;         /**< Get all of the values */
+    void set_values(const vector <double> &v);  /**< Set all of the values */
 
     /* Hidden / Input / Output */
 
@@ -274,13 +319,120 @@ public:
     vector<double> values;              /**< Values defined by the PropertyPack */
     json as_json() const;               /**< Turn it into a json object */
     vector <double> control_point;      /**< Optional. Bezier control point(s) for displaying. */
+    uint32_t column_slot = 0;           /**< Index into column_edges(), and the column store */
 
-    /* Getting / Setting values */
+    /* Getting / Setting values.  These work whether or not the network's column store is on. */
 
     void set(int idx, double val);              /**< Set a value by its index in values */
     void set(const string& name, double val);   /**< Set a value by its name in the PropertyPack */
     double get(int idx);                        /**< Get a value by index. */
     double get(const string& name);             /**< Get a value by name. */
+    void set(const PropertyHandle& h, double val); /**< Set a value by its handle */
+    double get(const PropertyHandle& h);        /**< Get a value by its handle */
+    vector <double> get_values() const;         /**< Get all of the values */
+    void set_values(const vector <double> &v);  /**< Set all of the values */
+};
+
+/**
+ * A NetworkPatch holds the differences between two networks that have the same
+ * PropertyPack.  Network::diff() makes one, and Network::apply_patch() applies it.
+ * Processors may apply one to a network that they have loaded, with
+ * Processor::apply_network_patch().  Please see markdown/network.md.
+ */
+
+class NetworkPatch
+{
+public:
+    struct NodeValues {
+        uint32_t id;
+        vector <double> values;
+    };
+
+    struct EdgeValues {
+        uint32_t from;
+        uint32_t to;
+        vector <double> values;
+    };
+
+    vector <uint32_t> removed_nodes;                      /**< Sorted by id */
+    vector < pair <uint32_t, uint32_t> > removed_edges;   /**< Includes the removed nodes' edges */
+    vector <NodeValues> added_nodes;
+    vector <EdgeValues> added_edges;
+    vector <NodeValues> changed_nodes;                    /**< Nodes whose values changed */
+    vector <EdgeValues> changed_edges;                    /**< Edges whose values changed */
+
+    bool io_changed = false;             /**< If true, these are the new inputs and outputs */
+    vector <uint32_t> inputs;
+    vector <uint32_t> outputs;
+
+    bool values_changed = false;         /**< If true, these are the new network values */
+    vector <double> network_values;
+
+    bool data_changed = false;           /**< If true, this is the new associated data */
+    json associated_data;
+
+    bool empty() const;                  /**< Are the networks the same? */
+    bool structure_changed() const;      /**< Are nodes added/removed, or inputs/outputs changed? */
+    json as_json() const;                /**< The JSON is described in markdown/network.md */
+    void from_json(const json &j);
+};
+
+/**
+ * A 128-bit hash of a network, from Network::hash().  Two networks with the same
+ * PropertyPack, nodes, edges, values, inputs and outputs have the same hash, no matter
+ * how they were built.  Please see markdown/network.md.
+ */
+
+struct NetworkHash
+{
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const NetworkHash &h) const { return (hi == h.hi && lo == h.lo); }
+    bool operator!=(const NetworkHash &h) const { return !(*this == h); }
+    bool operator<(const NetworkHash &h) const { return (hi < h.hi || (hi == h.hi && lo < h.lo)); }
+    string as_string() const;            /**< 32 hex digits */
+};
+
+/**
+ * The structure of a network's graph, from Network::analyze().  Ids are sorted, and
+ * ties are broken by id, so the same network always gives the same analysis, no matter
+ * how it was built.  Please see markdown/network.md.
+ */
+
+struct NetworkAnalysis
+{
+    /* The strongly connected components, in topological order: every edge between two
+       components goes from an earlier one to a later one.  A node that isn't on a cycle
+       is a component by itself.  cycles holds the components that are cycles (more
+       than one node, or one node with an edge to itself). */
+
+    vector < vector <uint32_t> > components;
+    vector < vector <uint32_t> > cycles;
+
+    /* levels[0] holds the nodes with no incoming edges from other components, and the rest
+       of the nodes are one level past their deepest predecessor.  A component's nodes
+       all have the same level. */
+
+    vector < vector <uint32_t> > levels;
+
+    /* The longest simple input -> output path, where an edge's length is its delay (or 1
+       if there's no delay property).  Components with more than 12 nodes are crossed
+       by their shortest paths, and then exact is false, because critical_delay is only
+       a lower bound.  If no output can be reached from an input, critical_delay is -1
+       and critical_path is empty.  If io_cycles is true, then there is a cycle on some
+       input -> output path, so activity can go around it forever. */
+
+    double critical_delay = -1;
+    vector <uint32_t> critical_path;     /**< From the input to the output */
+    bool exact = true;
+    bool io_cycles = false;
+    double max_edge_delay = 0;           /**< 0 if there are no edges */
+
+    vector <size_t> fan_in;              /**< fan_in[k] is the number of nodes with k incoming edges */
+    vector <size_t> fan_out;             /**< fan_out[k] is the number with k outgoing edges */
+
+    json as_json() const;                /**< The JSON is described in markdown/network.md */
 };
 
 /**
@@ -305,6 +457,25 @@ public:
 
     bool operator==(const Network &rhs) const;
 
+    /* diff() returns the patch that turns this network into target, which must have
+       the same PropertyPack.  Names, coordinates and control points are ignored.
+       apply_patch() makes the changes.  */
+
+    NetworkPatch diff(const Network &target) const;
+    void apply_patch(const NetworkPatch &patch);
+
+    /* A canonical hash of the PropertyPack, nodes, edges, values, inputs, outputs and network
+       values (not the associated data, names or coordinates).  It's kept up to date as
+       nodes and edges change, so calling it again is cheap.  See markdown/network.md. */
+
+    NetworkHash hash() const;
+
+    /* Levelize the graph, find its cycles, its longest input -> output path and its fan-in
+       and fan-out histograms.  Edge delays come from the edge property delay_name.  This
+       is linear in the size of the network, plus sorting the ids.  */
+
+    NetworkAnalysis analyze(const string &delay_name = "Delay") const;
+
     void clear(bool include_properties); /**< Clear network, optionally clear properties. */
 
     /* JSON methods */
@@ -312,10 +483,20 @@ public:
     void to_json(json &j) const;       /**< Add keys/vals to existing json */
     json as_json() const;              /**< Return json representation */
     void from_json(const json &j);     /**< Create from json */
+    void from_json_stream(std::istream &in);  /**< Create from json text, without a json DOM */
 
     string pretty_json() const;        /**< Create a json string that's better than dump(). */
     string pretty_nodes() const;       /**< Create a nice json string of the nodes. */
     string pretty_edges() const;       /**< Create a nice json string of the edges. */
+    void write_json(std::ostream &out, bool pretty = false) const;  /**< Write as_json().dump()
+                                                                      or pretty_json() */
+
+    /* Binary methods.  The format is in markdown/network_binary_format.md */
+
+    void to_binary(vector<uint8_t> &buf) const;   /**< Create the binary image in buf */
+    void from_binary(const NetworkImage &img);    /**< Create from a binary image */
+    void write_binary(const string &filename) const;  /**< to_binary() into a file */
+    void read_binary(const string &filename);     /**< mmap() the file and from_binary() */
 
     /* Properties / PropertyPack */
 
@@ -329,6 +510,15 @@ public:
     const Property* get_node_property(const string& name) const;    /**< Get the node property. */
     const Property* get_edge_property(const string& name) const;    /**< Get the edge property. */
     const Property* get_network_property(const string& name) const; /**< Get the network property. */
+
+    PropertyHandle node_handle(const string& name) const;   /**< Handle for a node property */
+    PropertyHandle edge_handle(const string& name) const;   /**< Handle for an edge property */
+
+    /* Get one property for every node, in sorted_node_vector order, or for every edge,
+       in the order of the edge hash table (edges_begin() to edges_end()).  This 
+       calls make_sorted_node_vector() for a node handle. */
+
+    void get_all(const PropertyHandle& h, vector <double> &vals);
  
     /* Adding / modifying / deleting nodes and edges */
 
@@ -337,6 +527,7 @@ public:
     Node* get_node(uint32_t idx) const;                  /**< Return node with id */
     Node* add_or_get_node(uint32_t idx);                 /**< Return node with id , or create it */
     void remove_node(uint32_t idx, bool force = false);  /**< Delete node - if force=false, error on IO nodes. */
+    void remove_nodes(const vector <uint32_t> &ids, bool force = false); /**< Delete many at once */
     void rename_node(uint32_t old_name, uint32_t new_name); /**< Change node's id */
 
     Edge* add_edge(uint32_t fr, uint32_t to);            /**< Analogous to add_node() */
@@ -345,6 +536,12 @@ public:
     Edge* add_or_get_edge(uint32_t fr, uint32_t to);     /**< Analogous to add_or_get_node() */
     void remove_edge(uint32_t fr, uint32_t to);          /**< Analogous to remove_node() */
 
+    /* Building big networks */
+
+    void reserve(size_t nodes, size_t edges);             /**< Make room for this many in total */
+    void add_nodes(const vector <uint32_t> &ids);         /**< Add a batch of nodes */
+    void add_edges(const vector < pair <uint32_t, uint32_t> > &edges);  /**< And edges */
+
     /* Input and output nodes */
 
     int add_input(uint32_t idx);                    /**< Add the next input */
@@ -365,6 +562,8 @@ public:
 
     Node* get_random_node(MOA &moa) const;        /**< Get a random node */
     Edge* get_random_edge(MOA &moa) const;        /**< Get a random edge */
+    vector <Node *> get_random_nodes(MOA &moa, size_t k) const;  /**< k distinct random nodes */
+    vector <Edge *> get_random_edges(MOA &moa, size_t k) const;  /**< k distinct random edges */
     Node* get_random_input(MOA &moa) const;       /**< Get a random input node */
     Node* get_random_output(MOA &moa) const;      /**< Get a random output node */
     
@@ -380,13 +579,28 @@ public:
                             const Property& p,  
                             vector<double>& values); 
 
-    void randomize(const json& params);            /**< Generate a random network (unimplemented) */
+    void randomize(const json& params);            /**< Generate a random network */
+    void randomize(const json& params, MOA &moa);  /**< The same, with your own RNG */
 
     /* Pruning and Sorting */
 
     void prune();                      /**< Prune nodes and edges not on an I/O path */
     void make_sorted_node_vector();       /**< Sort the nodes by id, nothing if already sorted. */
-    vector <Node *> sorted_node_vector;   /**< The sorted nodes */
+    vector <Node *> sorted_node_vector;   /**< The sorted nodes.  Kept sorted once it's made. */
+
+    /* The optional column store.  When it's on, the node and edge values live in one
+       contiguous array per value index, and each Node's and Edge's values vector is empty.
+       Use get()/set()/get_values() or the columns then.  See markdown/network.md. */
+
+    void enable_columns();                         /**< Move the values into the column store */
+    void disable_columns();                        /**< Move them back into the values vectors */
+    bool columns_enabled() const;                  /**< Is the column store on? */
+    double *node_column(int idx);                  /**< Node value idx, indexed by column_slot */
+    double *edge_column(int idx);                  /**< Edge value idx, indexed by column_slot */
+    const double *node_column(int idx) const;      /**< These don't unshare the column */
+    const double *edge_column(int idx) const;
+    const vector <Node *> &column_nodes() const;   /**< The node at each column_slot */
+    const vector <Edge *> &column_edges() const;   /**< The edge at each column_slot */
 
     /* Iterators and Metadata */
 
@@ -404,37 +618,174 @@ public:
     vector<double> values;
 
 protected:
+    /* helpers for write_json(), pretty_nodes() and pretty_edges() */
+    void write_pretty_nodes(std::ostream &out, const string &indent) const;
+    void write_pretty_edges(std::ostream &out, const string &indent) const;
+
     /* helpers for move/copy operations */
     void copy_from(const Network& net);
+    Node* new_node(uint32_t idx);               /**< add_node() without setting values */
+    Edge* new_edge(uint32_t fr, uint32_t to);   /**< add_edge() without setting values */
+    Edge* insert_edge(Node *from, Node *to);    /**< new_edge() without the checks */
+    void default_values(const PropertyMap &pm, int size, vector <double> &v) const;
     void move_from(Network&& net);
+    void remove_marked_nodes(const vector <uint64_t> &doomed);  /**< Bit per column_slot */
 
     /* return a random value appropriate for the given property */
     double random_value(MOA &moa, const Property &p);
+    void randomize_values(MOA &moa, const Property &p, Node *n);  /**< Works with the column store */
+    void randomize_values(MOA &moa, const Property &p, Edge *e);
 
     /* random network -- edges with probability p */
-    void randomize_p(const json& params);
+    void randomize_p(const json& params, MOA &moa);
 
     /* random network -- input -> hidden -> output */
-    void randomize_h(const json& params);
+    void randomize_h(const json& params, MOA &moa);
+
+    /* random network -- small world */
+    void randomize_sw(const json& params, MOA &moa);
 
     /* inputs/outputs -- index = input/output id, value = node id */
     vector<uint32_t> m_inputs;
     vector<uint32_t> m_outputs;
 
-    /* Nodes and Edges for the network stored centrally */
-
+    /* The column store.  The columns are mutable because Nodes and Edges only have
+       const pointers to their network, and set() writes them.  Copies of the network
+       share the columns, and own_column() makes a private copy before a write.  That
+       copy-on-write only happens when the columns are enabled:  otherwise, the values
+       are in each Node's and Edge's own vector, and copy_from() copies them all. */
+
+    bool m_columns = false;
+    mutable vector < shared_ptr < vector <double> > > m_node_columns;  /**< [value index][column_slot] */
+    mutable vector < shared_ptr < vector <double> > > m_edge_columns;
+    vector <Node *> m_column_nodes;                      /**< [column_slot].  Always kept, */
+    vector <Edge *> m_column_edges;                      /**< for get_random_node() etc. */
+
+    vector <double> &own_column(shared_ptr < vector <double> > &c) const;  /**< Unshare a column */
+    void column_add(Node *n);        /**< Move n's values to its slot in the columns */
+    void column_add(Edge *e);
+    void column_remove(Node *n);     /**< Fill n's slot with the last one */
+    void column_remove(Edge *e);
+
+    /* The hash.  m_hash is the sum of the hashes of every node and edge.  While
+       m_hash_valid is true, the methods that add, remove or set one node or edge keep
+       it up to date with hash_add().  Everything else (clear(), reading a network,
+       rename_node(), the column pointers) just sets m_hash_valid to false, and hash()
+       adds everything up again. */
+
+    mutable bool m_hash_valid = false;
+    mutable uint64_t m_hash[2] = { 0, 0 };
+    void hash_add(const Node *n, bool add) const;  /**< Add or subtract n's hash */
+    void hash_add(const Edge *e, bool add) const;
+
+    /* sorted_node_vector.  Once make_sorted_node_vector() has made it, m_sorted is true,
+       and adding, removing or renaming a node keeps it sorted with a binary search,
+       rather than throwing it away.  clear() and copy_from() of an unsorted network set
+       m_sorted to false, so reading a big network doesn't insert into it node by node. */
+
+    bool m_sorted = false;
+    void sorted_insert(Node *n);        /**< Put n into sorted_node_vector, if m_sorted */
+    void sorted_erase(const Node *n);   /**< Take n out of it, using n's current id */
+
+    /* Nodes and Edges for the network stored centrally.  The pools hold the Node
+       and Edge objects, and they must be declared before the maps, so that they are
+       destroyed after them.  They are made when the first node/edge is added. */
+
+    unique_ptr< Slab_Pool<Node> > m_node_pool;
+    unique_ptr< Slab_Pool<Edge> > m_edge_pool;
     NodeMap m_nodes;
     EdgeMap m_edges;
 
     PropertyPack m_properties;
 
-    /* dictionary of associated data (e.g. encoder params, app params, etc.) */
-    json m_associated_data = {};
+    /* dictionary of associated data (e.g. encoder params, app params, etc.).  Copies of
+       the network share it, until one of them changes it. */
+    shared_ptr <json> m_associated_data = std::make_shared<json>();
+    json &own_associated_data();      /**< Unshare it, and return it to modify */
 
     friend class Node;
     friend class Edge;
 };
 
+/**
+ * The header at the front of a binary network image.  All of the offsets are from the
+ * beginning of the image, and all of the sections are 8-byte aligned, so that an image
+ * that is mapped with mmap() may be used in place.  See markdown/network_binary_format.md.
+ */
+struct NetworkImageHeader
+{
+    char magic[8];                    /**< "TNNETBIN" */
+    uint32_t version;                 /**< NetworkImage::VERSION */
+    uint32_t byte_order;              /**< 0x01020304, in the byte order of the writer */
+    uint64_t image_size;              /**< Total size in bytes */
+
+    uint64_t num_nodes;
+    uint64_t num_edges;
+    uint64_t num_inputs;
+    uint64_t num_outputs;
+    uint64_t node_vec_size;           /**< Values per node, edge and network, from */
+    uint64_t edge_vec_size;           /**< the PropertyPack. */
+    uint64_t net_vec_size;
+
+    uint64_t properties_offset;       /**< PropertyPack JSON text */
+    uint64_t properties_size;
+    uint64_t node_ids_offset;         /**< uint32_t[num_nodes], sorted */
+    uint64_t node_values_offset;      /**< double[num_nodes * node_vec_size] */
+    uint64_t edge_offsets_offset;     /**< uint64_t[num_nodes+1] -- CSR row offsets */
+    uint64_t edge_to_offset;          /**< uint32_t[num_edges] -- index of the to node */
+    uint64_t edge_values_offset;      /**< double[num_edges * edge_vec_size] */
+    uint64_t inputs_offset;           /**< uint32_t[num_inputs] -- node ids */
+    uint64_t outputs_offset;          /**< uint32_t[num_outputs] -- node ids */
+    uint64_t network_values_offset;   /**< double[net_vec_size] */
+    uint64_t extras_offset;           /**< Names, coordinates and control points JSON text */
+    uint64_t extras_size;
+    uint64_t associated_data_offset;  /**< Associated data JSON text */
+    uint64_t associated_data_size;
+};
+
+/**
+ * A NetworkImage is a read-only view of a network in the binary format.  open() maps
+ * the file with mmap() and checks the header and section bounds -- nothing else is
+ * read until you use the accessors, which point straight into the image.  Node i's
+ * outgoing edges are edge_offsets()[i] up to edge_offsets()[i+1], sorted by the to
+ * node's id.  Network::from_binary() turns an image into a regular Network.
+ */
+class NetworkImage
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    NetworkImage() = default;
+    NetworkImage(const NetworkImage &img) = delete;
+    NetworkImage& operator=(const NetworkImage &img) = delete;
+    ~NetworkImage() noexcept;
+
+    void open(const string &filename);          /**< mmap() the file */
+    void attach(const void *buf, size_t size);  /**< Use an image in memory (8-byte aligned) */
+    void close();                               /**< Unmap or detach */
+
+    const NetworkImageHeader *header() const;
+
+    const uint32_t *node_ids() const;
+    const double *node_values() const;
+    const uint64_t *edge_offsets() const;
+    const uint32_t *edge_to() const;
+    const double *edge_values() const;
+    const uint32_t *inputs() const;
+    const uint32_t *outputs() const;
+    const double *network_values() const;
+
+    string properties_json() const;
+    string extras_json() const;
+    string associated_data_json() const;
+
+protected:
+    const uint8_t *m_base = nullptr;   /**< The image, or nullptr */
+    size_t m_size = 0;
+    void *m_map = nullptr;             /**< Set when open() mapped the image */
+    size_t m_map_size = 0;
+};
+
 /**
  * A Spike is a simple data structure to represent a tuple of id, time, and value.
  */
@@ -448,6 +799,72 @@ struct Spike
         id(id_), time(time_), value(value_) {}
 };
 
+/**
+ * A StreamSpike is the compact spike that goes through a processor's streaming spike
+ * ports.  On input, id is the input id, time is the delay in timesteps from the timestep
+ * in which the processor picks the spike up, and value is normalized, as in apply_spike().
+ * The value is a double, like a Spike's, so that it turns into the same charge.
+ * On output, id is the output id, time is the processor time of the fire, and value is 1.
+ */
+struct StreamSpike
+{
+    int32_t id;
+    uint32_t time;
+    double value;
+};
+
+typedef SPSC_Ring <StreamSpike> SpikeStream;
+
+/**
+ * A SpikeBatch holds input spikes compactly, as a struct of arrays: spike i goes to input
+ * ids[i] at timestep times[i] (relative to the network's current time) with value
+ * values[i].  The spikes are all normalized, or all unnormalized, as with apply_spikes().
+ * The values are doubles, like a Spike's, so that a processor turns them into exactly the
+ * same charges.  The ids and times are 32-bit integers, which saves 8 bytes a spike.
+ *
+ * A batch may also be split into independent samples for Processor::run_batch().  The
+ * spikes of the samples are stored back to back, and starts[i] is the index of sample i's
+ * first spike.
+ */
+class SpikeBatch
+{
+public:
+    vector <int32_t> ids;
+    vector <int32_t> times;
+    vector <double> values;
+    vector <size_t> starts;
+    bool normalized = true;
+
+    void add_sample();                         /**< Start a new sample with no spikes */
+    void add_sample(const vector <Spike> &s);  /**< Add a sample with these spikes */
+    void add_sample(const int32_t *ids, const int32_t *times, const double *values, size_t n);
+    void add_spike(int32_t id, int32_t time, double value);  /**< Add to the last sample */
+    void add_spike(const Spike &s);
+    void reserve(size_t spikes);
+    size_t num_spikes() const;
+    size_t num_samples() const;
+    size_t sample_begin(size_t i) const;       /**< Index of sample i's first spike */
+    size_t sample_end(size_t i) const;         /**< One past the index of its last spike */
+    void clear();
+};
+
+/**
+ * A BatchResult is what run_batch() returns: dense [sample][output] matrices of
+ * output counts and output last fire times, stored row by row.  The outputs are in
+ * the same order as in output_counts() and output_last_fires().
+ */
+struct BatchResult
+{
+    size_t num_samples = 0;
+    size_t num_outputs = 0;
+    vector <int> counts;
+    vector <double> last_fires;
+
+    void resize(size_t samples, size_t outputs);
+    int count(size_t sample, size_t output) const;
+    double last_fire(size_t sample, size_t output) const;
+};
+
 /**
  * The Processor class is an interface for neuromorphic simulators and hardware.
  * This interface specifies the necessary methods to interact seamlessly with 
@@ -489,6 +906,13 @@ public:
                               const vector<int>& network_ids,
                               bool normalized = true) = 0;
 
+    /* Queue all of the spikes in a SpikeBatch (its samples are ignored).  The default
+       converts each one to a Spike and calls apply_spike().  RISP and VRISP check the
+       whole batch first, and then insert it without any per-spike lookups, so a bad
+       spike means that none of the batch is applied. */
+
+    virtual void apply_spikes(const SpikeBatch &batch, int network_id = 0);
+
     /* Run the network(s) for the desired time with queued input(s) */
 
     virtual void run(double duration, int network_id = 0) = 0;
@@ -526,6 +950,21 @@ public:
 
     virtual vector <double> neuron_charges(int network_id = 0) = 0;
 
+    /* These are the same as the methods above, but they write into a buffer of n entries
+       that belongs to the caller, so that they don't allocate memory.  They return the
+       number of entries written, and throw if n is too small.  output_vectors() stores
+       the firing times of all of the outputs back to back in times, and sets counts[i] to
+       the number of firing times of output i.  The defaults call the vector versions
+       and copy. */
+
+    virtual size_t output_last_fires(double *buf, size_t n, int network_id = 0);
+    virtual size_t output_counts(int *buf, size_t n, int network_id = 0);
+    virtual size_t output_vectors(double *times, size_t n, size_t *counts, size_t num_counts,
+                                  int network_id = 0);
+    virtual size_t neuron_counts(int *buf, size_t n, int network_id = 0);
+    virtual size_t neuron_last_fires(double *buf, size_t n, int network_id = 0);
+    virtual size_t neuron_charges(double *buf, size_t n, int network_id = 0);
+
     /* Synapse data from all synapses. */
 
     virtual void synapse_weights (vector <uint32_t> &pres, 
@@ -533,9 +972,75 @@ public:
                                   vector <double> &vals,
                                   int network_id = 0) = 0;
 
+    /* Change synapse weights and neuron thresholds on a loaded network, without
+       reloading it.  The vectors are parallel, like synapse_weights(), and the
+       values are the same as the network's Weight and Threshold properties.
+       These aren't pure virtual -- the defaults throw. */
+
+    virtual void set_synapse_weights(const vector <uint32_t> &pres,
+                                     const vector <uint32_t> &posts,
+                                     const vector <double> &vals,
+                                     int network_id = 0);
+
+    virtual void set_neuron_thresholds(const vector <uint32_t> &ids,
+                                       const vector <double> &vals,
+                                       int network_id = 0);
+
     /* Remove state, keep network loaded */
     virtual void clear_activity(int network_id = 0) = 0;
 
+    /* Change a loaded network in place, so that it matches network.apply_patch(patch),
+       where network is the one that was loaded.  The activity of the network is not
+       cleared.  If the processor can't apply this patch in place, it returns false and
+       changes nothing -- the caller should then call load_network() with the patched
+       network.  The default returns false. */
+
+    virtual bool apply_network_patch(const NetworkPatch &patch, int network_id = 0);
+
+    /* Run every sample in the batch as if by:
+
+         clear_activity(network_id);
+         apply_spikes(<the sample's spikes>, batch.normalized, network_id);
+         run(duration, network_id);
+
+       and return its output_counts() and output_last_fires() as rows of the result.
+       Each sample starts with cleared activity, and when run_batch() returns, the network
+       holds the state from the last sample.  The default does exactly the calls above;
+       processors may override it with something faster that gives the same results. */
+
+    virtual BatchResult run_batch(const SpikeBatch &batch, double duration, int network_id = 0);
+
+    /* Copy the network loaded at src_network_id, along with its current state, to
+       dst_network_id, replacing whatever was there.  This copies the processor's own
+       representation, so it's much faster than calling load_network() again.
+       As with the snapshots below, the default throws. */
+
+    virtual void clone_network(int src_network_id, int dst_network_id);
+
+    /* Snapshot the dynamic state of a loaded network (charges, pending spikes, time, etc)
+       into an opaque byte vector, and restore it later onto the same loaded network.
+       These aren't pure virtual -- the defaults throw, so a processor that doesn't
+       support snapshots doesn't need to implement them. */
+
+    virtual vector <uint8_t> save_state(int network_id = 0);
+    virtual void restore_state(const vector <uint8_t> &state, int network_id = 0);
+
+    /* Streaming spike ports, so that another thread can feed a network while it runs.
+       open_spike_streams() gives the network an input and an output SpikeStream with
+       the given capacity (replacing any old ones -- a capacity of 0 just removes them).
+       After that, every timestep of run() starts by draining the input stream, and
+       every output fire is pushed onto the output stream (it's dropped if the stream is
+       full).  An input spike that apply_spike() would reject is dropped, and counted
+       by the input stream's rejected(), so that run() doesn't throw halfway through.
+       input_stream() and output_stream() return the streams, or NULL if they're
+       not open.  One thread may push to the input stream, and one thread may pop from
+       the output stream; everything else still belongs to the thread calling run().
+       The defaults throw. */
+
+    virtual void open_spike_streams(size_t capacity, int network_id = 0);
+    virtual SpikeStream *input_stream(int network_id = 0);
+    virtual SpikeStream *output_stream(int network_id = 0);
+
     /* Network and Processor Properties.  The network properties correspond to the Data
        field in the network, nodes and edges.  The processor properties are so that
        applications may query the processor for various properties (e.g. input scaling,
@@ -591,6 +1096,21 @@ json neuron_vectors_to_json(const vector < vector <double> > &events,
 
 json run_and_track(int duration, Processor *p, int network_id = 0);
 
+/* This paces the processor in real time:  it calls run(1) duration times, starting one
+   call every timestep_period seconds on a monotonic clock.  If a call ends after the
+   next call's scheduled start, that's a deadline miss, and the next call starts right
+   away (the schedule doesn't drift, so the run catches up if it can).  It returns a
+   json with timing statistics, in seconds:
+
+    "timesteps", "timestep_period", "deadline_misses" and "wall_time".
+    "compute_time": "min", "mean", "p50", "p90", "p99" and "max" of the time that each
+                    run(1) call took.
+    "jitter":       "mean", "stddev" and "max" of how late each call started, relative
+                    to its scheduled start time.
+ */
+
+json run_realtime(int duration, double timestep_period, Processor *p, int network_id = 0);
+
 /* This copies n, but sets the synapse weights from the network that is on the processor. */
 
 Network *pull_network(Processor *p, Network *n, int network_id = 0);
@@ -602,4 +1122,12 @@ void apply_spike_raster(Processor *p, int in_neuron, const vector <char> &sr, in
 
 }   // End of neuro namespace.
 
+/* So that NetworkHash can key an unordered_map (e.g. to cache fitness evaluations). */
+
+namespace std {
+template <> struct hash<neuro::NetworkHash> {
+  size_t operator()(const neuro::NetworkHash &h) const { return h.lo; }
+};
+}
+
 #endif
@@ -27,6 +27,8 @@ public:
   uint32_t fire_counts;        /**< Number of fires */
   bool leak;                   /**< Leak on this neuron or not */
   uint32_t id;                 /**< ID for logging events */
+  uint32_t index;              /**< Index in the network's sorted_neuron_vector */
+  int output_id;               /**< Output id, or -1 if this isn't an output */
   bool check;                  /**< True if we have checked if this neruon fires or not */
   bool track;                  /**< True if fire_times is being tracked */
   void perform_fire(int time); /**< Perform the firing actions */
@@ -56,12 +58,16 @@ public:
           bool _inputs_from_weights,
           uint32_t _noisy_seed,
           double _noisy_stddev,
+          MOA::Engine _noisy_engine,
           vector <double> & _weights, 
           vector <double> & _stds);  
+
+  Network(const Network &src);   /**< Deep copy, with no reference back to src */
   ~Network();
 
   /* Similar calls from Processor API */
   void apply_spike(const Spike& s, bool normalized = true);
+  void apply_spikes(const SpikeBatch &batch, size_t begin, size_t end);
   void run(double duration);
   double get_time();
   bool track_output_events(int output_id, bool track);
@@ -83,10 +89,31 @@ public:
   vector < vector <double> > neuron_vectors();
 
   vector < double > neuron_charges();
+
+  /* The same, written into the caller's buffer of n entries. */
+  size_t output_last_fires(double *buf, size_t n);
+  size_t output_counts(int *buf, size_t n);
+  size_t output_vectors(double *times, size_t n, size_t *counts, size_t num_counts);
+  size_t neuron_counts(int *buf, size_t n);
+  size_t neuron_last_fires(double *buf, size_t n);
+  size_t neuron_charges(double *buf, size_t n);
+
   void synapse_weights(vector <uint32_t> &pres, vector <uint32_t> &posts, vector <double> &vals);
+  void set_synapse_weights(const vector <uint32_t> &pres, const vector <uint32_t> &posts,
+                           const vector <double> &vals);
+  void set_neuron_thresholds(const vector <uint32_t> &ids, const vector <double> &vals);
+  void apply_patch(const NetworkPatch &patch, int threshold_idx, int leak_idx,
+                   int weight_idx, int delay_idx);
 
   void clear_activity();
+  void run_batch(const SpikeBatch &batch, double duration, BatchResult &rv);
+
+  void save_state(vector <uint8_t> &state);        /**< Snapshot the dynamic state */
+  void restore_state(const vector <uint8_t> &state); /**< Restore it from save_state() */
 
+  void open_spike_streams(size_t capacity);
+  SpikeStream *input_stream();
+  SpikeStream *output_stream();
 
 protected:
   Neuron* add_neuron(uint32_t node_id, double threshold, bool leak);
@@ -95,22 +122,34 @@ protected:
   void add_input(uint32_t node_id, int input_id);
   void add_output(uint32_t node_id, int output_id);
 
+  void make_synapse_map();      /**< Create synapse_map, for set_synapse_weights() */
+  Synapse* find_synapse(uint32_t from_id, uint32_t to_id);  /**< NULL if it's not there */
+
   Neuron* get_neuron(uint32_t node_id);
   bool is_neuron(uint32_t node_id);
   bool is_valid_output_id(int output_id);
   bool is_valid_input_id(int input_id);
+  double input_charge(double value, bool normalized);  /**< Charge from an input spike */
+  double noise(double mean, double stddev);            /**< One normal for the noise */
 
   void clear_tracking_info();   /**< Clear out all tracking info to begin run() */
   
   void process_events(uint32_t time); /**< Process events at time "time" */
+  void drain_input_stream(uint32_t time); /**< Apply the input stream's spikes at "time" */
+  void stream_fire(Neuron *n, int time);  /**< Push an output fire on the output stream */
 
   vector <int> inputs;        /**< index is input id and its value is neuron id. 
                                    If the neuron id is -1, it's not an input node. */
   vector <int> outputs;       /**< index is output id and its value is neuron id. 
                                    If the neuron id is -1, it's not an ouput node. */
   vector <Neuron *> sorted_neuron_vector;         /**< sorted neurons by node id */
+  vector <Neuron *> input_neurons;  /**< The neuron of each input id, for apply_spikes().
+                                         Cleared when the inputs change, and rebuilt
+                                         by apply_spikes(). */
 
   unordered_map <uint32_t, Neuron*> neuron_map;   /**< key is neuron id */
+  unordered_map <uint64_t, Synapse*> synapse_map; /**< key is (from_id << 32) | to_id.
+                                                       This is empty until it's needed. */
 
   /** The index of the vector is the timestep.
    *  Each subvector stores a set of events, which is composed of neuron and charge change.
@@ -136,6 +175,10 @@ protected:
   double spike_value_factor;
   vector <Neuron *> to_fire;   /* To make RISP like RAVENS, this lets you fire a timestep later. */
 
+  SpikeStream *in_stream;      /**< Streaming input port, or NULL */
+  SpikeStream *out_stream;     /**< Streaming output port, or NULL */
+  int run_start_time;          /**< overall_run_time when this run() call started */
+
 };
 
 class Processor : public neuro::Processor
@@ -155,6 +198,7 @@ public:
 
   void apply_spikes(const vector<Spike>& s, bool normalized = true, int network_id = 0);
   void apply_spikes(const vector<Spike>& s, const vector<int>& network_ids, bool normalized = true);
+  void apply_spikes(const SpikeBatch &batch, int network_id = 0);
 
   /* Run the network(s) for the desired time with queued input(s) */
 
@@ -190,14 +234,53 @@ public:
 
   vector < double > neuron_charges(int network_id = 0);
 
+  /* The same, written into the caller's buffer, without allocating memory */
+
+  size_t output_last_fires(double *buf, size_t n, int network_id = 0);
+  size_t output_counts(int *buf, size_t n, int network_id = 0);
+  size_t output_vectors(double *times, size_t n, size_t *counts, size_t num_counts,
+                        int network_id = 0);
+  size_t neuron_counts(int *buf, size_t n, int network_id = 0);
+  size_t neuron_last_fires(double *buf, size_t n, int network_id = 0);
+  size_t neuron_charges(double *buf, size_t n, int network_id = 0);
+
   void synapse_weights(vector <uint32_t> &pres,
                        vector <uint32_t> &posts,
                        vector <double> &vals,
                        int network_id = 0);
 
+  /* In-place updates of weights and thresholds */
+
+  void set_synapse_weights(const vector <uint32_t> &pres,
+                           const vector <uint32_t> &posts,
+                           const vector <double> &vals,
+                           int network_id = 0);
+
+  void set_neuron_thresholds(const vector <uint32_t> &ids,
+                             const vector <double> &vals,
+                             int network_id = 0);
+
+  /* Change a loaded network in place.  This can do any patch. */
+  bool apply_network_patch(const NetworkPatch &patch, int network_id = 0);
+
+  /* Run many samples, each from cleared activity */
+  BatchResult run_batch(const SpikeBatch &batch, double duration, int network_id = 0);
+
   /* Remove state, keep network loaded */
   void clear_activity(int network_id = 0);
 
+  /* Copy a loaded network (and its state) to another network id */
+  void clone_network(int src_network_id, int dst_network_id);
+
+  /* Snapshots of the network's dynamic state */
+  vector <uint8_t> save_state(int network_id = 0);
+  void restore_state(const vector <uint8_t> &state, int network_id = 0);
+
+  /* Streaming spike ports */
+  void open_spike_streams(size_t capacity, int network_id = 0);
+  SpikeStream *input_stream(int network_id = 0);
+  SpikeStream *output_stream(int network_id = 0);
+
   /* Network and Processor Properties.  The network properties correspond to the Data
      field in the network, nodes and edges.  The processor properties are so that
      applications may query the processor for various properties (e.g. input scaling,
@@ -228,6 +311,7 @@ protected:
   bool fire_like_ravens;
   bool inputs_from_weights;
   uint32_t noisy_seed;
+  MOA::Engine noisy_engine;
   vector <double> weights;
   vector <double> stds;
 
@@ -1,4 +1,6 @@
-/* JSP: 10/2024 -- Just using Mersenne Twister from the C++ standard library.  */
+/* JSP: 10/2024 -- Just using Mersenne Twister from the C++ standard library.  
+   Mersenne Twister is still the default, but you can select xoshiro256** with Set_Engine(),
+   which is a good bit faster.  See markdown/MOA.md. */
 
 #pragma once
 #include <stdio.h>
@@ -9,12 +11,24 @@
 #include <sys/time.h>
 #include <cstdint>
 #include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 namespace neuro
 {
 
 class MOA {
   public:
+    /* The engines.  MT19937 is the default, and its streams are the same as they've always
+       been.  XOSHIRO256SS is xoshiro256** (Blackman and Vigna), seeded with splitmix64. */
+
+    enum Engine { MT19937 = 0, XOSHIRO256SS = 1 };
+
+    void     Set_Engine(Engine e);           /* Select the engine, and reseed it with the last seed. */
+    Engine   Get_Engine() const;
+
     double   Random_Double();                /* Returns a double in the interval [0, 1) */
     double   Random_DoubleI();               /* Returns a double in the interval [0, 1] */
     double   Random_Normal(double mean, double stddev);   /* What it says */
@@ -25,6 +39,15 @@ class MOA {
     uint32_t Random_W(int w, int zero_ok);   /* Returns a random w-bit number. (w <= 32)*/
     void     Fill_Random_Region (void *reg, int size);   /* reg should be aligned to 4 bytes, but
                                                                    size can be anything. */
+
+    /* Bulk generation.  Fill_Doubles() gives the same values as n calls to Random_Double().
+       Fill_Normals() uses a 128-layer ziggurat, which takes one 64-bit random number for
+       nearly every normal, and no log() or sqrt().  So it's a different stream than calling
+       Random_Normal() n times. */
+
+    void     Fill_Doubles(double *x, size_t n);
+    void     Fill_Normals(double *x, size_t n, double mean, double stddev);
+
     uint32_t Seed_From_Time();               /* Generates a random-ish 32-bit number from the
                                                 current time in milliseconds. */
     /* You can seed the RNG with an unsigned integer Seed().
@@ -46,14 +69,77 @@ class MOA {
     uint64_t Get_Counter();                  /* Gets the counter.  Duh. */
     void     Set_State(void *buffer, uint64_t counter);  /* Resets the state to a saved place. */
 
+    /* Substreams, for parallel work that has to be reproducible.  Substream(i) returns a
+       new RNG whose stream depends only on this RNG's seed, engine and i -- not on how
+       many numbers this one has generated -- so work item i can use Substream(i) no
+       matter which thread does it.  Split(k) returns substreams 0 through k-1.
+       Jump() advances xoshiro256** by 2^128 numbers, so that k copies, each jumped a
+       different number of times, never overlap.  Mersenne Twister can't jump: Jump()
+       throws a runtime_error. */
+
+    MOA      Substream(uint64_t i) const;
+    std::vector <MOA> Split(size_t k) const;
+    void     Jump();
+
+    /* Get_Engine_State() copies the complete engine state (including a pending
+       second normal) into a byte vector, and Set_Engine_State() puts it back exactly.
+       Use these when you need to resume a stream without replaying it. */
+
+    void     Get_Engine_State(std::vector <uint8_t> &state);
+    void     Set_Engine_State(const std::vector <uint8_t> &state);
+
   protected:
+    void     Seed_Engine();                  /* Seed the selected engine from Seed_Key */
+    uint64_t Xoshiro_Next();
+    double   Ziggurat_Normal();              /* One standard normal, for Fill_Normals() */
+    double   Random_Open();                  /* A 53-bit double in (0, 1] */
+
+    struct Ziggurat_Tables {                 /* Made once, the first time they're used */
+      Ziggurat_Tables();
+      double x[129];                         /* The layers' right edges */
+      double r[128];                         /* x[i+1]/x[i] */
+    };
+    static const Ziggurat_Tables &Ziggurat();
+
     std::mt19937 gen; 
     std::uniform_int_distribution<unsigned int> distrib;
+    Engine engine = MT19937;
+    uint64_t xs[4] = { 0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL,
+                       0x94d049bb133111ebULL, 0x2545f4914f6cdd1dULL };  /* xoshiro256** state */
+    uint64_t Seed_Key = 5489;                /* The last seed (std::mt19937's default), */
+    bool     Sub = false;                    /* or the key of a substream, if Sub is true. */
     uint64_t Counter;
     bool Use_Second_Normal = false;
     double Second_Normal;
 };
 
+inline uint64_t MOA::Xoshiro_Next()
+{
+  uint64_t rv, t;
+
+  rv = xs[1] * 5;
+  rv = ((rv << 7) | (rv >> 57)) * 9;
+  t = xs[1] << 17;
+  xs[2] ^= xs[0];
+  xs[3] ^= xs[1];
+  xs[1] ^= xs[2];
+  xs[0] ^= xs[3];
+  xs[2] ^= t;
+  xs[3] = (xs[3] << 45) | (xs[3] >> 19);
+  return rv;
+}
+
+inline void MOA::Set_Engine(Engine e)
+{
+  engine = e;
+  Seed_Engine();
+}
+
+inline MOA::Engine MOA::Get_Engine() const
+{
+  return engine;
+}
+
 inline double MOA::Random_Double() {
     uint32_t result;
     do {
@@ -93,6 +179,7 @@ inline uint32_t MOA::Random_32()
 {
   uint32_t rv;
 
+  if (engine == XOSHIRO256SS) return (uint32_t) (Xoshiro_Next() >> 32);
   rv = distrib(gen);
   return rv;
 }
@@ -108,6 +195,7 @@ inline int MOA::Random_Integer() {
 inline uint64_t MOA::Random_64() {
   uint64_t sum;
 
+  if (engine == XOSHIRO256SS) return Xoshiro_Next();
   sum = Random_32();
   sum <<= 32;
   sum |= Random_32();
@@ -161,15 +249,101 @@ inline uint32_t MOA::Seed_From_Time()
 }
 
 inline void MOA::Seed_XOR(uint32_t seed, uint32_t hash) {
-  int i;
   uint32_t s;
 
   s = (seed == 0) ? Seed_From_Time() : seed;
   s ^= hash;
+  Seed_Key = s;
+  Sub = false;
+  Seed_Engine();
+}
 
-  gen.seed(s);
+/* Mersenne Twister is seeded as it always has been.  Xoshiro256**'s 256 bits of state
+   come from running splitmix64 on the seed, which is what its authors recommend.
+   A substream's Mersenne Twister is seeded through a seed_seq with its 64-bit key, so
+   that it gets all of its 624 words of state from the key. */
+
+inline void MOA::Seed_Engine() {
+  int i;
+  uint64_t z, x;
+
+  if (engine == XOSHIRO256SS) {
+    x = Seed_Key;
+    for (i = 0; i < 4; i++) {
+      x += 0x9e3779b97f4a7c15ULL;
+      z = x;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      xs[i] = z ^ (z >> 31);
+    }
+  } else if (Sub) {
+    std::seed_seq seq { (uint32_t) Seed_Key, (uint32_t) (Seed_Key >> 32) };
+    gen.seed(seq);
+  } else {
+    gen.seed((uint32_t) Seed_Key);
+    for (i=0; i<19; i++) distrib(gen);
+  }
   Counter = 0;
-  for (i=0; i<19; i++) Random_32();
+  Use_Second_Normal = false;
+}
+
+/* A substream's key mixes this RNG's key with i, with the finalizer from MurmurHash3,
+   so nearby i's and nearby seeds give unrelated keys.  */
+
+inline MOA MOA::Substream(uint64_t i) const
+{
+  MOA rv;
+  uint64_t k;
+  int j;
+
+  k = Seed_Key ^ (Sub ? 0x5bd1e9955bd1e995ULL : 0);
+  for (j = 0; j < 2; j++) {
+    k ^= (j == 0) ? i * 0x9e3779b97f4a7c15ULL : 0x94d049bb133111ebULL;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+  }
+
+  rv.engine = engine;
+  rv.Seed_Key = k;
+  rv.Sub = true;
+  rv.Seed_Engine();
+  return rv;
+}
+
+inline std::vector <MOA> MOA::Split(size_t k) const
+{
+  std::vector <MOA> rv;
+  size_t i;
+
+  rv.reserve(k);
+  for (i = 0; i < k; i++) rv.push_back(Substream(i));
+  return rv;
+}
+
+/* This is the jump function from xoshiro256**'s reference code. */
+
+inline void MOA::Jump()
+{
+  static const uint64_t jump[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t t[4] = { 0, 0, 0, 0 };
+  int i, b, j;
+
+  if (engine != XOSHIRO256SS) {
+    throw std::runtime_error("MOA::Jump() - only the xoshiro256** engine can jump");
+  }
+  for (i = 0; i < 4; i++) {
+    for (b = 0; b < 64; b++) {
+      if (jump[i] & (1ULL << b)) {
+        for (j = 0; j < 4; j++) t[j] ^= xs[j];
+      }
+      Xoshiro_Next();
+    }
+  }
+  memcpy(xs, t, sizeof(xs));
   Use_Second_Normal = false;
 }
 
@@ -202,6 +376,91 @@ inline void MOA::Fill_Random_Region (void *reg, int size)
   for (i *= 4; i < size; i++) r8[i] = (uint8_t) Random_W(8, 1);
 }
 
+inline void MOA::Fill_Doubles(double *x, size_t n)
+{
+  size_t i;
+  uint32_t r;
+
+  if (engine == XOSHIRO256SS) {
+    for (i = 0; i < n; i++) {
+      do {
+        r = (uint32_t) (Xoshiro_Next() >> 32);
+      } while (r == 0xffffffffU);
+      x[i] = (double) r / (double) (0xffffffffU);
+    }
+  } else {
+    for (i = 0; i < n; i++) x[i] = Random_Double();
+  }
+}
+
+/* The ziggurat is Marsaglia and Tsang's, as refined by Doornik (2005): 128 layers of
+   equal area, with the tail past R = 3.4426... handled by Marsaglia's method.  The low 7
+   bits of a 64-bit random number pick the layer, and the top 53 make a uniform in [-1,1). */
+
+inline MOA::Ziggurat_Tables::Ziggurat_Tables()
+{
+  const double R = 3.442619855899;
+  const double V = 9.91256303526217e-3;
+  double f;
+  int i;
+
+  f = exp(-0.5 * R * R);
+  x[0] = V / f;
+  x[1] = R;
+  x[128] = 0;
+  for (i = 2; i < 128; i++) {
+    x[i] = sqrt(-2.0 * log(V / x[i-1] + f));
+    f = exp(-0.5 * x[i] * x[i]);
+  }
+  for (i = 0; i < 128; i++) r[i] = x[i+1] / x[i];
+}
+
+inline const MOA::Ziggurat_Tables &MOA::Ziggurat()
+{
+  static const Ziggurat_Tables t;
+  return t;
+}
+
+inline double MOA::Random_Open()
+{
+  return ((Random_64() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+inline double MOA::Ziggurat_Normal()
+{
+  const Ziggurat_Tables &t = Ziggurat();
+  uint64_t b;
+  double u, x, y, f0, f1;
+  int i;
+
+  while (1) {
+    b = Random_64();
+    i = b & 0x7f;
+    u = (b >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+    if (fabs(u) < t.r[i]) return u * t.x[i];
+
+    if (i == 0) {                    /* The tail */
+      do {
+        x = log(Random_Open()) / t.x[1];
+        y = log(Random_Open());
+      } while (-2.0 * y < x * x);
+      return (u < 0) ? x - t.x[1] : t.x[1] - x;
+    }
+
+    x = u * t.x[i];
+    f0 = exp(-0.5 * (t.x[i] * t.x[i] - x * x));
+    f1 = exp(-0.5 * (t.x[i+1] * t.x[i+1] - x * x));
+    if (f1 + Random_Double() * (f0 - f1) < 1.0) return x;
+  }
+}
+
+inline void MOA::Fill_Normals(double *x, size_t n, double mean, double stddev)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) x[i] = Ziggurat_Normal() * stddev + mean;
+}
+
 inline void MOA::Get_State(void *buffer)
 {
   bzero(buffer, sizeof(uint32_t) * 5);
@@ -221,4 +480,86 @@ inline void MOA::Set_State(void *buffer, uint64_t counter)
   Use_Second_Normal = false;
 }
 
+/* The engine state is the Mersenne Twister's textual state (its 624 words plus its
+   position), as a 32-bit length followed by the characters, and then the counter,
+   Use_Second_Normal (one byte), and Second_Normal.  The standard library only lets us
+   get at the engine's state through the stream operators, so we go through those.
+   With xoshiro256**, the text is "X" followed by its four state words, so the
+   format is the same, and Set_Engine_State() selects the engine from the text.
+   Last are Seed_Key and Sub, for Substream().  States without them are still read. */
+
+inline void MOA::Get_Engine_State(std::vector <uint8_t> &state)
+{
+  std::ostringstream oss;
+  std::string s;
+  uint32_t len;
+  uint8_t usn;
+
+  if (engine == XOSHIRO256SS) {
+    oss << "X " << xs[0] << " " << xs[1] << " " << xs[2] << " " << xs[3];
+  } else {
+    oss << gen;
+  }
+  s = oss.str();
+  len = s.size();
+
+  state.clear();
+  state.insert(state.end(), (uint8_t *) &len, ((uint8_t *) &len) + sizeof(len));
+  state.insert(state.end(), s.begin(), s.end());
+  usn = Use_Second_Normal;
+  state.insert(state.end(), (uint8_t *) &Counter, ((uint8_t *) &Counter) + sizeof(Counter));
+  state.push_back(usn);
+  state.insert(state.end(), (uint8_t *) &Second_Normal,
+               ((uint8_t *) &Second_Normal) + sizeof(Second_Normal));
+  state.insert(state.end(), (uint8_t *) &Seed_Key, ((uint8_t *) &Seed_Key) + sizeof(Seed_Key));
+  state.push_back(Sub);
+}
+
+inline void MOA::Set_Engine_State(const std::vector <uint8_t> &state)
+{
+  std::istringstream iss;
+  std::mt19937 g;
+  uint64_t x[4];
+  uint32_t len;
+  size_t off, rest;
+  char c;
+
+  if (state.size() < sizeof(len)) {
+    throw std::runtime_error("MOA::Set_Engine_State() - state is the wrong size");
+  }
+  memcpy(&len, state.data(), sizeof(len));
+  off = sizeof(len);
+  rest = (size_t) len + sizeof(Counter) + 1 + sizeof(Second_Normal);
+  if (state.size() - off != rest && state.size() - off != rest + sizeof(Seed_Key) + 1) {
+    throw std::runtime_error("MOA::Set_Engine_State() - state is the wrong size");
+  }
+
+  iss.str(std::string((const char *) state.data() + off, len));
+  if (len > 0 && state[off] == 'X') {
+    iss >> c >> x[0] >> x[1] >> x[2] >> x[3];
+    if (!iss || (x[0] | x[1] | x[2] | x[3]) == 0) {
+      throw std::runtime_error("MOA::Set_Engine_State() - bad engine state");
+    }
+    memcpy(xs, x, sizeof(xs));
+    engine = XOSHIRO256SS;
+  } else {
+    if (!(iss >> g)) throw std::runtime_error("MOA::Set_Engine_State() - bad engine state");
+    gen = g;
+    engine = MT19937;
+  }
+  off += len;
+
+  memcpy(&Counter, state.data() + off, sizeof(Counter));
+  off += sizeof(Counter);
+  Use_Second_Normal = (state[off] != 0);
+  off++;
+  memcpy(&Second_Normal, state.data() + off, sizeof(Second_Normal));
+  off += sizeof(Second_Normal);
+  if (off < state.size()) {
+    memcpy(&Seed_Key, state.data() + off, sizeof(Seed_Key));
+    off += sizeof(Seed_Key);
+    Sub = (state[off] != 0);
+  }
+}
+
 }
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+/* These are helpers for packing and unpacking flat binary blobs, such as processor
+   state snapshots.  Values are written in the machine's native byte order, so blobs
+   are meant to be restored on the same kind of machine that made them. */
+
+namespace neuro
+{
+
+/* Append the raw bytes of a trivially-copyable value to the buffer. */
+
+template <class T> inline static void bin_put(std::vector <uint8_t> &buf, const T &v)
+{
+  const uint8_t *p;
+
+  p = (const uint8_t *) &v;
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+/* Append n raw bytes to the buffer. */
+
+inline static void bin_put_bytes(std::vector <uint8_t> &buf, const void *bytes, size_t n)
+{
+  const uint8_t *p;
+
+  p = (const uint8_t *) bytes;
+  buf.insert(buf.end(), p, p + n);
+}
+
+/* Copy the next n bytes out of the buffer, and move offset past them.  This throws
+   if the buffer doesn't have n bytes left. */
+
+inline static void bin_get_bytes(const uint8_t *buf, size_t size, size_t &offset,
+                                 void *bytes, size_t n)
+{
+  if (offset > size || n > size - offset) {
+    throw std::runtime_error("bin_get_bytes() - read past the end of the buffer");
+  }
+  memcpy(bytes, buf + offset, n);
+  offset += n;
+}
+
+/* Read the next value out of the buffer, and move offset past it. */
+
+template <class T> inline static T bin_get(const uint8_t *buf, size_t size, size_t &offset)
+{
+  T v;
+
+  bin_get_bytes(buf, size, offset, &v, sizeof(T));
+  return v;
+}
+
+template <class T> inline static T bin_get(const std::vector <uint8_t> &buf, size_t &offset)
+{
+  return bin_get<T>(buf.data(), buf.size(), offset);
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <utility>
+
+/* Slab_Pool hands out objects of type T from big slabs of memory, instead of calling
+   new for each one.  Released objects go on a free list and are reused.  Objects never
+   move once they are made, so pointers to them stay good until they are released.
+   When the pool is destroyed, the slabs are freed all at once -- every object must have
+   been released by then.
+
+   Networks use these for their nodes and edges.  A pool is not thread-safe. */
+
+namespace neuro
+{
+
+template <class T> class Slab_Pool {
+  public:
+    Slab_Pool() : free_list(nullptr), next(0), slab_objects(0) {}
+    Slab_Pool(const Slab_Pool &p) = delete;
+    Slab_Pool& operator=(const Slab_Pool &p) = delete;
+    ~Slab_Pool();
+
+    template <class... Args> T *make(Args&&... args);  /* Construct an object in the pool. */
+    void release(T *p);                                /* Destroy it, and reuse its memory. */
+    void reserve(size_t n);                            /* Make sure n more makes won't allocate. */
+
+  protected:
+    union Slot {
+      Slot *next_free;
+      alignas(T) char bytes[sizeof(T)];
+    };
+
+    void new_slab(size_t n);
+
+    std::vector <Slot *> slabs;
+    Slot *free_list;      /* Released slots */
+    size_t next;          /* Next never-used slot in the last slab */
+    size_t slab_objects;  /* Size of the last slab.  Slabs double, up to 4096 objects. */
+};
+
+/* A deleter for unique_ptr's whose objects came from a Slab_Pool. */
+
+template <class T> struct Slab_Deleter {
+  Slab_Pool <T> *pool;
+
+  Slab_Deleter(Slab_Pool <T> *p = nullptr) : pool(p) {}
+  void operator()(T *p) const { if (pool == nullptr) delete p; else pool->release(p); }
+};
+
+template <class T> inline Slab_Pool<T>::~Slab_Pool()
+{
+  size_t i;
+
+  for (i = 0; i < slabs.size(); i++) ::operator delete(slabs[i]);
+}
+
+template <class T> inline void Slab_Pool<T>::new_slab(size_t n)
+{
+  slabs.push_back((Slot *) ::operator new(n * sizeof(Slot)));
+  slab_objects = n;
+  next = 0;
+}
+
+template <class T> template <class... Args> inline T *Slab_Pool<T>::make(Args&&... args)
+{
+  Slot *s;
+  T *p;
+
+  if (free_list != nullptr) {
+    s = free_list;
+    free_list = s->next_free;
+  } else {
+    if (slabs.size() == 0 || next == slab_objects) {
+      new_slab((slab_objects == 0) ? 64 : ((slab_objects >= 4096) ? 4096 : slab_objects * 2));
+    }
+    s = slabs.back() + next;
+    next++;
+  }
+
+  try {
+    p = new ((void *) s->bytes) T(std::forward<Args>(args)...);
+  } catch (...) {
+    s->next_free = free_list;
+    free_list = s;
+    throw;
+  }
+  return p;
+}
+
+template <class T> inline void Slab_Pool<T>::release(T *p)
+{
+  Slot *s;
+
+  p->~T();
+  s = (Slot *) (void *) p;
+  s->next_free = free_list;
+  free_list = s;
+}
+
+template <class T> inline void Slab_Pool<T>::reserve(size_t n)
+{
+  size_t avail;
+  Slot *s;
+
+  avail = (slabs.size() == 0) ? 0 : slab_objects - next;
+  for (s = free_list; s != nullptr && avail < n; s = s->next_free) avail++;
+  if (avail >= n) return;
+
+  /* Put the rest of the current slab on the free list, and then make one slab that
+     holds the rest. */
+
+  while (slabs.size() != 0 && next < slab_objects) {
+    s = slabs.back() + next;
+    s->next_free = free_list;
+    free_list = s;
+    next++;
+  }
+  new_slab(n - avail);
+}
+
+}
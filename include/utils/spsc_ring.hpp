@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/* SPSC_Ring is a bounded, lock-free queue for exactly one producer thread and exactly
+   one consumer thread.  The producer only writes tail, and the consumer only writes
+   head, so neither ever waits on the other: push() fails when the ring is full, and
+   pop() fails when it's empty.  The capacity is rounded up to a power of two.
+
+   The processors use these for their streaming spike ports.  Don't use one ring
+   from more than one producer or more than one consumer. */
+
+namespace neuro
+{
+
+template <class T> class SPSC_Ring {
+  public:
+    SPSC_Ring(size_t capacity);
+
+    bool     push(const T &v);     /* Producer only.  Returns false (and counts a drop) if full. */
+    bool     pop(T &v);            /* Consumer only.  Returns false if empty. */
+    size_t   size() const;         /* Approximate when the other thread is active. */
+    size_t   capacity() const;
+    uint64_t dropped() const;      /* The number of pushes that failed because the ring was full. */
+    void     reject();             /* Consumer only.  Counts a popped entry that it couldn't use. */
+    uint64_t rejected() const;     /* The number of reject() calls. */
+
+  protected:
+    std::vector <T> buf;
+    size_t mask;
+
+    /* head and tail are kept on separate cache lines so that the two threads don't
+       keep stealing the line from each other. */
+
+    char pad0[64];
+    std::atomic <size_t> head;     /* Next slot to pop.  Written by the consumer. */
+    std::atomic <uint64_t> rejects; /* Written by the consumer. */
+    char pad1[64];
+    std::atomic <size_t> tail;     /* Next slot to push.  Written by the producer. */
+    std::atomic <uint64_t> drops;  /* Written by the producer. */
+    char pad2[64];
+};
+
+template <class T> inline SPSC_Ring<T>::SPSC_Ring(size_t capacity)
+{
+  size_t c;
+
+  c = 1;
+  while (c < capacity) c <<= 1;
+  buf.resize(c);
+  mask = c - 1;
+  head.store(0);
+  tail.store(0);
+  drops.store(0);
+  rejects.store(0);
+}
+
+template <class T> inline bool SPSC_Ring<T>::push(const T &v)
+{
+  size_t t;
+
+  t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) > mask) {
+    drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return false;
+  }
+  buf[t & mask] = v;
+  tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+template <class T> inline bool SPSC_Ring<T>::pop(T &v)
+{
+  size_t h;
+
+  h = head.load(std::memory_order_relaxed);
+  if (h == tail.load(std::memory_order_acquire)) return false;
+  v = buf[h & mask];
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+template <class T> inline size_t SPSC_Ring<T>::size() const
+{
+  return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template <class T> inline size_t SPSC_Ring<T>::capacity() const
+{
+  return buf.size();
+}
+
+template <class T> inline uint64_t SPSC_Ring<T>::dropped() const
+{
+  return drops.load(std::memory_order_relaxed);
+}
+
+template <class T> inline void SPSC_Ring<T>::reject()
+{
+  rejects.store(rejects.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <class T> inline uint64_t SPSC_Ring<T>::rejected() const
+{
+  return rejects.load(std::memory_order_relaxed);
+}
+
+}
@@ -6,6 +6,8 @@
 #include "utils/alignment_helpers.hpp"
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 using namespace neuro;
 using namespace std;
@@ -13,16 +15,29 @@ namespace vrisp {
 class Network;
 class Processor;
 
+/** The parts of a loaded network that never change: where each synapse goes, and
+ * its delay.  Networks made by clone_network() share a single copy of these. */
+struct Topology {
+    vector<vector<uint16_t, AlignmentAllocator<uint16_t>>>
+        synapse_to; /**< Which neuron does this synapse go to*/
+    vector<vector<uint8_t, AlignmentAllocator<uint8_t>>>
+        synapse_delay; /**< How much delay does this synapse have*/
+};
+
 class Network {
   public:
     /** Convert network in framework format to an internal vrisp network */
 
     Network(neuro::Network* net, double _min_potential, char leak,
             size_t tracked_timesteps, double spike_value_factor);
+
+    /** Copy an already-built network and its state, sharing the topology */
+    Network(const Network& src);
     ~Network();
 
     /* Mirror calls from the Processor API */
     void apply_spike(const Spike& s, bool normalized = true);
+    void apply_spikes(const SpikeBatch& batch, size_t begin, size_t end);
     void run(size_t duration);
     double get_time();
 
@@ -42,14 +57,44 @@ class Network {
     vector<vector<double>> neuron_vectors();
 
     vector<double> neuron_charges();
+
+    /* The same, written into the caller's buffer of n entries. */
+    size_t output_last_fires(double* buf, size_t n);
+    size_t output_counts(int* buf, size_t n);
+    size_t output_vectors(double* times, size_t n, size_t* counts,
+                          size_t num_counts);
+    size_t neuron_counts(int* buf, size_t n);
+    size_t neuron_last_fires(double* buf, size_t n);
+    size_t neuron_charges(double* buf, size_t n);
+
     void synapse_weights(vector<uint32_t>& pres, vector<uint32_t>& posts,
                          vector<double>& vals);
+    void set_synapse_weights(const vector<uint32_t>& pres,
+                             const vector<uint32_t>& posts,
+                             const vector<double>& vals);
+    void set_neuron_thresholds(const vector<uint32_t>& ids,
+                               const vector<double>& vals);
+    void apply_patch(const NetworkPatch& patch, int threshold_idx,
+                     int leak_idx, int weight_idx, int delay_idx);
 
     void clear_activity();
     void clear_output_tracking();
+    void run_batch(const SpikeBatch& batch, size_t duration, BatchResult& rv);
+
+    void save_state(vector<uint8_t>& state);
+    void restore_state(const vector<uint8_t>& state);
+
+    void open_spike_streams(size_t capacity);
+    SpikeStream* input_stream();
+    SpikeStream* output_stream();
 
   protected:
     void process_events(uint32_t time); /**< Process events at time "time" */
+    void make_synapse_index(); /**< Create synapse_index */
+    int find_synapse(uint32_t from, uint32_t to); /**< Index in synapse_to[from], or -1 */
+    bool is_neuron(uint32_t node_id);
+    void drain_input_stream(uint32_t time); /**< Apply input stream spikes */
+    void stream_fire(size_t node_id, uint32_t time); /**< Push an output fire */
 
     vector<bool> inputs;
     vector<bool> outputs;
@@ -69,10 +114,10 @@ class Network {
                  Timestep of last firing for this neuron */
     vector<int8_t, AlignmentAllocator<int8_t>>
         neuron_threshold; /**< Neuron's threshold*/
-    vector<vector<uint16_t, AlignmentAllocator<uint16_t>>>
-        synapse_to; /**< Which neuron does this synapse go to*/
-    vector<vector<uint8_t, AlignmentAllocator<uint8_t>>>
-        synapse_delay; /**< How much delay does this synapse have*/
+    shared_ptr<const Topology> topology; /**< Synapse targets and delays */
+    unordered_map<uint64_t, uint32_t>
+        synapse_index; /**< (from << 32 | to) -> index in synapse_to[from].
+                          Empty until set_synapse_weights() needs it. */
     vector<vector<int8_t, AlignmentAllocator<int8_t>>>
         synapse_weight;           /**< What is this synapses weight*/
     int8_t* neuron_charge_buffer; /**< Ring buffer for each neuron, this is a
@@ -88,6 +133,11 @@ class Network {
                              if less than. */
     char leak_mode; /**< 'a' for all, 'n' for nothing, 'c' for configurable */
     double spike_value_factor;
+
+    SpikeStream* in_stream;  /**< Streaming input port, or NULL */
+    SpikeStream* out_stream; /**< Streaming output port, or NULL */
+    vector<int> node_output_ids; /**< Output id of each node (or -1), for
+                                    out_stream */
 };
 
 class Processor : public neuro::Processor {
@@ -110,6 +160,7 @@ class Processor : public neuro::Processor {
                       int network_id = 0);
     void apply_spikes(const vector<Spike>& s, const vector<int>& network_ids,
                       bool normalized = true);
+    void apply_spikes(const SpikeBatch& batch, int network_id = 0);
 
     /* Run the network(s) for the desired time with queued inputs */
 
@@ -145,12 +196,47 @@ class Processor : public neuro::Processor {
 
     vector<double> neuron_charges(int network_id = 0);
 
+    /* The same, written into the caller's buffer, without allocating memory */
+    size_t output_last_fires(double* buf, size_t n, int network_id = 0);
+    size_t output_counts(int* buf, size_t n, int network_id = 0);
+    size_t output_vectors(double* times, size_t n, size_t* counts,
+                          size_t num_counts, int network_id = 0);
+    size_t neuron_counts(int* buf, size_t n, int network_id = 0);
+    size_t neuron_last_fires(double* buf, size_t n, int network_id = 0);
+    size_t neuron_charges(double* buf, size_t n, int network_id = 0);
+
     void synapse_weights(vector<uint32_t>& pres, vector<uint32_t>& posts,
                          vector<double>& vals, int network_id = 0);
 
+    /* In-place updates of weights and thresholds */
+    void set_synapse_weights(const vector<uint32_t>& pres,
+                             const vector<uint32_t>& posts,
+                             const vector<double>& vals, int network_id = 0);
+    void set_neuron_thresholds(const vector<uint32_t>& ids,
+                               const vector<double>& vals, int network_id = 0);
+
+    /* Change a loaded network in place, unless neurons or I/O change */
+    bool apply_network_patch(const NetworkPatch& patch, int network_id = 0);
+
+    /* Run many samples, each from cleared activity */
+    BatchResult run_batch(const SpikeBatch& batch, double duration,
+                          int network_id = 0);
+
     /* Remove state, keep network loaded */
     void clear_activity(int network_id = 0);
 
+    /* Copy a loaded network (and its state) to another network id */
+    void clone_network(int src_network_id, int dst_network_id);
+
+    /* Snapshots of the network's dynamic state */
+    vector<uint8_t> save_state(int network_id = 0);
+    void restore_state(const vector<uint8_t>& state, int network_id = 0);
+
+    /* Streaming spike ports */
+    void open_spike_streams(size_t capacity, int network_id = 0);
+    SpikeStream* input_stream(int network_id = 0);
+    SpikeStream* output_stream(int network_id = 0);
+
     /* Network/Processor Properties */
     PropertyPack get_network_properties() const;
     json get_processor_properties() const;
@@ -45,10 +45,19 @@ for i in $t ; do
   ( echo M vrisp tmp_proc_params.txt
     echo EMPTYNET tmp_empty_network.txt ) | bin/processor_tool_vrisp
 
-  # Use network_tool.txt to create the network.
+  # Use network_tool.txt to create the network.  If there's a correct_nt_output.txt,
+  # then the network_tool output has to match it.  Otherwise, it has to be empty.
 
   bin/network_tool < vrisp_testing/$i/network_tool.txt > tmp_nt_output.txt 2>&1
-  if [ `wc tmp_nt_output.txt | awk '{ print $1 }'` != 0 ]; then
+  if [ -f vrisp_testing/$i/correct_nt_output.txt ]; then
+    if [ `diff tmp_nt_output.txt vrisp_testing/$i/correct_nt_output.txt | wc | awk '{ print $1 }'` != 0 ]; then
+      echo "Test $i - $l" >&2
+      echo "Error: The network_tool output does not match the correct output." >&2
+      echo "       Output file is tmp_nt_output.txt" >&2
+      echo "       Correct output file is vrisp_testing/$i/correct_nt_output.txt" >&2
+      exit 1
+    fi
+  elif [ `wc tmp_nt_output.txt | awk '{ print $1 }'` != 0 ]; then
     echo "Test $i - $l" >&2
     echo "There was an error in the network_tool command when I ran:" >&2
     echo "" >&2
@@ -88,6 +97,7 @@ for i in $t ; do
   if [ $keep = no ]; then
     rm -f tmp_proc_params.txt \
           tmp_network.txt \
+          tmp_network_2.txt \
           tmp_nt_output.txt \
           tmp_pt_output.txt \
           tmp_pt_input.txt \
@@ -605,7 +605,8 @@ int main(int argc, char **argv)
     /* Finish up. */
 
     C.rv.make_sorted_node_vector();
-    cout << C.rv.pretty_json() << endl;
+    C.rv.write_json(cout, true);
+    cout << endl;
 
   } catch (SRE &e) {
     fprintf(stderr, "%s\n", e.what());
@@ -2,8 +2,18 @@
 #include <cstdio>
 #include "robinhood/robin_set.h"
 #include "utils/json_helpers.hpp"
+#include "utils/binary_helpers.hpp"
 #include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <queue>
 #include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 typedef std::runtime_error SRE;
 
@@ -51,16 +61,70 @@ static bool node_comp(Node *n1, Node *n2) { return (n1->id < n2->id); }
 
 void Node::set(int idx, double val)
 {
-    values.at(idx) = val;
+    double &v = (net != nullptr && net->m_columns) ?
+                net->own_column(net->m_node_columns.at(idx))[column_slot] : values.at(idx);
+
+    if (net != nullptr) net->hash_add(this, false);
+    v = val;
+    if (net != nullptr) net->hash_add(this, true);
+}
+
+vector <double> Node::get_values() const
+{
+    vector <double> rv;
+    size_t i;
+
+    if (net == nullptr || !net->m_columns) return values;
+    rv.resize(net->m_node_columns.size());
+    for (i = 0; i < rv.size(); i++) rv[i] = (*net->m_node_columns[i])[column_slot];
+    return rv;
+}
+
+void Node::set_values(const vector <double> &v)
+{
+    size_t i;
+
+    if (net == nullptr) {
+      values = v;
+    } else if (!net->m_columns) {
+      net->hash_add(this, false);
+      values = v;
+      net->hash_add(this, true);
+    } else {
+      if (v.size() != net->m_node_columns.size()) {
+        throw SRE("Node::set_values() - the vector's size doesn't match the PropertyPack");
+      }
+      net->hash_add(this, false);
+      for (i = 0; i < v.size(); i++) net->own_column(net->m_node_columns[i])[column_slot] = v[i];
+      net->hash_add(this, true);
+    }
+}
+
+/* These return n's values.  If the column store is on, they are copied into tmp. */
+
+static const vector <double> &values_of(const Node *n, vector <double> &tmp)
+{
+  if (n->net == nullptr || !n->net->columns_enabled()) return n->values;
+  tmp = n->get_values();
+  return tmp;
+}
+
+static const vector <double> &values_of(const Edge *e, vector <double> &tmp)
+{
+  if (e->net == nullptr || !e->net->columns_enabled()) return e->values;
+  tmp = e->get_values();
+  return tmp;
 }
 
 static json node_json(Node *n)
 {
   json rv;
+  vector <double> tmp;
+  const vector <double> &v = values_of(n, tmp);
 
   rv = json::object();
   rv["id"] = n->id;
-  rv["values"] = (n->values.size() == 0) ? json::array() : (json) n->values;
+  rv["values"] = (v.size() == 0) ? json::array() : (json) v;
   if (n->name != "") rv["name"] = n->name;
   if (n->coordinates.size() != 0) rv["coords"] = n->coordinates;
   return rv;
@@ -68,14 +132,15 @@ static json node_json(Node *n)
 
 /* JSP - want to keep the local variable allocation out of the common path. */
 
-static void tl_ne_set_error(const string &ne, const string &name, double val, const Property &p)
+static void tl_ne_set_error(const string &ne, const string &name, double val,
+                            double min_value, double max_value)
 {
   string estring;
   char buf[200];
 
   snprintf(buf, 200, "%lg", val);
   estring = ne + "::set(" + name + "," + buf + ") - Error: val must be in the range: ";
-  snprintf(buf, 200, "[%lg,%lg].", p.min_value, p.max_value);
+  snprintf(buf, 200, "[%lg,%lg].", min_value, max_value);
   estring += buf;
   throw SRE(estring);
 }
@@ -87,7 +152,9 @@ void Node::set(const string& name, double val)
   if(net == nullptr) throw std::runtime_error("No Network pointer is set for this node");
    
   Property p = net->m_properties.nodes.at(name);
-  if (val < p.min_value || val > p.max_value) tl_ne_set_error("Node", name, val, p);
+  if (val < p.min_value || val > p.max_value) {
+    tl_ne_set_error("Node", name, val, p.min_value, p.max_value);
+  }
 
   idx = net->m_properties.nodes.at(name).index;
   set(idx, val);
@@ -95,6 +162,7 @@ void Node::set(const string& name, double val)
 
 double Node::get(int idx)
 {
+    if (net != nullptr && net->m_columns) return (*net->m_node_columns.at(idx))[column_slot];
     return values.at(idx);
 }
 
@@ -105,21 +173,74 @@ double Node::get(const string& name)
     return get(idx);
 }
 
+void Node::set(const PropertyHandle& h, double val)
+{
+    if (h.kind != PropertyHandle::NODE) throw SRE("Node::set() - " + h.name + " is not a node property");
+    if (val < h.min_value || val > h.max_value) {
+      tl_ne_set_error("Node", h.name, val, h.min_value, h.max_value);
+    }
+    set(h.index, val);
+}
+
+double Node::get(const PropertyHandle& h)
+{
+    if (h.kind != PropertyHandle::NODE) throw SRE("Node::get() - " + h.name + " is not a node property");
+    return get(h.index);
+}
+
 json Edge::as_json() const
 {
   json rv;
+  vector <double> tmp;
+  const vector <double> &v = values_of(this, tmp);
 
   rv = json::object();
   rv["from"] = from->id;
   rv["to"] = to->id;
-  rv["values"] = (values.size() == 0) ? json::array() : (json) values;
+  rv["values"] = (v.size() == 0) ? json::array() : (json) v;
   if (control_point.size() != 0) rv["control_point"] = control_point;
   return rv;
 }
 
 void Edge::set(int idx, double val)
 {
-    values.at(idx) = val;
+    double &v = (net != nullptr && net->m_columns) ?
+                net->own_column(net->m_edge_columns.at(idx))[column_slot] : values.at(idx);
+
+    if (net != nullptr) net->hash_add(this, false);
+    v = val;
+    if (net != nullptr) net->hash_add(this, true);
+}
+
+vector <double> Edge::get_values() const
+{
+    vector <double> rv;
+    size_t i;
+
+    if (net == nullptr || !net->m_columns) return values;
+    rv.resize(net->m_edge_columns.size());
+    for (i = 0; i < rv.size(); i++) rv[i] = (*net->m_edge_columns[i])[column_slot];
+    return rv;
+}
+
+void Edge::set_values(const vector <double> &v)
+{
+    size_t i;
+
+    if (net == nullptr) {
+      values = v;
+    } else if (!net->m_columns) {
+      net->hash_add(this, false);
+      values = v;
+      net->hash_add(this, true);
+    } else {
+      if (v.size() != net->m_edge_columns.size()) {
+        throw SRE("Edge::set_values() - the vector's size doesn't match the PropertyPack");
+      }
+      net->hash_add(this, false);
+      for (i = 0; i < v.size(); i++) net->own_column(net->m_edge_columns[i])[column_slot] = v[i];
+      net->hash_add(this, true);
+    }
 }
 
 void Edge::set(const string& name, double val)
@@ -127,7 +248,9 @@ void Edge::set(const string& name, double val)
     if(net == nullptr) throw SRE("No Network pointer is set for this edge");
 
     Property p = net->m_properties.edges.at(name);
-    if (val < p.min_value || val > p.max_value) tl_ne_set_error("Edge", name, val, p);
+    if (val < p.min_value || val > p.max_value) {
+      tl_ne_set_error("Edge", name, val, p.min_value, p.max_value);
+    }
 
     int idx = net->m_properties.edges.at(name).index;
     set(idx, val);
@@ -135,6 +258,7 @@ void Edge::set(const string& name, double val)
 
 double Edge::get(int idx)
 {
+    if (net != nullptr && net->m_columns) return (*net->m_edge_columns.at(idx))[column_slot];
     return values.at(idx);
 }
 
@@ -145,6 +269,21 @@ double Edge::get(const string& name)
     return get(idx);
 }
 
+void Edge::set(const PropertyHandle& h, double val)
+{
+    if (h.kind != PropertyHandle::EDGE) throw SRE("Edge::set() - " + h.name + " is not an edge property");
+    if (val < h.min_value || val > h.max_value) {
+      tl_ne_set_error("Edge", h.name, val, h.min_value, h.max_value);
+    }
+    set(h.index, val);
+}
+
+double Edge::get(const PropertyHandle& h)
+{
+    if (h.kind != PropertyHandle::EDGE) throw SRE("Edge::get() - " + h.name + " is not an edge property");
+    return get(h.index);
+}
+
 Network::Network(const Network& net)
 {
     copy_from(net);
@@ -213,37 +352,76 @@ bool Network::operator==(const Network &rhs) const
 
         if(e1->from->id != e2->from->id) return false;
         if(e1->to->id != e2->to->id) return false;
-        if(e1->values != e2->values) return false;
+        if(e1->get_values() != e2->get_values()) return false;
     }
 
-    if (m_associated_data != rhs.m_associated_data) return false;
+    if (*m_associated_data != *rhs.m_associated_data) return false;
 
     return true;
 }
 
 void Network::copy_from(const Network& net)
 {
+    if (&net == this) return;
+    clear(true);
+
     m_properties = net.m_properties;
 
-    // Copy nodes
-    for(auto& n : net.m_nodes)
-    {
-        Node *node = add_node(n.first);
-        
-        for(size_t i = 0; i < n.second->values.size(); i++)
+    // Size the hash tables and pools once, rather than growing them node by node.
+    reserve(net.m_nodes.size(), net.m_edges.size());
+
+    // If net's nodes are sorted, then add ours in that order, so that our
+    // sorted_node_vector is made by push_back()'s instead of a sort.
+    vector <const Node *> src_nodes;
+    if (net.m_sorted) {
+        src_nodes.assign(net.sorted_node_vector.begin(), net.sorted_node_vector.end());
+        sorted_node_vector.reserve(src_nodes.size());
+        m_sorted = true;
+    } else {
+        src_nodes.reserve(net.m_nodes.size());
+        for (auto& n : net.m_nodes) src_nodes.push_back(n.second.get());
+    }
+
+    if (net.m_columns) {
+
+        // Share net's columns (copy-on-write).  Each node and edge gets the same
+        // column_slot that it has in net, so nothing is copied per node or edge.
+        m_columns = true;
+        m_node_columns = net.m_node_columns;
+        m_edge_columns = net.m_edge_columns;
+        for(auto n : src_nodes)
         {
-            node->values[i] = n.second->values[i];
+            Node *node = new_node(n->id);
+            node->column_slot = n->column_slot;
+            node->name = n->name;
         }
-    }
 
-    // Copy edges
-    for(auto& e : net.m_edges)
-    {
-        Edge *edge = add_edge(e.first.first, e.first.second);
+        for(auto& e : net.m_edges)
+        {
+            Edge *edge = new_edge(e.first.first, e.first.second);
+            edge->column_slot = e.second->column_slot;
+        }
+
+        // new_node() and new_edge() appended them to the slot vectors, so put them
+        // in their slots.
+        for (auto &n : m_nodes) m_column_nodes[n.second->column_slot] = n.second.get();
+        for (auto &e : m_edges) m_column_edges[e.second->column_slot] = e.second.get();
+
+    } else {
 
-        for(size_t i = 0; i < e.second->values.size(); i++)
+        // Copy nodes
+        for(auto n : src_nodes)
         {
-            edge->values[i] = e.second->values[i];
+            Node *node = add_node(n->id);
+            node->values = n->values;
+            node->name = n->name;
+        }
+
+        // Copy edges
+        for(auto& e : net.m_edges)
+        {
+            Edge *edge = add_edge(e.first.first, e.first.second);
+            edge->values = e.second->values;
         }
     }
 
@@ -255,22 +433,47 @@ void Network::copy_from(const Network& net)
     for(auto o : net.m_outputs)
         add_output(o);
 
-    m_associated_data = net.m_associated_data;
+    m_associated_data = net.m_associated_data;   // Shared until one of us changes it
     values = net.values;
-    sorted_node_vector.clear();
+    m_hash_valid = net.m_hash_valid;
+    m_hash[0] = net.m_hash[0];
+    m_hash[1] = net.m_hash[1];
 }
 
 void Network::move_from(Network&& net)
 {
     m_properties = std::move(net.m_properties);
 
-    m_nodes = std::move(net.m_nodes);
+    // Our old nodes and edges go back to our pools when they're replaced.  Then we
+    // take net's pools, since its nodes and edges (now ours) came from them.
     m_edges = std::move(net.m_edges);
+    m_nodes = std::move(net.m_nodes);
+    std::swap(m_node_pool, net.m_node_pool);
+    std::swap(m_edge_pool, net.m_edge_pool);
+
+    m_columns = net.m_columns;
+    m_node_columns = std::move(net.m_node_columns);
+    m_edge_columns = std::move(net.m_edge_columns);
+    m_column_nodes = std::move(net.m_column_nodes);
+    m_column_edges = std::move(net.m_column_edges);
+    net.m_columns = false;
+
+    // The nodes and edges have to point to their new network.
+    for (auto &n : m_nodes) n.second->net = this;
+    for (auto &e : m_edges) e.second->net = this;
     m_inputs = std::move(net.m_inputs);
     m_outputs = std::move(net.m_outputs);
     m_associated_data = std::move(net.m_associated_data);
+    net.m_associated_data = std::make_shared<json>();
     values = std::move(net.values);
-    sorted_node_vector.clear();
+    m_hash_valid = net.m_hash_valid;
+    m_hash[0] = net.m_hash[0];
+    m_hash[1] = net.m_hash[1];
+    net.m_hash_valid = false;
+    sorted_node_vector = std::move(net.sorted_node_vector);
+    m_sorted = net.m_sorted;
+    net.sorted_node_vector.clear();
+    net.m_sorted = false;
 }
 
 void Network::clear(bool include_properties)
@@ -283,8 +486,23 @@ void Network::clear(bool include_properties)
   m_outputs.clear();
   m_nodes.clear();
   m_edges.clear();
-  m_associated_data = json::object();
+  m_associated_data = std::make_shared<json>(json::object());
+
+  // Clearing the properties turns off the column store.  Otherwise, it's emptied.
+  // The slot vectors are emptied either way.
+  m_column_nodes.clear();
+  m_column_edges.clear();
+  if (include_properties) {
+    m_columns = false;
+    m_node_columns.clear();
+    m_edge_columns.clear();
+  } else {
+    for (auto &c : m_node_columns) c = std::make_shared< vector <double> >();
+    for (auto &c : m_edge_columns) c = std::make_shared< vector <double> >();
+  }
+  m_hash_valid = false;
   sorted_node_vector.clear();
+  m_sorted = false;
 }
 
 json Network::as_json() const
@@ -324,7 +542,7 @@ void Network::to_json(json& j) const
 
     // Keep all associated data together as a dictionary entry in the network json
 
-    j["Associated_Data"] = (m_associated_data == nullptr) ? json::object() : m_associated_data;
+    j["Associated_Data"] = (*m_associated_data == nullptr) ? json::object() : *m_associated_data;
 }
 
 void Network::from_json(const json &j)
@@ -357,8 +575,10 @@ void Network::from_json(const json &j)
 
     // Get any associated data
 
-    m_associated_data = json::object();
-    if (j["Associated_Data"] != nullptr) m_associated_data = j["Associated_Data"];
+    m_associated_data = std::make_shared<json>(json::object());
+    if (j["Associated_Data"] != nullptr) *m_associated_data = j["Associated_Data"];
+
+    reserve(j["Nodes"].size(), j["Edges"].size());
 
     // Add nodes /w values
     // CHZ I didn't pass as reference because we may need to modify jn
@@ -419,39 +639,595 @@ void Network::from_json(const json &j)
     }
 }
 
+/* ------------------------------------------------------------ */
+/* Streaming JSON reader.  NetworkJsonSax gets its events from nlohmann's SAX parser.
+   Nodes and edges are built straight from the tokens, one object at a time, so the
+   network is never held as a json DOM.  The small top-level values (Properties,
+   Inputs, etc.) are still built as json.  Since the keys may come in any order
+   (dump() sorts them, so "Edges" comes before "Nodes" and "Properties" is last),
+   nodes that show up before the Properties, and edges that show up before the nodes
+   are done, are held in compact records until they can be added.  The error messages
+   are the same as from_json()'s. */
+
+struct JsonNodeRecord {
+  json id;
+  vector <double> values;
+  vector <double> coords;
+  string name;
+};
+
+struct JsonEdgeRecord {
+  json from;
+  json to;
+  vector <double> values;
+  vector <double> control_point;
+};
+
+class NetworkJsonSax {
+  public:
+    NetworkJsonSax(Network *n);
+
+    bool null();
+    bool boolean(bool val);
+    bool number_integer(json::number_integer_t val);
+    bool number_unsigned(json::number_unsigned_t val);
+    bool number_float(json::number_float_t val, const std::string &s);
+    bool string(std::string &val);
+    bool binary(json::binary_t &val);
+    bool start_object(size_t elements);
+    bool end_object();
+    bool start_array(size_t elements);
+    bool end_array();
+    bool key(std::string &val);
+    bool parse_error(size_t position, const std::string &last_token, 
+                     const nlohmann::detail::exception &ex);
+
+    void finish();                /* Check for missing keys, and add what's left. */
+
+    json top;                     /* The top-level values other than Nodes and Edges */
+
+  protected:
+    enum State { START, TOP, DOM, ITEMS_START, ITEMS, ITEM, NUMBERS, DONE };
+
+    void scalar(const json &v, const char *type_error);
+    void number(double d, const json &v);
+    void dom_insert(const json &v, bool container);
+    void end_dom();
+    void end_item();
+    void add_node(JsonNodeRecord &r);
+    void add_edge(JsonEdgeRecord &r);
+    void flush();
+    void bad_type(const std::string &k, const char *s);
+
+    Network *net;
+    State state;
+    bool in_nodes;                  /* Whether ITEMS is "Nodes" or "Edges" */
+    std::string top_key;            /* Current top-level key */
+    std::string item_key;           /* Current key in a node/edge */
+    std::string dom_key;            /* Current key in a DOM object */
+    vector <json *> dom_stack;      /* Open arrays/objects in a top-level value */
+    vector <double> *numbers;       /* Where NUMBERS go */
+
+    bool properties_done;
+    bool nodes_done;
+    size_t node_vec_size;           /* From the PropertyPack, once properties_done */
+    size_t edge_vec_size;
+    JsonNodeRecord node;
+    JsonEdgeRecord edge;
+    bool have_id, have_from, have_to, have_values;   /* Keys seen in the node/edge */
+    vector <JsonNodeRecord> pending_nodes;
+    vector <JsonEdgeRecord> pending_edges;
+};
+
+NetworkJsonSax::NetworkJsonSax(Network *n)
+{
+  net = n;
+  state = START;
+  in_nodes = false;
+  numbers = nullptr;
+  properties_done = false;
+  nodes_done = false;
+  node_vec_size = 0;
+  edge_vec_size = 0;
+  top = json::object();
+}
+
+void NetworkJsonSax::bad_type(const std::string &k, const char *s)
+{
+  throw SRE("Parameter " + k + ": " + s + "\n");
+}
+
+/* Scalars go to a DOM that's being built, or to the node/edge field. */
+
+void NetworkJsonSax::scalar(const json &v, const char *type_error)
+{
+  switch (state) {
+    case START:
+      throw SRE("JSON is not an object.\n");
+    case DOM:
+      dom_insert(v, false);
+      break;
+    case ITEMS_START:
+      bad_type(top_key, "must be a json array.");
+      break;
+    case ITEMS:
+      if (v.is_null()) {
+        throw SRE((in_nodes) ? "Missing parameter \"id\"\nMissing parameter \"values\"\n"
+                             : "Missing parameter \"from\"\nMissing parameter \"to\"\nMissing parameter \"values\"\n");
+      }
+      throw SRE("JSON is not an object.\n");
+    case ITEM:
+      if (item_key == "name") {
+        if (!v.is_string()) bad_type(item_key, "must be a string.");
+        node.name = v.get<std::string>();
+      } else if (item_key == "id" || item_key == "from" || item_key == "to") {
+        if (!v.is_number()) bad_type(item_key, "must be a number.");
+        if (item_key == "id") node.id = v;
+        if (item_key == "from") edge.from = v;
+        if (item_key == "to") edge.to = v;
+      } else {
+        bad_type(item_key, "must be a json array.");
+      }
+      break;
+    case NUMBERS:
+      throw SRE((std::string) "[json.exception.type_error.302] type must be number, but is " + type_error);
+    default:
+      break;
+  }
+}
+
+void NetworkJsonSax::number(double d, const json &v)
+{
+  if (state == NUMBERS) {
+    numbers->push_back(d);
+  } else {
+    scalar(v, "number");
+  }
+}
+
+bool NetworkJsonSax::null() { scalar(json(), "null"); return true; }
+bool NetworkJsonSax::boolean(bool val) { scalar(json(val), "boolean"); return true; }
+bool NetworkJsonSax::number_integer(json::number_integer_t val) { number(val, json(val)); return true; }
+bool NetworkJsonSax::number_unsigned(json::number_unsigned_t val) { number(val, json(val)); return true; }
+bool NetworkJsonSax::number_float(json::number_float_t val, const std::string &) { number(val, json(val)); return true; }
+bool NetworkJsonSax::string(std::string &val) { scalar(json(val), "string"); return true; }
+bool NetworkJsonSax::binary(json::binary_t &) { scalar(json(), "binary"); return true; }
+
+/* Add a value to the DOM that's being built.  Containers are pushed on dom_stack. */
+
+void NetworkJsonSax::dom_insert(const json &v, bool container)
+{
+  json *p;
+
+  if (dom_stack.size() == 0) {
+    top[top_key] = v;
+    p = &top[top_key];
+  } else if (dom_stack.back()->is_array()) {
+    dom_stack.back()->push_back(v);
+    p = &dom_stack.back()->back();
+  } else {
+    (*dom_stack.back())[dom_key] = v;
+    p = &(*dom_stack.back())[dom_key];
+  }
+  if (container) {
+    dom_stack.push_back(p);
+  } else if (dom_stack.size() == 0) {
+    end_dom();
+  }
+}
+
+/* A top-level value is complete.  Check its type, like Parameter_Check_Json_T(). */
+
+void NetworkJsonSax::end_dom()
+{
+  const json &v = top[top_key];
+  PropertyPack pp;
+
+  state = TOP;
+  if (top_key == "Properties" || top_key == "Associated_Data") {
+    if (!v.is_object()) bad_type(top_key, "must be a json object.");
+  } else if (!v.is_array()) {
+    bad_type(top_key, "must be a json array.");
+  }
+
+  if (top_key == "Properties") {
+    pp.from_json(v);
+    net->set_properties(pp);
+    node_vec_size = pp.node_vec_size;
+    edge_vec_size = pp.edge_vec_size;
+    properties_done = true;
+    flush();
+  }
+}
+
+bool NetworkJsonSax::start_object(size_t)
+{
+  switch (state) {
+    case START: state = TOP; break;
+    case DOM: dom_insert(json::object(), true); break;
+    case ITEMS_START: bad_type(top_key, "must be a json array."); break;
+    case ITEMS:
+      state = ITEM;
+      have_id = false;
+      have_from = false;
+      have_to = false;
+      have_values = false;
+      if (in_nodes) {
+        node.id = json();
+        node.values.clear();
+        node.coords.clear();
+        node.name.clear();
+      } else {
+        edge.from = json();
+        edge.to = json();
+        edge.values.clear();
+        edge.control_point.clear();
+      }
+      break;
+    case ITEM:
+      if (item_key == "name") bad_type(item_key, "must be a string.");
+      if (item_key == "id" || item_key == "from" || item_key == "to") {
+        bad_type(item_key, "must be a number.");
+      }
+      bad_type(item_key, "must be a json array.");
+      break;
+    case NUMBERS:
+      throw SRE("[json.exception.type_error.302] type must be number, but is object");
+    default: break;
+  }
+  return true;
+}
+
+bool NetworkJsonSax::end_object()
+{
+  switch (state) {
+    case TOP: state = DONE; break;
+    case DOM:
+      dom_stack.pop_back();
+      if (dom_stack.size() == 0) end_dom();
+      break;
+    case ITEM: end_item(); state = ITEMS; break;
+    default: break;
+  }
+  return true;
+}
+
+bool NetworkJsonSax::start_array(size_t)
+{
+  switch (state) {
+    case START: throw SRE("JSON is not an object.\n");
+    case DOM: dom_insert(json::array(), true); break;
+    case ITEMS_START: state = ITEMS; break;
+    case ITEMS: throw SRE("JSON is not an object.\n");
+    case ITEM:
+      if (item_key == "values") {
+        numbers = (in_nodes) ? &node.values : &edge.values;
+      } else if (item_key == "coords") {
+        numbers = &node.coords;
+      } else if (item_key == "control_point") {
+        numbers = &edge.control_point;
+      } else {
+        scalar(json::array(), "array");
+      }
+      numbers->clear();
+      state = NUMBERS;
+      break;
+    case NUMBERS:
+      throw SRE("[json.exception.type_error.302] type must be number, but is array");
+    default: break;
+  }
+  return true;
+}
+
+bool NetworkJsonSax::end_array()
+{
+  switch (state) {
+    case DOM:
+      dom_stack.pop_back();
+      if (dom_stack.size() == 0) end_dom();
+      break;
+    case ITEMS:
+      state = TOP;
+      if (in_nodes) nodes_done = true;
+      flush();
+      break;
+    case NUMBERS: state = ITEM; break;
+    default: break;
+  }
+  return true;
+}
+
+bool NetworkJsonSax::key(std::string &val)
+{
+  if (state == TOP) {
+    if (!network_specs.contains(val) || val == "Necessary") {
+      throw SRE("Illegal parameter: " + val + "\n");
+    }
+    top_key = val;
+    if (val == "Nodes" || val == "Edges") {
+      in_nodes = (val == "Nodes");
+      state = ITEMS_START;
+      top[top_key] = json::array();  /* Just to mark it as seen. */
+    } else {
+      state = DOM;
+    }
+  } else if (state == ITEM) {
+    if (!(in_nodes ? node_specs : edge_specs).contains(val) || val == "Necessary") {
+      throw SRE("Illegal parameter: " + val + "\n");
+    }
+    item_key = val;
+    if (val == "id") have_id = true;
+    if (val == "from") have_from = true;
+    if (val == "to") have_to = true;
+    if (val == "values") have_values = true;
+  } else if (state == DOM) {
+    dom_key = val;
+  }
+  return true;
+}
+
+bool NetworkJsonSax::parse_error(size_t, const std::string &, const nlohmann::detail::exception &ex)
+{
+  throw SRE(ex.what());
+}
+
+/* A node or edge is complete.  Check for missing keys, and then add it or hold it. */
+
+void NetworkJsonSax::end_item()
+{
+  std::string estring;
+
+  if (in_nodes && !have_id) estring += "Missing parameter \"id\"\n";
+  if (!in_nodes && !have_from) estring += "Missing parameter \"from\"\n";
+  if (!in_nodes && !have_to) estring += "Missing parameter \"to\"\n";
+  if (!have_values) estring += "Missing parameter \"values\"\n";
+  if (estring != "") throw SRE(estring);
+
+  if (in_nodes) {
+    if (properties_done) {
+      add_node(node);
+    } else {
+      pending_nodes.push_back(node);
+    }
+  } else {
+    if (properties_done && nodes_done && pending_nodes.size() == 0) {
+      add_edge(edge);
+    } else {
+      pending_edges.push_back(edge);
+    }
+  }
+}
+
+void NetworkJsonSax::add_node(JsonNodeRecord &r)
+{
+  Node *n;
+
+  n = net->add_node(r.id.get<uint32_t>());
+  n->values.swap(r.values);
+  if (n->values.size() != node_vec_size) {
+    throw SRE("Error in the network JSON: Node " + r.id.dump() +
+              "'s value array's size does not match the node PropertyPack");
+  }
+  n->coordinates.swap(r.coords);
+  n->name.swap(r.name);
+}
+
+void NetworkJsonSax::add_edge(JsonEdgeRecord &r)
+{
+  Edge *e;
+
+  e = net->add_edge(r.from.get<uint32_t>(), r.to.get<uint32_t>());
+  e->values.swap(r.values);
+  if (e->values.size() != edge_vec_size) {
+    throw SRE("Error in the network JSON: Edge " + r.from.dump() + "->" + r.to.dump() +
+              "'s value array's size does not match the edge PropertyPack");
+  }
+  e->control_point.swap(r.control_point);
+}
+
+/* Add the pending nodes and edges that can be added now. */
+
+void NetworkJsonSax::flush()
+{
+  size_t i;
+
+  if (!properties_done) return;
+  for (i = 0; i < pending_nodes.size(); i++) add_node(pending_nodes[i]);
+  vector <JsonNodeRecord>().swap(pending_nodes);
+  if (!nodes_done) return;
+  for (i = 0; i < pending_edges.size(); i++) add_edge(pending_edges[i]);
+  vector <JsonEdgeRecord>().swap(pending_edges);
+}
+
+void NetworkJsonSax::finish()
+{
+  std::string estring;
+  size_t i;
+
+  if (state != DONE) throw SRE("JSON is not an object.\n");
+  for (i = 0; i < network_specs["Necessary"].size(); i++) {
+    if (!top.contains(network_specs["Necessary"][i])) {
+      estring += "Missing parameter " + network_specs["Necessary"][i].dump() + "\n";
+    }
+  }
+  if (estring != "") throw SRE(estring);
+  flush();
+}
+
+void Network::from_json_stream(std::istream &in)
+{
+  NetworkJsonSax sax(this);
+  json j;
+  string estring;
+  size_t i;
+  char buf[128];
+  uint32_t id;
+
+  clear(true);
+  json::sax_parse(in, &sax, json::input_format_t::json, false);
+  sax.finish();
+
+  /* Everything but the nodes and edges is in sax.top.  This follows from_json(). */
+
+  j = std::move(sax.top);
+  values = j["Network_Values"].get<vector <double>>();
+  if (values.size() != m_properties.net_vec_size) {
+    throw SRE((string) "Error in network JSON: " +
+              "Network_Value's array's size doesn't match the network Propery Pack");
+  }
+
+  m_associated_data = std::make_shared<json>(std::move(j["Associated_Data"]));
+
+  for (i = 0; i < j["Inputs"].size(); i++) {
+    if (j["Inputs"][i].get<double>() < 0) {
+      snprintf(buf, 128, "%d", (int) i);
+      estring = (string) "Bad Network JSON - Input[" + (string) buf + "] is < 0.";
+      throw SRE(estring);
+    }
+    id = j["Inputs"][i].get<uint32_t>();
+    add_input(id);
+  }
+
+  for (i = 0; i < j["Outputs"].size(); i++) {
+    if (j["Outputs"][i].get<double>() < 0) {
+      snprintf(buf, 128, "%d", (int) i);
+      estring = (string) "Bad Network JSON - Output[" + (string) buf + "] is < 0.";
+      throw SRE(estring);
+    }
+    id = j["Outputs"][i].get<uint32_t>();
+    add_output(id);
+  }
+}
+
 Node* Network::add_node(uint32_t idx)
 {
-    NodeMap::iterator nit;
-    bool inserted;
-    PropertyMap::iterator pit;
+    Node *n;
+
+    n = new_node(idx);
+    default_values(m_properties.nodes, m_properties.node_vec_size, n->values);
+    if (m_columns) column_add(n);
+    hash_add(n, true);
+
+    return n;
+}
+
+/* A new node's or edge's values are each property's max value. */
+
+void Network::default_values(const PropertyMap &pm, int size, vector <double> &v) const
+{
+    PropertyMap::const_iterator pit;
     int i;
+
+    v.resize(size);
+    for (pit = pm.begin(); pit != pm.end(); pit++) {
+      for (i = 0; i < pit->second.size; i++) v[pit->second.index+i] = pit->second.max_value;
+    }
+}
+
+void Network::reserve(size_t nodes, size_t edges)
+{
+    size_t i;
+
+    if (m_node_pool == nullptr) m_node_pool.reset(new Slab_Pool<Node>);
+    if (m_edge_pool == nullptr) m_edge_pool.reset(new Slab_Pool<Edge>);
+    if (nodes > m_nodes.size()) m_node_pool->reserve(nodes - m_nodes.size());
+    if (edges > m_edges.size()) m_edge_pool->reserve(edges - m_edges.size());
+    m_nodes.reserve(nodes);
+    m_edges.reserve(edges);
+    m_column_nodes.reserve(nodes);
+    m_column_edges.reserve(edges);
+    for (i = 0; i < m_node_columns.size(); i++) own_column(m_node_columns[i]).reserve(nodes);
+    for (i = 0; i < m_edge_columns.size(); i++) own_column(m_edge_columns[i]).reserve(edges);
+}
+
+/* These add a batch of nodes or edges, sizing the tables once and making the default
+   values once.  The new nodes/edges are at the end of column_nodes()/column_edges().
+   If one can't be added (it's already there, or twice in the batch), the ones that were
+   added are taken back out, so the network is as it was, and they throw. */
+
+void Network::add_nodes(const vector <uint32_t> &ids)
+{
+    vector <double> defaults;
+    Node *n;
+    size_t i, j;
+
+    reserve(m_nodes.size() + ids.size(), m_edges.size());
+    default_values(m_properties.nodes, m_properties.node_vec_size, defaults);
+    for (i = 0; i < ids.size(); i++) {
+      try {
+        n = new_node(ids[i]);
+      } catch (SRE &e) {
+        for (j = i; j > 0; j--) remove_node(ids[j-1]);
+        throw;
+      }
+      n->values = defaults;
+      if (m_columns) column_add(n);
+      hash_add(n, true);
+    }
+}
+
+void Network::add_edges(const vector < pair <uint32_t, uint32_t> > &edges)
+{
+    vector < pair <Node *, Node *> > ends;
+    vector <double> defaults;
+    NodeMap::iterator fit, tit;
     char buf[200];
+    Edge *e;
+    size_t i, j;
 
-    if (is_node(idx)) {
-      snprintf(buf, 200, "Node %d already exists at specified index.", idx);
-      throw SRE(buf);
+    /* Look up the nodes first, since that's an error that's easy to check for. */
+
+    ends.resize(edges.size());
+    for (i = 0; i < edges.size(); i++) {
+      fit = m_nodes.find(edges[i].first);
+      tit = m_nodes.find(edges[i].second);
+      if (fit == m_nodes.end() || tit == m_nodes.end()) {
+        snprintf(buf, 200, "Unable to get node %u and/or %u", edges[i].first, edges[i].second);
+        throw SRE(buf);
+      }
+      ends[i] = make_pair(fit->second.get(), tit->second.get());
+    }
+
+    reserve(m_nodes.size(), m_edges.size() + edges.size());
+    default_values(m_properties.edges, m_properties.edge_vec_size, defaults);
+    for (i = 0; i < edges.size(); i++) {
+      e = insert_edge(ends[i].first, ends[i].second);
+      if (e == nullptr) {
+        for (j = i; j > 0; j--) remove_edge(edges[j-1].first, edges[j-1].second);
+        snprintf(buf, 200, "Edge %u -> %u already exists.", edges[i].first, edges[i].second);
+        throw SRE(buf);
+      }
+      e->values = defaults;
+      if (m_columns) column_add(e);
+      hash_add(e, true);
     }
+}
+
+/* This makes the node, without setting its values. */
+
+Node* Network::new_node(uint32_t idx)
+{
+    NodeMap::iterator nit;
+    bool inserted;
+    char buf[200];
 
     // insert to hash table & move ownership of pointer
-    std::tie(nit, inserted) = m_nodes.emplace(idx, make_unique<Node>(idx, this));
+    // The node comes from the pool, and goes back to it when its NodePtr is destroyed,
+    // which is right away if the node is already there.
+    if (m_node_pool == nullptr) m_node_pool.reset(new Slab_Pool<Node>);
+    std::tie(nit, inserted) = m_nodes.emplace(idx, NodePtr(m_node_pool->make(idx, this),
+                                                           m_node_pool.get()));
 
     if (!inserted) {
-      snprintf(buf, 200, "Could not insert node %u.", idx);
+      snprintf(buf, 200, "Node %u already exists at specified index.", idx);
       throw SRE(buf);
     }
 
-    // Any node addition or deletion invalidates the sorted_node_vector.
-    sorted_node_vector.clear();
+    // Every node has a slot in m_column_nodes, whether or not the column store is on.
+    nit->second->column_slot = m_column_nodes.size();
+    m_column_nodes.push_back(nit->second.get());
 
-    // resize the values vector to match properties
-    nit->second->values.resize(m_properties.node_vec_size);
-
-    // set each value to its max in the property pack
-    for (pit = m_properties.nodes.begin(); pit != m_properties.nodes.end(); pit++) {
-      for (i = 0; i < pit->second.size; i++) {
-        nit->second->values[pit->second.index+i] = pit->second.max_value;
-      }
-    }
+    sorted_insert(nit->second.get());
 
     return nit->second.get();
 }
@@ -465,18 +1241,26 @@ Node* Network::add_or_get_node(uint32_t idx)
 }
 
 Edge* Network::add_edge(uint32_t fr, uint32_t to)
+{
+    Edge *e;
+
+    e = new_edge(fr, to);
+    default_values(m_properties.edges, m_properties.edge_vec_size, e->values);
+    if (m_columns) column_add(e);
+    hash_add(e, true);
+
+    return e;
+}
+
+/* This makes the edge and hooks it to its nodes, without setting its values. */
+
+Edge* Network::new_edge(uint32_t fr, uint32_t to)
 {
     Node *from_node;
     Node *to_node;
-    PropertyMap::iterator pit;
-    int i;
+    Edge *e;
     char buf[200];
 
-    if (is_edge(fr, to)) {
-      snprintf(buf, 200, "Edge %u -> %u already exists.", fr, to);
-      throw SRE(buf);
-    }
-
     // get_node will throw if the node does not exist -- this will propagate through this call to prevent the edge
     try {
         from_node = get_node(fr);
@@ -487,24 +1271,29 @@ Edge* Network::add_edge(uint32_t fr, uint32_t to)
       throw SRE(buf);
     }
 
-    EdgeMap::iterator eit;
-    bool inserted;
+    e = insert_edge(from_node, to_node);
+    if (e == nullptr) {
+      snprintf(buf, 200, "Edge %u -> %u already exists.", fr, to);
+      throw SRE(buf);
+    }
+    return e;
+}
 
-    std::tie(eit, inserted) = m_edges.emplace(make_pair(fr, to), make_unique<Edge>(from_node, to_node, this));
+/* The rest of new_edge().  This returns nullptr if the edge is already there. */
 
-    if(!inserted) {
-       snprintf(buf, 200, "Could not insert edge %u -> %u", fr, to);
-       throw SRE(buf);
-    }
+Edge* Network::insert_edge(Node *from_node, Node *to_node)
+{
+    EdgeMap::iterator eit;
+    bool inserted;
 
-    // set the values to their max in the property_pack
+    if (m_edge_pool == nullptr) m_edge_pool.reset(new Slab_Pool<Edge>);
+    std::tie(eit, inserted) = m_edges.emplace(make_pair(from_node->id, to_node->id),
+                                EdgePtr(m_edge_pool->make(from_node, to_node, this),
+                                        m_edge_pool.get()));
+    if (!inserted) return nullptr;
 
-    eit->second->values.resize(m_properties.edge_vec_size);
-    for (pit = m_properties.edges.begin(); pit != m_properties.edges.end(); pit++) {
-      for (i = 0; i < pit->second.size; i++) {
-        eit->second->values[pit->second.index+i] = pit->second.max_value;
-      }
-    }
+    eit->second->column_slot = m_column_edges.size();
+    m_column_edges.push_back(eit->second.get());
 
     from_node->outgoing.push_back(eit->second.get());
     to_node->incoming.push_back(eit->second.get());
@@ -548,12 +1337,14 @@ void Network::rename_node(uint32_t old_name, uint32_t new_name)
 
     std::tie(nit, inserted) = m_nodes.emplace(new_name, std::move(m_nodes.at(old_name)));
     
-    // Any node addition or deletion invalidates the sorted_node_vector.
-    sorted_node_vector.clear();
+    // The node's and its edges' hashes change, so hash() will have to start over.
+    m_hash_valid = false;
    
     n = nit->second.get(); // we must get the node before we call erase otherwise we may lose it.
     m_nodes.erase(old_name);
+    sorted_erase(n);
     n->id = new_name;
+    sorted_insert(n);
    
     // Move edges
     for(auto &e : n->incoming)
@@ -639,8 +1430,7 @@ void Network::remove_node(uint32_t idx, bool force)
       throw SRE(buf);
     }
 
-    // Any node addition or deletion invalidates the sorted_node_vector.
-    sorted_node_vector.clear();
+    sorted_erase(n);
    
     // Remove all synapses to/from this node
     // Note: we just need to remove references to these edges & then remove from the hash table
@@ -651,6 +1441,8 @@ void Network::remove_node(uint32_t idx, bool force)
         auto f_edge = std::find(from_node->outgoing.begin(), from_node->outgoing.end(), e);
         std::iter_swap(f_edge, from_node->outgoing.end() - 1);
         from_node->outgoing.pop_back();
+        hash_add(e, false);
+        column_remove(e);
         m_edges.erase(make_pair(from_node->id, idx));
     }
 
@@ -660,6 +1452,8 @@ void Network::remove_node(uint32_t idx, bool force)
         auto t_edge = std::find(to_node->incoming.begin(), to_node->incoming.end(), e);
         std::iter_swap(t_edge, to_node->incoming.end() - 1);
         to_node->incoming.pop_back();
+        hash_add(e, false);
+        column_remove(e);
         m_edges.erase(make_pair(idx, to_node->id));
     }
 
@@ -670,6 +1464,8 @@ void Network::remove_node(uint32_t idx, bool force)
         m_outputs[n->output_id] = -1;
 
     // hash table owns the pointer, so this also deconstructs the node
+    hash_add(n, false);
+    column_remove(n);
     m_nodes.erase(idx);
 }
 
@@ -692,6 +1488,9 @@ void Network::remove_edge(uint32_t fr, uint32_t to)
     std::iter_swap(t_edge, to_node->incoming.end() - 1);
     to_node->incoming.pop_back();
 
+    hash_add(e, false);
+    column_remove(e);
+
     // removal from hash table must be the last operation
     m_edges.erase(make_pair(fr, to));
 }
@@ -780,9 +1579,38 @@ void Network::make_sorted_node_vector()
 {
   NodeMap::iterator nit;
 
-  if (sorted_node_vector.size() != 0) return;
+  if (m_sorted) return;
+  sorted_node_vector.clear();
+  sorted_node_vector.reserve(m_nodes.size());
   for (nit = begin(); nit != end(); nit++) sorted_node_vector.push_back(nit->second.get());
   sort(sorted_node_vector.begin(), sorted_node_vector.end(), node_comp);
+  m_sorted = true;
+}
+
+/* Once the vector is made, these keep it sorted.  Ids usually come in increasing order,
+   so the common case is a push_back(). */
+
+void Network::sorted_insert(Node *n)
+{
+  vector <Node *>::iterator it;
+
+  if (!m_sorted) return;
+  if (sorted_node_vector.empty() || sorted_node_vector.back()->id < n->id) {
+    sorted_node_vector.push_back(n);
+  } else {
+    it = std::lower_bound(sorted_node_vector.begin(), sorted_node_vector.end(), n, node_comp);
+    sorted_node_vector.insert(it, n);
+  }
+}
+
+void Network::sorted_erase(const Node *n)
+{
+  vector <Node *>::iterator it;
+
+  if (!m_sorted) return;
+  it = std::lower_bound(sorted_node_vector.begin(), sorted_node_vector.end(), n->id,
+                        [](const Node *a, uint32_t id) { return a->id < id; });
+  if (it != sorted_node_vector.end() && *it == n) sorted_node_vector.erase(it);
 }
 
 size_t Network::num_nodes() const
@@ -797,23 +1625,25 @@ size_t Network::num_edges() const
 
 void Network::set_data(const string& name, const json& data)
 {
-    m_associated_data[name] = data;
+    own_associated_data()[name] = data;
 }
 
 json Network::get_data(const string& name) const
 {
-    if (!m_associated_data.contains(name)) {
+    const json &ad = *m_associated_data;
+
+    if (!ad.contains(name)) {
       throw SRE((string) "Associated data key '" + name + "' not found");
     }
 
-    return m_associated_data[name];
+    return ad[name];
 }
 
 vector<string> Network::data_keys() const
 {
     vector<string> keys;
 
-    for(auto& it : m_associated_data.items())
+    for(auto& it : m_associated_data->items())
     {
         keys.push_back(it.key());
     }
@@ -821,20 +1651,80 @@ vector<string> Network::data_keys() const
     return keys;
 }
 
+/* These pick from m_column_nodes and m_column_edges, which hold every node and edge
+   in a dense vector, so they are O(1). */
+
 Node* Network::get_random_node(MOA& moa) const
 {
-    // TODO: Make this good
-    auto it = m_nodes.begin();
-    std::advance(it, moa.Random_Integer() % num_nodes());
-    return it->second.get();
+    if (m_column_nodes.empty()) throw SRE("get_random_node(): The network has no nodes");
+    return m_column_nodes[moa.Random_Integer() % m_column_nodes.size()];
 }
 
 Edge* Network::get_random_edge(MOA& moa) const
 {
-    // TODO: Make this good
-    auto it = m_edges.begin();
-    std::advance(it, moa.Random_Integer() % num_edges());
-    return it->second.get();
+    if (m_column_edges.empty()) throw SRE("get_random_edge(): The network has no edges");
+    return m_column_edges[moa.Random_Integer() % m_column_edges.size()];
+}
+
+/* Return k distinct random indices from [0,n).  When k is small compared to n, this
+   uses Floyd's algorithm, which only makes k random numbers and a set of size k.
+   Otherwise, it shuffles the first k elements of [0,n) (Fisher-Yates). */
+
+static vector <uint32_t> random_distinct(MOA &moa, size_t n, size_t k, const char *caller)
+{
+    vector <uint32_t> rv, perm;
+    tsl::robin_set <uint32_t> chosen;
+    size_t i, j, t;
+    char buf[200];
+
+    if (k > n) {
+      snprintf(buf, 200, "%s: Asked for %zu, and there are only %zu", caller, k, n);
+      throw SRE(buf);
+    }
+
+    rv.reserve(k);
+    if (k * 4 < n) {
+      chosen.reserve(k);
+      for (j = n - k; j < n; j++) {
+        t = moa.Random_Integer() % (j + 1);
+        if (!chosen.insert(t).second) t = j;
+        chosen.insert(t);
+        rv.push_back(t);
+      }
+    } else {
+      perm.resize(n);
+      for (i = 0; i < n; i++) perm[i] = i;
+      for (i = 0; i < k; i++) {
+        j = i + moa.Random_Integer() % (n - i);
+        std::swap(perm[i], perm[j]);
+        rv.push_back(perm[i]);
+      }
+    }
+    return rv;
+}
+
+vector <Node *> Network::get_random_nodes(MOA &moa, size_t k) const
+{
+    vector <uint32_t> slots;
+    vector <Node *> rv;
+    size_t i;
+
+    slots = random_distinct(moa, m_column_nodes.size(), k, "get_random_nodes()");
+    rv.resize(k);
+    for (i = 0; i < k; i++) rv[i] = m_column_nodes[slots[i]];
+    return rv;
+}
+
+vector <Edge *> Network::get_random_edges(MOA &moa, size_t k) const
+{
+    vector <uint32_t> slots;
+    vector <Edge *> rv;
+    size_t i;
+
+    slots = random_distinct(moa, m_column_edges.size(), k, "get_random_edges()");
+    rv.resize(k);
+    for (i = 0; i < k; i++) rv[i] = m_column_edges[slots[i]];
+    return rv;
 }
 
 Node* Network::get_random_input(MOA& moa) const
@@ -870,103 +1760,408 @@ double Network::random_value(MOA& moa, const Property& p)
     return rv;
 }
 
+/* Random networks.  randomize() checks the parameters, makes the input, output and
+   hidden nodes, and then calls randomize_p(), randomize_h() or randomize_sw() to make
+   the edges.  See markdown/network.md for the parameters. */
+
+static json randomize_specs = {
+   { "type", "S" },
+   { "inputs", "I" },
+   { "outputs", "I" },
+   { "hidden", "I" },
+   { "p", "D" },
+   { "p_ih", "D" },
+   { "p_hh", "D" },
+   { "p_ho", "D" },
+   { "k", "I" },
+   { "beta", "D" },
+   { "self_loops", "B" },
+   { "randomize_values", "B" },
+   { "seed", "I" },
+   { "Necessary", { "type" } }
+};
+
+static double randomize_probability(const json &params, const string &key)
+{
+    double p;
+    char buf[200];
+
+    p = json_double(params, key, 0);
+    if (!(p >= 0 && p <= 1)) {
+      snprintf(buf, 200, "Network::randomize(): %s must be between 0 and 1", key.c_str());
+      throw SRE(buf);
+    }
+    return p;
+}
+
+static uint32_t randomize_count(const json &params, const string &key)
+{
+    long long n;
+    char buf[200];
+
+    n = json_long_long(params, key, 0);
+    if (n < 0 || n > 0x7fffffff) {
+      snprintf(buf, 200, "Network::randomize(): %s must be between 0 and 2^31-1", key.c_str());
+      throw SRE(buf);
+    }
+    return n;
+}
+
+/* Put each pair in from x to into pairs with probability p, leaving out self-loops unless
+   self_loops is true.  Rather than flipping a coin for each pair, this jumps from one
+   chosen pair to the next, with geometrically distributed gaps, so it takes time
+   proportional to the number of pairs chosen, rather than |from|*|to|. */
+
+static void sample_pairs(MOA &moa, const vector <uint32_t> &from, const vector <uint32_t> &to,
+                         double p, bool self_loops, vector < pair <uint32_t, uint32_t> > &pairs)
+{
+    uint64_t total, index;
+    double log_q, u, gap;
+    uint32_t f, t;
+
+    total = (uint64_t) from.size() * to.size();
+    if (p <= 0 || total == 0) return;
+    log_q = (p >= 1) ? 0 : log1p(-p);
+
+    pairs.reserve(pairs.size() + (size_t) (p * total * 1.05) + 16);
+    index = 0;
+    while (index < total) {
+      if (p < 1) {
+        u = ((double) moa.Random_32() + 0.5) / 4294967296.0;   // In (0,1), so log(u) is finite
+        gap = floor(log(u) / log_q);
+        if (gap >= (double) (total - index)) break;
+        index += (uint64_t) gap;
+      }
+      f = from[index / to.size()];
+      t = to[index % to.size()];
+      if (self_loops || f != t) pairs.push_back(make_pair(f, t));
+      index++;
+    }
+}
+
 void Network::randomize(const json& params)
 {
-    (void) params;
-    // TODO
-    //   Allow this function to be a front-end for a family of functions
-    throw std::logic_error("Random network generation is not yet implemented.");
+    MOA moa;
+    uint32_t seed;
+
+    Parameter_Check_Json_T(params, randomize_specs);
+    seed = (params.contains("seed")) ? params["seed"].get<uint32_t>() : moa.Seed_From_Time();
+    moa.Seed(seed, "randomize");
+    randomize(params, moa);
+}
+
+void Network::randomize(const json& params, MOA &moa)
+{
+    uint32_t ninputs, noutputs, nhidden, total, i;
+    vector <uint32_t> ids;
+    string type;
+
+    Parameter_Check_Json_T(params, randomize_specs);
+    type = params["type"].get<string>();
+    if (type != "p" && type != "h" && type != "sw") {
+      throw SRE("Network::randomize(): type must be \"p\", \"h\" or \"sw\"");
+    }
+
+    ninputs = randomize_count(params, "inputs");
+    noutputs = randomize_count(params, "outputs");
+    nhidden = randomize_count(params, "hidden");
+    if ((uint64_t) ninputs + noutputs + nhidden > 0x7fffffff) {
+      throw SRE("Network::randomize(): Too many nodes");
+    }
+    total = ninputs + noutputs + nhidden;
+
+    /* Check the rest of the parameters before clearing the network, so that bad
+       parameters leave it alone. */
+
+    randomize_probability(params, "p");
+    randomize_probability(params, "p_ih");
+    randomize_probability(params, "p_hh");
+    randomize_probability(params, "p_ho");
+    randomize_probability(params, "beta");
+    if (type == "sw" && total != 0 && randomize_count(params, "k") >= total) {
+      throw SRE("Network::randomize(): k must be less than the number of nodes");
+    }
+
+    /* The inputs are nodes 0 to inputs-1, then the outputs, and then the hidden nodes. */
+
+    clear(false);
+    ids.resize(total);
+    for (i = 0; i < total; i++) ids[i] = i;
+    add_nodes(ids);
+    for (i = 0; i < ninputs; i++) add_input(i);
+    for (i = 0; i < noutputs; i++) add_output(ninputs + i);
+
+    if (type == "p") {
+      randomize_p(params, moa);
+    } else if (type == "h") {
+      randomize_h(params, moa);
+    } else {
+      randomize_sw(params, moa);
+    }
+
+    /* Randomize the values last, going through the slots, so that the same seed makes
+       the same network. */
+
+    if (json_boolean(params, "randomize_values", true)) {
+      randomize_properties(moa);
+      for (i = 0; i < m_column_nodes.size(); i++) randomize_properties(moa, m_column_nodes[i]);
+      for (i = 0; i < m_column_edges.size(); i++) randomize_properties(moa, m_column_edges[i]);
+    }
 }
 
-void Network::randomize_p(const json& params)
+/* Erdos-Renyi: each edge between any two nodes is there with probability p. */
+
+void Network::randomize_p(const json& params, MOA &moa)
 {
-    (void) params;
-    // TODO
-    //   Add n hidden nodes
-    //   Connect nodes with probability p
-    throw std::logic_error("Random network generation is not yet implemented.");
+    vector < pair <uint32_t, uint32_t> > pairs;
+    vector <uint32_t> ids;
+    double p;
+    size_t i;
+
+    p = randomize_probability(params, "p");
+    ids.resize(m_nodes.size());
+    for (i = 0; i < ids.size(); i++) ids[i] = i;
+    sample_pairs(moa, ids, ids, p, json_boolean(params, "self_loops", false), pairs);
+    add_edges(pairs);
 }
 
-void Network::randomize_h(const json& params)
+/* Layered: input -> hidden with probability p_ih, hidden -> hidden with p_hh, and
+   hidden -> output with p_ho. */
+
+void Network::randomize_h(const json& params, MOA &moa)
 {
-    (void) params;
-    // TODO
-    //   Add n hidden nodes
-    //   Randomly connect input -> hidden,
-    //                    hidden -> hidden,
-    //                    hidden -> output
-    throw std::logic_error("Random network generation is not yet implemented.");
+    vector < pair <uint32_t, uint32_t> > pairs;
+    vector <uint32_t> inputs, hidden, outputs;
+    size_t i;
+
+    inputs.assign(m_inputs.begin(), m_inputs.end());
+    outputs.assign(m_outputs.begin(), m_outputs.end());
+    for (i = inputs.size() + outputs.size(); i < m_nodes.size(); i++) hidden.push_back(i);
+
+    sample_pairs(moa, inputs, hidden, randomize_probability(params, "p_ih"), false, pairs);
+    sample_pairs(moa, hidden, hidden, randomize_probability(params, "p_hh"),
+                 json_boolean(params, "self_loops", false), pairs);
+    sample_pairs(moa, hidden, outputs, randomize_probability(params, "p_ho"), false, pairs);
+    add_edges(pairs);
 }
 
-void Network::prune()
+/* Small-world (Watts-Strogatz, directed): the nodes are in a ring by id, and each one
+   has edges to the next k nodes.  Then, with probability beta, each edge's target is
+   replaced with a random node. */
+
+void Network::randomize_sw(const json& params, MOA &moa)
 {
-    // search state information
-    tsl::robin_set<uint32_t> visited;
-    std::vector<uint32_t> to_remove;
+    uint32_t n, k, i, j, t;
+    double beta;
 
-    // DFS lambdas
-    std::function<void(Node*)> traverse_inputs;
-    std::function<void(Node*)> traverse_outputs;
+    n = m_nodes.size();
+    k = randomize_count(params, "k");
+    beta = randomize_probability(params, "beta");
+    if (n == 0) return;
 
-    // Any node addition or deletion invalidates the sorted_node_vector.
-    // We'll lump prune in here.
-    sorted_node_vector.clear();
-   
-    traverse_inputs = [&traverse_inputs, &visited](Node *n) {
-        // check if node has been visited
-        auto it = visited.find(n->id);
-        if(it == visited.end())
-        {
-            // mark as visited
-            visited.insert(n->id);
+    reserve(n, (size_t) n * k);
 
-            // traverse all incoming edges
-            for(Edge *e : n->incoming)
-                traverse_inputs(e->from);
+    /* randomize() made sure that k < n, so a node always has a free target. */
+
+    for (i = 0; i < n; i++) {
+      for (j = 1; j <= k; j++) {
+        t = (i + j) % n;
+        if (moa.Random_Double() < beta || is_edge(i, t)) {
+          do {
+            t = moa.Random_Integer() % n;
+          } while (t == i || is_edge(i, t));
         }
-    };
+        add_edge(i, t);
+      }
+    }
+}
 
-    traverse_outputs = [&traverse_outputs, &visited](Node *n) {
-        // check if node has been visited
-        auto it = visited.find(n->id);
-        if(it == visited.end())
-        {
-            // mark as visited
-            visited.insert(n->id);
+/* Pruning works on the nodes' slots (column_slot), so the searches use bit vectors
+   rather than sets of ids, and they use an explicit stack rather than recursion,
+   so that long chains can't overflow the call stack. */
+
+static inline bool bit_test(const vector <uint64_t> &b, size_t i)
+{
+    return (b[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void bit_set(vector <uint64_t> &b, size_t i)
+{
+    b[i >> 6] |= ((uint64_t) 1 << (i & 63));
+}
+
+/* Mark every node reachable from the start nodes, following outgoing edges (forward)
+   or incoming edges (backward). */
+
+static void mark_reachable(const vector <Node *> &start, bool forward, vector <uint64_t> &seen)
+{
+    vector <Node *> stack;
+    Node *n, *m;
+    size_t i;
 
-            // traverse all outgoing edges
-            for(Edge *e : n->outgoing)
-                traverse_outputs(e->to);
+    for (i = 0; i < start.size(); i++) {
+      if (!bit_test(seen, start[i]->column_slot)) {
+        bit_set(seen, start[i]->column_slot);
+        stack.push_back(start[i]);
+      }
+    }
+
+    while (!stack.empty()) {
+      n = stack.back();
+      stack.pop_back();
+      const vector <Edge *> &edges = (forward) ? n->outgoing : n->incoming;
+      for (i = 0; i < edges.size(); i++) {
+        m = (forward) ? edges[i]->to : edges[i]->from;
+        if (!bit_test(seen, m->column_slot)) {
+          bit_set(seen, m->column_slot);
+          stack.push_back(m);
         }
-    };
+      }
+    }
+}
 
-    // Traverse from each input
-    for(auto c : m_inputs) traverse_outputs(m_nodes.at(c).get());
+/* A hidden node survives if it is reachable from an input and it can reach an output.
+   That's the same as removing the nodes that aren't reachable from the inputs and then
+   removing the ones that can't reach the outputs, since everything downstream of a
+   reachable node is reachable. */
 
-    // Check which nodes were visited
-    for(auto& elm : m_nodes)
-        if(visited.find(elm.first) == visited.end() && (elm.second->is_hidden()))
-            to_remove.emplace_back(elm.first);
-    
-    // Remove nodes which weren't visited
-    for(auto c : to_remove)
-        remove_node(c, false);
+void Network::prune()
+{
+    vector <uint64_t> from_inputs, to_outputs, doomed;
+    vector <Node *> start;
+    size_t i, words;
+    bool any;
+
+    words = (m_column_nodes.size() + 63) / 64;
+    from_inputs.resize(words, 0);
+    to_outputs.resize(words, 0);
+    doomed.resize(words, 0);
+
+    for (auto id : m_inputs) if (is_node(id)) start.push_back(get_node(id));
+    mark_reachable(start, true, from_inputs);
+
+    start.clear();
+    for (auto id : m_outputs) if (is_node(id)) start.push_back(get_node(id));
+    mark_reachable(start, false, to_outputs);
+
+    any = false;
+    for (i = 0; i < m_column_nodes.size(); i++) {
+      if (m_column_nodes[i]->is_hidden() && !(bit_test(from_inputs, i) && bit_test(to_outputs, i))) {
+        bit_set(doomed, i);
+        any = true;
+      }
+    }
+
+    if (any) remove_marked_nodes(doomed);
+}
+
+void Network::remove_nodes(const vector <uint32_t> &ids, bool force)
+{
+    vector <uint64_t> doomed;
+    char buf[100];
+    Node *n;
+    size_t i;
+
+    /* Check first, so that an error leaves the network as it was. */
 
-    // Clear state
-    visited.clear();
-    to_remove.clear();
+    doomed.resize((m_column_nodes.size() + 63) / 64, 0);
+    for (i = 0; i < ids.size(); i++) {
+      n = get_node(ids[i]);
+      if (!force && n->input_id >= 0) {
+        snprintf(buf, 100, "Input node %u cannot be removed.", n->id);
+        throw SRE(buf);
+      }
+      if (!force && n->output_id >= 0) {
+        snprintf(buf, 100, "Output node %u cannot be removed.", n->id);
+        throw SRE(buf);
+      }
+      bit_set(doomed, n->column_slot);
+    }
+
+    if (ids.size() > 0) remove_marked_nodes(doomed);
+}
+
+/* Remove the nodes whose slots are set in doomed, and their edges.  Unlike calling
+   remove_node() on each, this doesn't search the neighbors' edge lists once per edge
+   (which is quadratic for high-degree nodes) -- each neighbor filters its lists once.
+   The hash is recomputed at the next hash(). */
+
+void Network::remove_marked_nodes(const vector <uint64_t> &doomed)
+{
+    vector <Node *> dead_nodes, touched;
+    vector <Edge *> dead_edges;
+    vector <Coords> dead_keys;
+    vector <uint64_t> seen;
+    Node *n, *m;
+    size_t i;
+
+    m_hash_valid = false;
+    seen.resize(doomed.size(), 0);
+
+    /* Collect the doomed nodes, their edges, and their surviving neighbors.  An edge
+       between two doomed nodes is collected from its from node. */
+
+    for (i = 0; i < m_column_nodes.size(); i++) {
+      if (bit_test(doomed, i)) dead_nodes.push_back(m_column_nodes[i]);
+    }
+
+    for (i = 0; i < dead_nodes.size(); i++) {
+      n = dead_nodes[i];
+      for (auto e : n->outgoing) {
+        dead_edges.push_back(e);
+        dead_keys.push_back(Coords(n->id, e->to->id));
+        m = e->to;
+        if (!bit_test(doomed, m->column_slot) && !bit_test(seen, m->column_slot)) {
+          bit_set(seen, m->column_slot);
+          touched.push_back(m);
+        }
+      }
+      for (auto e : n->incoming) {
+        m = e->from;
+        if (!bit_test(doomed, m->column_slot)) {
+          dead_edges.push_back(e);
+          dead_keys.push_back(Coords(m->id, n->id));
+          if (!bit_test(seen, m->column_slot)) {
+            bit_set(seen, m->column_slot);
+            touched.push_back(m);
+          }
+        }
+      }
+    }
+
+    for (i = 0; i < touched.size(); i++) {
+      n = touched[i];
+      n->outgoing.erase(std::remove_if(n->outgoing.begin(), n->outgoing.end(),
+                          [&doomed](Edge *x) { return bit_test(doomed, x->to->column_slot); }),
+                        n->outgoing.end());
+      n->incoming.erase(std::remove_if(n->incoming.begin(), n->incoming.end(),
+                          [&doomed](Edge *x) { return bit_test(doomed, x->from->column_slot); }),
+                        n->incoming.end());
+    }
+
+    /* Doomed inputs and outputs (only when forced) leave -1 behind, like remove_node(). */
+
+    for (i = 0; i < dead_nodes.size(); i++) {
+      n = dead_nodes[i];
+      if (n->input_id >= 0) m_inputs[n->input_id] = -1;
+      if (n->output_id >= 0) m_outputs[n->output_id] = -1;
+    }
 
-    // Traverse from each output
-    for(auto c : m_outputs) traverse_inputs(m_nodes.at(c).get());
+    /* One pass takes the doomed nodes out of sorted_node_vector. */
 
-    // Check which nodes were visited
-    for(auto& elm : m_nodes)
-        if(visited.find(elm.first) == visited.end() && (elm.second->is_hidden()))
-            to_remove.emplace_back(elm.first);
+    if (m_sorted) {
+      sorted_node_vector.erase(std::remove_if(sorted_node_vector.begin(), sorted_node_vector.end(),
+                                 [&doomed](Node *x) { return bit_test(doomed, x->column_slot); }),
+                               sorted_node_vector.end());
+    }
+
+    /* The slots change from here on, so doomed can't be used any more.  Erasing from the
+       hash tables destroys the nodes and edges, so that's last. */
 
-    // Remove nodes which weren't visited
-    for(auto c : to_remove)
-        remove_node(c, false);
+    for (i = 0; i < dead_edges.size(); i++) column_remove(dead_edges[i]);
+    for (i = 0; i < dead_nodes.size(); i++) column_remove(dead_nodes[i]);
+    for (i = 0; i < dead_keys.size(); i++) m_edges.erase(dead_keys[i]);
+    for (i = 0; i < dead_nodes.size(); i++) m_nodes.erase(dead_nodes[i]->id);
 }
 
 void Network::randomize_property(MOA& moa, const Property& p, vector<double>& pv)
@@ -975,13 +2170,43 @@ void Network::randomize_property(MOA& moa, const Property& p, vector<double>& pv
         pv[i] = random_value(moa, p);
 }
 
+void Network::randomize_values(MOA &moa, const Property &p, Node *n)
+{
+    int i;
+
+    hash_add(n, false);
+    if (!m_columns) {
+      randomize_property(moa, p, n->values);
+    } else {
+      for (i = p.index; i < p.index + p.size; i++) {
+        own_column(m_node_columns[i])[n->column_slot] = random_value(moa, p);
+      }
+    }
+    hash_add(n, true);
+}
+
+void Network::randomize_values(MOA &moa, const Property &p, Edge *e)
+{
+    int i;
+
+    hash_add(e, false);
+    if (!m_columns) {
+      randomize_property(moa, p, e->values);
+    } else {
+      for (i = p.index; i < p.index + p.size; i++) {
+        own_column(m_edge_columns[i])[e->column_slot] = random_value(moa, p);
+      }
+    }
+    hash_add(e, true);
+}
+
 void Network::randomize_property(MOA& moa, Node *n, const string& pname)
 {
     auto pit = m_properties.nodes.find(pname);
     if (pit == std::end(m_properties.nodes)) {
       throw SRE((string) "Cannot randomize node property '" + pname + "'"); 
     }
-    randomize_property(moa, pit->second, n->values);
+    randomize_values(moa, pit->second, n);
 }
 
 void Network::randomize_property(MOA& moa, Edge *e, const string& pname)
@@ -990,7 +2215,7 @@ void Network::randomize_property(MOA& moa, Edge *e, const string& pname)
     if(pit == std::end(m_properties.edges))  {
       throw SRE((string) "Cannot randomize edge property '" + pname + "'"); 
     }
-    randomize_property(moa, pit->second, e->values);
+    randomize_values(moa, pit->second, e);
 }
 
 void Network::randomize_property(MOA& moa, const string& pname)
@@ -1011,13 +2236,13 @@ void Network::randomize_properties(MOA &moa)
 void Network::randomize_properties(MOA &moa, Node *n)
 {
     for(auto &p : m_properties.nodes)
-        randomize_property(moa, p.second, n->values);
+        randomize_values(moa, p.second, n);
 }
 
 void Network::randomize_properties(MOA &moa, Edge *e)
 {
     for(auto &p : m_properties.edges)
-        randomize_property(moa, p.second, e->values);
+        randomize_values(moa, p.second, e);
 }
 
 bool Network::is_node_property(const string& name) const
@@ -1062,6 +2287,43 @@ const Property* Network::get_network_property(const string& name) const
     return &(mit->second);
 }
 
+PropertyHandle Network::node_handle(const string& name) const
+{
+    return m_properties.node_handle(name);
+}
+
+PropertyHandle Network::edge_handle(const string& name) const
+{
+    return m_properties.edge_handle(name);
+}
+
+void Network::get_all(const PropertyHandle& h, vector <double> &vals)
+{
+    EdgeMap::const_iterator eit;
+    const vector <double> *col;
+    size_t i;
+
+    if (h.kind == PropertyHandle::NODE) {
+      make_sorted_node_vector();
+      vals.resize(sorted_node_vector.size());
+      if (m_columns) {
+        col = m_node_columns.at(h.index).get();
+        for (i = 0; i < vals.size(); i++) vals[i] = (*col)[sorted_node_vector[i]->column_slot];
+      } else {
+        for (i = 0; i < vals.size(); i++) vals[i] = sorted_node_vector[i]->values.at(h.index);
+      }
+    } else {
+      vals.resize(m_edges.size());
+      i = 0;
+      if (m_columns) {
+        col = m_edge_columns.at(h.index).get();
+        for (eit = m_edges.begin(); eit != m_edges.end(); eit++) vals[i++] = (*col)[eit->second->column_slot];
+      } else {
+        for (eit = m_edges.begin(); eit != m_edges.end(); eit++) vals[i++] = eit->second->values.at(h.index);
+      }
+    }
+}
+
 PropertyPack Network::get_properties() const
 {
     return m_properties;
@@ -1085,94 +2347,1203 @@ void Network::set_properties(const PropertyPack& pp)
         values[pit->second.index+i] = pit->second.max_value;
       }
     }
+
+    if (m_columns) {
+      m_node_columns.resize(m_properties.node_vec_size);
+      m_edge_columns.resize(m_properties.edge_vec_size);
+      for (auto &c : m_node_columns) c = std::make_shared< vector <double> >();
+      for (auto &c : m_edge_columns) c = std::make_shared< vector <double> >();
+    }
 }
 
-string Network::pretty_nodes() const
+/* ------------------------------------------------------------ */
+/* Network patches.  diff() goes through the nodes and edges of both networks, and
+   everything is sorted by id, so that the same two networks always give the
+   same patch. */
+
+bool NetworkPatch::empty() const
 {
-  size_t i;
-  string s;
-  bool use_vector;
-  NodeMap::const_iterator nit;
+    return (removed_nodes.empty() && removed_edges.empty() &&
+            added_nodes.empty() && added_edges.empty() &&
+            changed_nodes.empty() && changed_edges.empty() &&
+            !io_changed && !values_changed && !data_changed);
+}
 
-  if (m_nodes.size() == 0) return "[]";
-  
-  use_vector = (sorted_node_vector.size() != 0);
+bool NetworkPatch::structure_changed() const
+{
+    return (!removed_nodes.empty() || !added_nodes.empty() || io_changed);
+}
 
-  nit = m_nodes.begin();
-  s = "";
-  for (i = 0; i < m_nodes.size(); i++) {
-    s += ((i == 0) ? "[ " : "  ");
-    if (use_vector) {
-      s += node_json(sorted_node_vector[i]).dump();
-    } else {
-      s += node_json(nit->second.get()).dump();
+static json patch_nodes_json(const vector <NetworkPatch::NodeValues> &nv)
+{
+    json rv;
+    size_t i;
+
+    rv = json::array();
+    for (i = 0; i < nv.size(); i++) {
+      rv.push_back({ { "id", nv[i].id }, { "values", nv[i].values } });
     }
-    if (i+1 == m_nodes.size()) {
-      s += " ]";
-    } else {
-      s += ",\n";
+    return rv;
+}
+
+static json patch_edges_json(const vector <NetworkPatch::EdgeValues> &ev)
+{
+    json rv;
+    size_t i;
+
+    rv = json::array();
+    for (i = 0; i < ev.size(); i++) {
+      rv.push_back({ { "from", ev[i].from }, { "to", ev[i].to }, { "values", ev[i].values } });
     }
-    nit++;
-  }
-  return s;
+    return rv;
 }
 
-string Network::pretty_edges() const
+json NetworkPatch::as_json() const
 {
-  json j1;
-  size_t i, j;
-  string s;
-  Node *n;
-  map <uint32_t, Edge *> m;
-  map <uint32_t, Edge *>::iterator mit;
-  
-  if (num_edges() == 0) return "[]";
+    json rv;
+    size_t i;
 
-  if (sorted_node_vector.size() == 0) {
-    j1 = as_json();
-    s = "";
-    for (i = 0; i < j1["Edges"].size(); i++) {
-      s += ((i == 0) ? "[ " : "  ");
-      s += j1["Edges"][i].dump();
-      if (i+1 == j1["Edges"].size()) {
-        s += " ]";
-      } else {
-        s += ",\n";
+    rv = json::object();
+    rv["Removed_Nodes"] = removed_nodes;
+    rv["Removed_Edges"] = json::array();
+    for (i = 0; i < removed_edges.size(); i++) {
+      rv["Removed_Edges"].push_back({ removed_edges[i].first, removed_edges[i].second });
+    }
+    rv["Added_Nodes"] = patch_nodes_json(added_nodes);
+    rv["Added_Edges"] = patch_edges_json(added_edges);
+    rv["Changed_Nodes"] = patch_nodes_json(changed_nodes);
+    rv["Changed_Edges"] = patch_edges_json(changed_edges);
+    if (io_changed) {
+      rv["Inputs"] = inputs;
+      rv["Outputs"] = outputs;
+    }
+    if (values_changed) rv["Network_Values"] = network_values;
+    if (data_changed) rv["Associated_Data"] = associated_data;
+    return rv;
+}
+
+void NetworkPatch::from_json(const json &j)
+{
+    NodeValues nv;
+    EdgeValues ev;
+    vector <string> keys = { "Removed_Nodes", "Removed_Edges", "Added_Nodes", "Added_Edges",
+                             "Changed_Nodes", "Changed_Edges" };
+    size_t i;
+
+    if (!j.is_object()) throw SRE("NetworkPatch::from_json() - the json isn't an object");
+    for (i = 0; i < keys.size(); i++) {
+      if (!j.contains(keys[i]) || !j[keys[i]].is_array()) {
+        throw SRE("NetworkPatch::from_json() - " + keys[i] + " must be an array");
       }
     }
-    return s;
-  } else {
-    s = "";
-    for (i = 0; i < sorted_node_vector.size(); i++) {
-      n = sorted_node_vector[i];
-      m.clear();
-      for (j = 0; j < n->outgoing.size(); j++) {
-        m[n->outgoing[j]->to->id] = n->outgoing[j];
+    if (j.contains("Inputs") != j.contains("Outputs")) {
+      throw SRE("NetworkPatch::from_json() - Inputs and Outputs must both be there, or neither");
+    }
+
+    *this = NetworkPatch();
+
+    try {
+      removed_nodes = j["Removed_Nodes"].get< vector <uint32_t> >();
+      for (auto &e : j["Removed_Edges"]) {
+        removed_edges.push_back(make_pair(e.at(0).get<uint32_t>(), e.at(1).get<uint32_t>()));
+      }
+      for (i = 0; i < 2; i++) {
+        for (auto &n : j[(i == 0) ? "Added_Nodes" : "Changed_Nodes"]) {
+          nv.id = n.at("id").get<uint32_t>();
+          nv.values = n.at("values").get< vector <double> >();
+          ((i == 0) ? added_nodes : changed_nodes).push_back(nv);
+        }
+        for (auto &e : j[(i == 0) ? "Added_Edges" : "Changed_Edges"]) {
+          ev.from = e.at("from").get<uint32_t>();
+          ev.to = e.at("to").get<uint32_t>();
+          ev.values = e.at("values").get< vector <double> >();
+          ((i == 0) ? added_edges : changed_edges).push_back(ev);
+        }
+      }
+      if (j.contains("Inputs")) {
+        io_changed = true;
+        inputs = j["Inputs"].get< vector <uint32_t> >();
+        outputs = j["Outputs"].get< vector <uint32_t> >();
+      }
+      if (j.contains("Network_Values")) {
+        values_changed = true;
+        network_values = j["Network_Values"].get< vector <double> >();
       }
-      for (mit = m.begin(); mit != m.end(); mit++) {
-        s += ((s.size() == 0) ? "[ " : ",\n  ");
-        s += mit->second->as_json().dump();
+      if (j.contains("Associated_Data")) {
+        data_changed = true;
+        associated_data = j["Associated_Data"];
       }
+    } catch (const json::exception &ex) {
+      *this = NetworkPatch();
+      throw SRE((string) "NetworkPatch::from_json() - bad json: " + ex.what());
     }
-    s += " ]";
-    return s;
-  }
 }
 
-static void append_and_indent(const string &from, string &to, size_t chars)
+NetworkPatch Network::diff(const Network &target) const
 {
-  size_t i, j;
-  char lc;
+    NetworkPatch p;
+    NetworkPatch::NodeValues nv;
+    NetworkPatch::EdgeValues ev;
+    vector <double> tmp1, tmp2;
 
-  lc = '\n';
-  for (i = 0; i < from.size(); i++) {
-    if (lc == '\n') {
-      for (j = 0; j < chars; j++) to.push_back(' ');
+    if (m_properties != target.m_properties) {
+      throw SRE("Network::diff() - the networks have different PropertyPacks");
     }
-    to.push_back(from[i]);
-    lc = from[i];
-  }
-}
+
+    for (auto &n : m_nodes) {
+      if (target.m_nodes.find(n.first) == target.m_nodes.end()) p.removed_nodes.push_back(n.first);
+    }
+    for (auto &e : m_edges) {
+      if (target.m_edges.find(e.first) == target.m_edges.end()) p.removed_edges.push_back(e.first);
+    }
+
+    /* Most of the nodes and edges are usually the same, so the values are compared
+       without copying them. */
+
+    for (auto &n : target.m_nodes) {
+      const vector <double> &tv = values_of(n.second.get(), tmp1);
+      auto nit = m_nodes.find(n.first);
+      if (nit == m_nodes.end() || values_of(nit->second.get(), tmp2) != tv) {
+        nv.id = n.first;
+        nv.values = tv;
+        ((nit == m_nodes.end()) ? p.added_nodes : p.changed_nodes).push_back(nv);
+      }
+    }
+
+    for (auto &e : target.m_edges) {
+      const vector <double> &tv = values_of(e.second.get(), tmp1);
+      auto eit = m_edges.find(e.first);
+      if (eit == m_edges.end() || values_of(eit->second.get(), tmp2) != tv) {
+        ev.from = e.first.first;
+        ev.to = e.first.second;
+        ev.values = tv;
+        ((eit == m_edges.end()) ? p.added_edges : p.changed_edges).push_back(ev);
+      }
+    }
+
+    std::sort(p.removed_nodes.begin(), p.removed_nodes.end());
+    std::sort(p.removed_edges.begin(), p.removed_edges.end());
+    std::sort(p.added_nodes.begin(), p.added_nodes.end(),
+              [](const NetworkPatch::NodeValues &a, const NetworkPatch::NodeValues &b)
+              { return a.id < b.id; });
+    std::sort(p.changed_nodes.begin(), p.changed_nodes.end(),
+              [](const NetworkPatch::NodeValues &a, const NetworkPatch::NodeValues &b)
+              { return a.id < b.id; });
+    std::sort(p.added_edges.begin(), p.added_edges.end(),
+              [](const NetworkPatch::EdgeValues &a, const NetworkPatch::EdgeValues &b)
+              { return make_pair(a.from, a.to) < make_pair(b.from, b.to); });
+    std::sort(p.changed_edges.begin(), p.changed_edges.end(),
+              [](const NetworkPatch::EdgeValues &a, const NetworkPatch::EdgeValues &b)
+              { return make_pair(a.from, a.to) < make_pair(b.from, b.to); });
+
+    if (m_inputs != target.m_inputs || m_outputs != target.m_outputs) {
+      p.io_changed = true;
+      p.inputs = target.m_inputs;
+      p.outputs = target.m_outputs;
+    }
+    if (values != target.values) {
+      p.values_changed = true;
+      p.network_values = target.values;
+    }
+    if (*m_associated_data != *target.m_associated_data) {
+      p.data_changed = true;
+      p.associated_data = *target.m_associated_data;
+    }
+    return p;
+}
+
+/* This checks the whole patch before it changes anything, so if the patch doesn't fit
+   the network, it throws and the network is unchanged.  A node or edge may be removed
+   and then added back, but nothing may be removed or added twice, and a changed node
+   or edge, or an input or output, has to be there once the removals and additions are
+   done.  Removing a node removes its edges, whether or not the patch lists them. */
+
+void Network::apply_patch(const NetworkPatch &patch)
+{
+    const uint32_t none = -1;
+    size_t i;
+    uint32_t id;
+    Node *n;
+    char buf[200];
+    tsl::robin_set <uint32_t, int_hash> removed_nodes, added_nodes, io_nodes[2];
+    tsl::robin_set <Coords, coord_hash> removed_edges, added_edges;
+
+    for (i = 0; i < patch.added_nodes.size() + patch.changed_nodes.size(); i++) {
+      const NetworkPatch::NodeValues &nv = (i < patch.added_nodes.size()) ?
+          patch.added_nodes[i] : patch.changed_nodes[i - patch.added_nodes.size()];
+      if (nv.values.size() != m_properties.node_vec_size) {
+        snprintf(buf, 200, "Network::apply_patch() - node %u's values don't match the PropertyPack",
+                 nv.id);
+        throw SRE(buf);
+      }
+    }
+    for (i = 0; i < patch.added_edges.size() + patch.changed_edges.size(); i++) {
+      const NetworkPatch::EdgeValues &ev = (i < patch.added_edges.size()) ?
+          patch.added_edges[i] : patch.changed_edges[i - patch.added_edges.size()];
+      if (ev.values.size() != m_properties.edge_vec_size) {
+        snprintf(buf, 200, "Network::apply_patch() - edge %u -> %u's values don't match the PropertyPack",
+                 ev.from, ev.to);
+        throw SRE(buf);
+      }
+    }
+    if (patch.values_changed && patch.network_values.size() != m_properties.net_vec_size) {
+      throw SRE("Network::apply_patch() - the network values don't match the PropertyPack");
+    }
+
+    /* Removals must be there, and not be repeated. */
+
+    for (auto &e : patch.removed_edges) {
+      if (!is_edge(e.first, e.second) || !removed_edges.insert(Coords(e.first, e.second)).second) {
+        snprintf(buf, 200, "Network::apply_patch() - can't remove edge %u -> %u", e.first, e.second);
+        throw SRE(buf);
+      }
+    }
+    for (auto id : patch.removed_nodes) {
+      if (!is_node(id) || !removed_nodes.insert(id).second) {
+        snprintf(buf, 200, "Network::apply_patch() - can't remove node %u", id);
+        throw SRE(buf);
+      }
+    }
+
+    /* Additions must not be there after the removals, and not be repeated. */
+
+    auto node_left = [&](uint32_t id) { return is_node(id) && removed_nodes.count(id) == 0; };
+    auto node_after = [&](uint32_t id) { return node_left(id) || added_nodes.count(id) != 0; };
+    auto edge_left = [&](uint32_t fr, uint32_t to) {
+      return is_edge(fr, to) && removed_edges.count(Coords(fr, to)) == 0 &&
+             removed_nodes.count(fr) == 0 && removed_nodes.count(to) == 0;
+    };
+
+    for (auto &nv : patch.added_nodes) {
+      if (node_left(nv.id) || !added_nodes.insert(nv.id).second) {
+        snprintf(buf, 200, "Network::apply_patch() - can't add node %u", nv.id);
+        throw SRE(buf);
+      }
+    }
+    for (auto &ev : patch.added_edges) {
+      if (!node_after(ev.from) || !node_after(ev.to) || edge_left(ev.from, ev.to) ||
+          !added_edges.insert(Coords(ev.from, ev.to)).second) {
+        snprintf(buf, 200, "Network::apply_patch() - can't add edge %u -> %u", ev.from, ev.to);
+        throw SRE(buf);
+      }
+    }
+
+    /* Changes, inputs and outputs must be there at the end. */
+
+    for (auto &nv : patch.changed_nodes) {
+      if (!node_after(nv.id)) {
+        snprintf(buf, 200, "Network::apply_patch() - can't change node %u", nv.id);
+        throw SRE(buf);
+      }
+    }
+    for (auto &ev : patch.changed_edges) {
+      if (!edge_left(ev.from, ev.to) && added_edges.count(Coords(ev.from, ev.to)) == 0) {
+        snprintf(buf, 200, "Network::apply_patch() - can't change edge %u -> %u", ev.from, ev.to);
+        throw SRE(buf);
+      }
+    }
+    if (patch.io_changed) {
+      for (i = 0; i < patch.inputs.size() + patch.outputs.size(); i++) {
+        id = (i < patch.inputs.size()) ? patch.inputs[i] : patch.outputs[i - patch.inputs.size()];
+        if (id != none && (!node_after(id) || !io_nodes[i < patch.inputs.size()].insert(id).second)) {
+          snprintf(buf, 200, "Network::apply_patch() - input/output node %u isn't in the network, or is repeated", id);
+          throw SRE(buf);
+        }
+      }
+    }
+
+    for (auto &e : patch.removed_edges) remove_edge(e.first, e.second);
+    for (auto id : patch.removed_nodes) remove_node(id, true);
+    for (auto &nv : patch.added_nodes) add_node(nv.id)->set_values(nv.values);
+    for (auto &ev : patch.added_edges) add_edge(ev.from, ev.to)->set_values(ev.values);
+    for (auto &nv : patch.changed_nodes) get_node(nv.id)->set_values(nv.values);
+    for (auto &ev : patch.changed_edges) get_edge(ev.from, ev.to)->set_values(ev.values);
+
+    /* The inputs and outputs are replaced wholesale.  Removed ones are -1, as
+       remove_node() leaves them. */
+
+    if (patch.io_changed) {
+      for (auto id : m_inputs) if (id != none && is_node(id)) get_node(id)->input_id = -1;
+      for (auto id : m_outputs) if (id != none && is_node(id)) get_node(id)->output_id = -1;
+      m_inputs = patch.inputs;
+      m_outputs = patch.outputs;
+      for (i = 0; i < m_inputs.size(); i++) {
+        if (m_inputs[i] != none) {
+          n = get_node(m_inputs[i]);
+          n->input_id = i;
+        }
+      }
+      for (i = 0; i < m_outputs.size(); i++) {
+        if (m_outputs[i] != none) {
+          n = get_node(m_outputs[i]);
+          n->output_id = i;
+        }
+      }
+    }
+
+    if (patch.values_changed) values = patch.network_values;
+    if (patch.data_changed) m_associated_data = std::make_shared<json>(patch.associated_data);
+}
+
+/* ------------------------------------------------------------ */
+/* Network hashing.  Each node and edge is hashed on its own, into two 64-bit lanes
+   with different seeds, and the network's m_hash is the sum of those.  Adding is
+   commutative, so the order that nodes and edges were added in doesn't matter, and
+   changing one node or edge is just a subtraction and an addition.  hash() mixes
+   m_hash with the PropertyPack, inputs, outputs and network values, which are small. */
+
+namespace {
+
+class Hasher {
+  public:
+    Hasher(uint64_t seed) : a(seed), b(seed ^ 0x9e3779b97f4a7c15ULL) {}
+    void add(uint64_t w) { a = mix(a ^ w); b = mix((b + w) * 0xff51afd7ed558ccdULL); }
+    void add(double d);
+    void add(const string &s);
+    uint64_t a, b;
+
+  protected:
+    static uint64_t mix(uint64_t x);   /* MurmurHash3's 64-bit finalizer */
+};
+
+uint64_t Hasher::mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+/* -0.0 and 0.0 hash the same, since they are equal. */
+
+void Hasher::add(double d)
+{
+  uint64_t w;
+
+  if (d == 0) d = 0;
+  memcpy(&w, &d, sizeof(w));
+  add(w);
+}
+
+void Hasher::add(const string &s)
+{
+  size_t i;
+
+  add((uint64_t) s.size());
+  for (i = 0; i < s.size(); i++) add((uint64_t) (unsigned char) s[i]);
+}
+
+}
+
+string NetworkHash::as_string() const
+{
+  char buf[40];
+
+  snprintf(buf, 40, "%016llx%016llx", (unsigned long long) hi, (unsigned long long) lo);
+  return buf;
+}
+
+void Network::hash_add(const Node *n, bool add) const
+{
+  Hasher h(0x4e4f4445ULL);     // "NODE"
+  size_t i;
+
+  if (!m_hash_valid) return;
+  h.add((uint64_t) n->id);
+  if (m_columns) {
+    for (i = 0; i < m_node_columns.size(); i++) h.add((*m_node_columns[i])[n->column_slot]);
+  } else {
+    for (i = 0; i < n->values.size(); i++) h.add(n->values[i]);
+  }
+  m_hash[0] += (add) ? h.a : -h.a;
+  m_hash[1] += (add) ? h.b : -h.b;
+}
+
+void Network::hash_add(const Edge *e, bool add) const
+{
+  Hasher h(0x45444745ULL);     // "EDGE"
+  size_t i;
+
+  if (!m_hash_valid) return;
+  h.add((uint64_t) e->from->id);
+  h.add((uint64_t) e->to->id);
+  if (m_columns) {
+    for (i = 0; i < m_edge_columns.size(); i++) h.add((*m_edge_columns[i])[e->column_slot]);
+  } else {
+    for (i = 0; i < e->values.size(); i++) h.add(e->values[i]);
+  }
+  m_hash[0] += (add) ? h.a : -h.a;
+  m_hash[1] += (add) ? h.b : -h.b;
+}
+
+NetworkHash Network::hash() const
+{
+  Hasher h(0x4e4554574f524bULL);  // "NETWORK"
+  NetworkHash rv;
+  size_t i;
+
+  if (!m_hash_valid) {
+    m_hash_valid = true;
+    m_hash[0] = 0;
+    m_hash[1] = 0;
+    for (auto &n : m_nodes) hash_add(n.second.get(), true);
+    for (auto &e : m_edges) hash_add(e.second.get(), true);
+  }
+
+  h.add(m_hash[0]);
+  h.add(m_hash[1]);
+  h.add((uint64_t) m_nodes.size());
+  h.add((uint64_t) m_edges.size());
+  h.add(m_properties.as_json().dump());
+  h.add((uint64_t) m_inputs.size());
+  for (i = 0; i < m_inputs.size(); i++) h.add((uint64_t) m_inputs[i]);
+  h.add((uint64_t) m_outputs.size());
+  for (i = 0; i < m_outputs.size(); i++) h.add((uint64_t) m_outputs[i]);
+  h.add((uint64_t) values.size());
+  for (i = 0; i < values.size(); i++) h.add(values[i]);
+
+  rv.hi = h.a;
+  rv.lo = h.b;
+  return rv;
+}
+
+/* ------------------------------------------------------------ */
+/* Graph analysis.  This works on column slots, like prune().  The edges are copied
+   into one array, with each node's edges sorted by the to node's id, so that the
+   traversals don't chase Edge pointers, and so that the order of the hash tables
+   doesn't change the answers. */
+
+json NetworkAnalysis::as_json() const
+{
+    json rv;
+
+    rv = json::object();
+    rv["Num_Components"] = components.size();
+    rv["Cycles"] = cycles;
+    rv["Levels"] = levels;
+    rv["Critical_Delay"] = critical_delay;
+    rv["Critical_Path"] = critical_path;
+    rv["Exact"] = exact;
+    rv["IO_Cycles"] = io_cycles;
+    rv["Max_Edge_Delay"] = max_edge_delay;
+    rv["Fan_In"] = fan_in;
+    rv["Fan_Out"] = fan_out;
+    return rv;
+}
+
+NetworkAnalysis Network::analyze(const string &delay_name) const
+{
+    NetworkAnalysis rv;
+    size_t n, i, j, k, c, s, w, m, v, x, mask;
+    vector <uint32_t> order;                  // Slots, sorted by id
+    vector <size_t> first;                    // Slot s's edges are adj[first[s]] to adj[first[s+1]-1]
+    vector <uint32_t> adj;                    // The to slots
+    vector <double> delay;                    // The edges' delays
+    vector < pair <uint32_t, Edge *> > tmp;
+    vector <int64_t> index, low;              // For Tarjan's algorithm
+    vector <uint32_t> stack, calls;
+    vector <size_t> pos;
+    vector <bool> on_stack;
+    vector < vector <uint32_t> > comps;       // Components, as slots
+    vector <uint32_t> comp;                   // The component of each slot
+    vector <size_t> level;                    // The level of each component
+    vector <double> dist;
+    vector <int64_t> pred;
+    vector <bool> reached;
+    vector < vector <uint32_t> > inner;       // A node's path through its component
+    vector <size_t> local;                    // A slot's index in its component
+    vector <size_t> entry;                    // The reached nodes of a component
+    vector <int64_t> entry_pred;
+    vector <double> val, sp;                  // Longest paths by (mask, node), shortest paths
+    vector <bool> ok, done;
+    vector <int64_t> par;
+    std::priority_queue < pair <double, size_t>, vector < pair <double, size_t> >,
+                          std::greater < pair <double, size_t> > > heap;
+    vector <uint64_t> from_inputs, to_outputs;
+    vector <Node *> start;
+    PropertyHandle h;
+    bool has_delay;
+    int64_t counter, best;
+    double d;
+
+    n = m_column_nodes.size();
+    has_delay = (m_properties.edges.find(delay_name) != m_properties.edges.end());
+    if (has_delay) h = edge_handle(delay_name);
+
+    order.resize(n);
+    for (s = 0; s < n; s++) order[s] = s;
+    std::sort(order.begin(), order.end(),
+              [this](uint32_t a, uint32_t b) { return m_column_nodes[a]->id < m_column_nodes[b]->id; });
+
+    first.resize(n+1);
+    adj.reserve(m_edges.size());
+    delay.reserve(m_edges.size());
+    for (s = 0; s < n; s++) {
+      first[s] = adj.size();
+      tmp.clear();
+      for (auto e : m_column_nodes[s]->outgoing) tmp.push_back(make_pair(e->to->id, e));
+      std::sort(tmp.begin(), tmp.end(),
+                [](const pair <uint32_t, Edge *> &a, const pair <uint32_t, Edge *> &b)
+                  { return a.first < b.first; });
+      for (i = 0; i < tmp.size(); i++) {
+        adj.push_back(tmp[i].second->to->column_slot);
+        d = (has_delay) ? tmp[i].second->get(h) : 1;
+        delay.push_back(d);
+        if (d > rv.max_edge_delay) rv.max_edge_delay = d;
+      }
+    }
+    first[n] = adj.size();
+
+    /* Tarjan's algorithm, with an explicit call stack.  It finds the components in
+       reverse topological order. */
+
+    index.resize(n, -1);
+    low.resize(n, 0);
+    on_stack.resize(n, false);
+    counter = 0;
+
+    for (i = 0; i < n; i++) {
+      if (index[order[i]] >= 0) continue;
+      s = order[i];
+      index[s] = low[s] = counter++;
+      stack.push_back(s);
+      on_stack[s] = true;
+      calls.push_back(s);
+      pos.push_back(first[s]);
+
+      while (!calls.empty()) {
+        s = calls.back();
+        if (pos.back() < first[s+1]) {
+          w = adj[pos.back()];
+          pos.back()++;
+          if (index[w] < 0) {
+            index[w] = low[w] = counter++;
+            stack.push_back(w);
+            on_stack[w] = true;
+            calls.push_back(w);
+            pos.push_back(first[w]);
+          } else if (on_stack[w] && index[w] < low[s]) {
+            low[s] = index[w];
+          }
+        } else {
+          calls.pop_back();
+          pos.pop_back();
+          if (!calls.empty() && low[s] < low[calls.back()]) low[calls.back()] = low[s];
+          if (low[s] == index[s]) {
+            comps.resize(comps.size()+1);
+            do {
+              w = stack.back();
+              stack.pop_back();
+              on_stack[w] = false;
+              comps.back().push_back(w);
+            } while (w != s);
+          }
+        }
+      }
+    }
+    std::reverse(comps.begin(), comps.end());
+
+    /* Sort each component by id, and note the cycles. */
+
+    comp.resize(n);
+    rv.components.resize(comps.size());
+    for (c = 0; c < comps.size(); c++) {
+      std::sort(comps[c].begin(), comps[c].end(),
+                [this](uint32_t a, uint32_t b) { return m_column_nodes[a]->id < m_column_nodes[b]->id; });
+      for (i = 0; i < comps[c].size(); i++) {
+        comp[comps[c][i]] = c;
+        rv.components[c].push_back(m_column_nodes[comps[c][i]]->id);
+      }
+      if (comps[c].size() > 1) {
+        rv.cycles.push_back(rv.components[c]);
+      } else {
+        s = comps[c][0];
+        for (j = first[s]; j < first[s+1]; j++) {
+          if (adj[j] == s) {
+            rv.cycles.push_back(rv.components[c]);
+            break;
+          }
+        }
+      }
+    }
+
+    /* Levels.  Since the components are in topological order, a component's level is
+       final by the time that we get to it. */
+
+    level.resize(comps.size(), 0);
+    for (c = 0; c < comps.size(); c++) {
+      for (i = 0; i < comps[c].size(); i++) {
+        s = comps[c][i];
+        for (j = first[s]; j < first[s+1]; j++) {
+          k = comp[adj[j]];
+          if (k != c && level[k] < level[c] + 1) level[k] = level[c] + 1;
+        }
+      }
+      if (level[c] >= rv.levels.size()) rv.levels.resize(level[c] + 1);
+      for (i = 0; i < rv.components[c].size(); i++) rv.levels[level[c]].push_back(rv.components[c][i]);
+    }
+    for (i = 0; i < rv.levels.size(); i++) std::sort(rv.levels[i].begin(), rv.levels[i].end());
+
+    /* The critical path, in the same order.  Within a component, the path goes from one of
+       its reached nodes (its entry) to each of its other nodes along a simple path.  In
+       components of up to 12 nodes, we try every simple path, keeping the longest, so
+       the delay is exact.  In bigger ones, each node takes the shortest path from the
+       nearest entry, so the delay there is a lower bound.  When a node's path goes
+       through its component, inner[s] holds the path from the entry to s, and pred[s]
+       is the node before the entry. */
+
+    dist.resize(n, 0);
+    pred.resize(n, -1);
+    reached.resize(n, false);
+    inner.resize(n);
+    local.resize(n, 0);
+    for (i = 0; i < m_inputs.size(); i++) {
+      if (is_node(m_inputs[i])) reached[get_node(m_inputs[i])->column_slot] = true;
+    }
+    for (c = 0; c < comps.size(); c++) {
+      m = comps[c].size();
+      entry.clear();
+      for (i = 0; i < m; i++) {
+        local[comps[c][i]] = i;
+        if (reached[comps[c][i]]) entry.push_back(i);
+      }
+
+      if (m > 1 && !entry.empty() && m <= 12) {
+
+        /* State (mask, v) is the longest path from an entry to v through the nodes in mask.
+           Adding a node makes the mask bigger, so going through the masks in order works. */
+
+        val.assign(((size_t) 1 << m) * m, 0);
+        ok.assign(val.size(), false);
+        par.assign(val.size(), -1);
+        for (i = 0; i < entry.size(); i++) {
+          k = ((size_t) 1 << entry[i]) * m + entry[i];
+          val[k] = dist[comps[c][entry[i]]];
+          ok[k] = true;
+        }
+        for (mask = 1; mask < ((size_t) 1 << m); mask++) {
+          for (v = 0; v < m; v++) {
+            k = mask * m + v;
+            if (!ok[k]) continue;
+            s = comps[c][v];
+            for (j = first[s]; j < first[s+1]; j++) {
+              w = adj[j];
+              if (comp[w] != c || (mask & ((size_t) 1 << local[w]))) continue;
+              x = (mask | ((size_t) 1 << local[w])) * m + local[w];
+              if (!ok[x] || val[k] + delay[j] > val[x]) {
+                ok[x] = true;
+                val[x] = val[k] + delay[j];
+                par[x] = v;
+              }
+            }
+          }
+        }
+
+        /* Pred changes as we go, so save the entries' preds first. */
+
+        entry_pred.resize(m);
+        for (v = 0; v < m; v++) entry_pred[v] = pred[comps[c][v]];
+        for (v = 0; v < m; v++) {
+          best = -1;
+          for (mask = 1; mask < ((size_t) 1 << m); mask++) {
+            k = mask * m + v;
+            if (ok[k] && (best < 0 || val[k] > val[best])) best = k;
+          }
+          if (best < 0) continue;
+          s = comps[c][v];
+          reached[s] = true;
+          dist[s] = val[best];
+          inner[s].clear();
+          for (mask = best / m, x = v; ; ) {
+            inner[s].push_back(comps[c][x]);
+            k = mask * m + x;
+            if (par[k] < 0) break;
+            mask &= ~((size_t) 1 << x);
+            x = par[k];
+          }
+          std::reverse(inner[s].begin(), inner[s].end());
+          pred[s] = entry_pred[local[inner[s][0]]];
+        }
+
+      } else if (m > 1 && !entry.empty()) {
+
+        /* Dijkstra's algorithm from all of the entries at once. */
+
+        rv.exact = false;
+        sp.assign(m, 0);
+        ok.assign(m, false);
+        done.assign(m, false);
+        while (!heap.empty()) heap.pop();
+        for (i = 0; i < entry.size(); i++) {
+          ok[entry[i]] = true;
+          heap.push(make_pair(0.0, entry[i]));
+        }
+        while (!heap.empty()) {
+          v = heap.top().second;
+          heap.pop();
+          if (done[v]) continue;
+          done[v] = true;
+          s = comps[c][v];
+          for (j = first[s]; j < first[s+1]; j++) {
+            w = adj[j];
+            if (comp[w] != c || reached[w]) continue;
+            x = local[w];
+            if (!ok[x] || sp[v] + delay[j] < sp[x]) {
+              ok[x] = true;
+              sp[x] = sp[v] + delay[j];
+              heap.push(make_pair(sp[x], x));
+              dist[w] = dist[s] + delay[j];
+              pred[w] = s;
+            }
+          }
+        }
+        for (v = 0; v < m; v++) if (ok[v]) reached[comps[c][v]] = true;
+      }
+
+      /* Now the edges out of the component. */
+
+      for (i = 0; i < m; i++) {
+        s = comps[c][i];
+        if (!reached[s]) continue;
+        for (j = first[s]; j < first[s+1]; j++) {
+          w = adj[j];
+          if (comp[w] == c) continue;
+          if (!reached[w] || dist[s] + delay[j] > dist[w]) {
+            reached[w] = true;
+            dist[w] = dist[s] + delay[j];
+            pred[w] = s;
+          }
+        }
+      }
+    }
+
+    best = -1;
+    for (i = 0; i < n; i++) {
+      s = order[i];
+      if (m_column_nodes[s]->is_output() && reached[s] && (best < 0 || dist[s] > dist[best])) best = s;
+    }
+    if (best >= 0) {
+      rv.critical_delay = dist[best];
+      while (best >= 0) {
+        if (inner[best].empty()) {
+          rv.critical_path.push_back(m_column_nodes[best]->id);
+        } else {
+          for (i = inner[best].size(); i > 0; i--) {
+            rv.critical_path.push_back(m_column_nodes[inner[best][i-1]]->id);
+          }
+        }
+        best = pred[best];
+      }
+      std::reverse(rv.critical_path.begin(), rv.critical_path.end());
+    }
+
+    /* A cycle is on an input -> output path if it's reachable from an input, and it can
+       reach an output.  Every node in a component is the same that way. */
+
+    from_inputs.resize((n + 63) / 64, 0);
+    to_outputs.resize((n + 63) / 64, 0);
+    for (auto id : m_inputs) if (is_node(id)) start.push_back(get_node(id));
+    mark_reachable(start, true, from_inputs);
+    start.clear();
+    for (auto id : m_outputs) if (is_node(id)) start.push_back(get_node(id));
+    mark_reachable(start, false, to_outputs);
+
+    for (i = 0; i < rv.cycles.size() && !rv.io_cycles; i++) {
+      s = get_node(rv.cycles[i][0])->column_slot;
+      if (bit_test(from_inputs, s) && bit_test(to_outputs, s)) rv.io_cycles = true;
+    }
+
+    /* Fan-in and fan-out. */
+
+    for (s = 0; s < n; s++) {
+      j = m_column_nodes[s]->incoming.size();
+      k = m_column_nodes[s]->outgoing.size();
+      if (j >= rv.fan_in.size()) rv.fan_in.resize(j+1, 0);
+      if (k >= rv.fan_out.size()) rv.fan_out.resize(k+1, 0);
+      rv.fan_in[j]++;
+      rv.fan_out[k]++;
+    }
+
+    return rv;
+}
+
+/* ------------------------------------------------------------ */
+/* The column store */
+
+void Network::enable_columns()
+{
+    char buf[200];
+    vector <Node *> nodes;
+
+    if (m_columns) return;
+
+    /* Check first, so that an error leaves the network as it was. */
+
+    for (auto &n : m_nodes) {
+      if (n.second->values.size() != (size_t) m_properties.node_vec_size) {
+        snprintf(buf, 200, "enable_columns(): Node %u has %d values, and there should be %d",
+                 n.first, (int) n.second->values.size(), (int) m_properties.node_vec_size);
+        throw SRE(buf);
+      }
+    }
+    for (auto &e : m_edges) {
+      if (e.second->values.size() != (size_t) m_properties.edge_vec_size) {
+        snprintf(buf, 200, "enable_columns(): Edge %u -> %u has %d values, and there should be %d",
+                 e.first.first, e.first.second, (int) e.second->values.size(),
+                 (int) m_properties.edge_vec_size);
+        throw SRE(buf);
+      }
+    }
+
+    m_columns = true;
+    m_node_columns.resize(m_properties.node_vec_size);
+    m_edge_columns.resize(m_properties.edge_vec_size);
+    for (auto &c : m_node_columns) {
+      c = std::make_shared< vector <double> >();
+      c->reserve(m_nodes.size());
+    }
+    for (auto &c : m_edge_columns) {
+      c = std::make_shared< vector <double> >();
+      c->reserve(m_edges.size());
+    }
+
+    /* Renumber the slots, going through the nodes by id, so that node column_slots are in
+       id order.  This doesn't use sorted_node_vector, because making it changes the order
+       of pretty_json(). */
+
+    nodes = m_column_nodes;
+    std::sort(nodes.begin(), nodes.end(), [](const Node *a, const Node *b) { return a->id < b->id; });
+    m_column_nodes.clear();
+    m_column_edges.clear();
+    for (auto n : nodes) {
+      n->column_slot = m_column_nodes.size();
+      m_column_nodes.push_back(n);
+      column_add(n);
+    }
+    for (auto n : nodes) {
+      for (auto e : n->outgoing) {
+        e->column_slot = m_column_edges.size();
+        m_column_edges.push_back(e);
+        column_add(e);
+      }
+    }
+}
+
+void Network::disable_columns()
+{
+    if (!m_columns) return;
+
+    for (auto n : m_column_nodes) n->values = n->get_values();
+    for (auto e : m_column_edges) e->values = e->get_values();
+    m_columns = false;
+    m_node_columns.clear();
+    m_edge_columns.clear();
+}
+
+bool Network::columns_enabled() const
+{
+    return m_columns;
+}
+
+double *Network::node_column(int idx)
+{
+    if (!m_columns) throw SRE("node_column(): The column store is not enabled");
+    m_hash_valid = false;     // We can't see what the caller writes.
+    return own_column(m_node_columns.at(idx)).data();
+}
+
+double *Network::edge_column(int idx)
+{
+    if (!m_columns) throw SRE("edge_column(): The column store is not enabled");
+    m_hash_valid = false;     // We can't see what the caller writes.
+    return own_column(m_edge_columns.at(idx)).data();
+}
+
+const double *Network::node_column(int idx) const
+{
+    if (!m_columns) throw SRE("node_column(): The column store is not enabled");
+    return m_node_columns.at(idx)->data();
+}
+
+const double *Network::edge_column(int idx) const
+{
+    if (!m_columns) throw SRE("edge_column(): The column store is not enabled");
+    return m_edge_columns.at(idx)->data();
+}
+
+/* Copies of a network share its columns and associated data.  Before one is modified,
+   these make a private copy of it, if anyone else is sharing it. */
+
+vector <double> &Network::own_column(shared_ptr < vector <double> > &c) const
+{
+    if (c.use_count() != 1) c = std::make_shared< vector <double> >(*c);
+    return *c;
+}
+
+json &Network::own_associated_data()
+{
+    if (m_associated_data.use_count() != 1) m_associated_data = std::make_shared<json>(*m_associated_data);
+    return *m_associated_data;
+}
+
+const vector <Node *> &Network::column_nodes() const
+{
+    return m_column_nodes;
+}
+
+const vector <Edge *> &Network::column_edges() const
+{
+    return m_column_edges;
+}
+
+/* These move the values into the columns, and free the values vectors.  n must have
+   the last slot. */
+
+void Network::column_add(Node *n)
+{
+    size_t i;
+
+    for (i = 0; i < m_node_columns.size(); i++) own_column(m_node_columns[i]).push_back(n->values[i]);
+    vector <double>().swap(n->values);
+}
+
+void Network::column_add(Edge *e)
+{
+    size_t i;
+
+    for (i = 0; i < m_edge_columns.size(); i++) own_column(m_edge_columns[i]).push_back(e->values[i]);
+    vector <double>().swap(e->values);
+}
+
+/* Removal moves the last slot into the removed one, so the slot vectors and the columns
+   stay dense.  This is called whether or not the column store is on. */
+
+void Network::column_remove(Node *n)
+{
+    uint32_t slot;
+    Node *last;
+    size_t i;
+
+    slot = n->column_slot;
+    last = m_column_nodes.back();
+    for (i = 0; i < m_node_columns.size(); i++) {
+      vector <double> &c = own_column(m_node_columns[i]);
+      c[slot] = c.back();
+      c.pop_back();
+    }
+    m_column_nodes[slot] = last;
+    last->column_slot = slot;
+    m_column_nodes.pop_back();
+}
+
+void Network::column_remove(Edge *e)
+{
+    uint32_t slot;
+    Edge *last;
+    size_t i;
+
+    slot = e->column_slot;
+    last = m_column_edges.back();
+    for (i = 0; i < m_edge_columns.size(); i++) {
+      vector <double> &c = own_column(m_edge_columns[i]);
+      c[slot] = c.back();
+      c.pop_back();
+    }
+    m_column_edges[slot] = last;
+    last->column_slot = slot;
+    m_column_edges.pop_back();
+}
+
+/* ------------------------------------------------------------ */
+/* The JSON writers.  These write the network's JSON straight to an ostream, without
+   making json objects for the nodes and edges.  The output is character-for-character
+   what nlohmann's dump() makes from as_json(), or what pretty_json() has always made,
+   so the keys are written in sorted order, and doubles use nlohmann's to_chars(). */
+
+static void write_json_double(std::ostream &out, double d)
+{
+  char buf[64];
+  char *end;
+
+  if (!std::isfinite(d)) {
+    out.write("null", 4);
+  } else {
+    end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), d);
+    out.write(buf, end - buf);
+  }
+}
+
+static void write_json_uint(std::ostream &out, uint32_t u)
+{
+  char buf[16];
+  int n;
+
+  n = snprintf(buf, sizeof(buf), "%u", u);
+  out.write(buf, n);
+}
+
+static void write_json_doubles(std::ostream &out, const vector <double> &v)
+{
+  size_t i;
+
+  out.put('[');
+  for (i = 0; i < v.size(); i++) {
+    if (i != 0) out.put(',');
+    write_json_double(out, v[i]);
+  }
+  out.put(']');
+}
+
+static void write_json_uints(std::ostream &out, const vector <uint32_t> &v)
+{
+  size_t i;
+
+  out.put('[');
+  for (i = 0; i < v.size(); i++) {
+    if (i != 0) out.put(',');
+    write_json_uint(out, v[i]);
+  }
+  out.put(']');
+}
+
+/* These match node_json(n).dump() and e->as_json().dump(). */
+
+static void write_node_json(std::ostream &out, const Node *n)
+{
+  vector <double> tmp;
+
+  out.put('{');
+  if (n->coordinates.size() != 0) {
+    out << "\"coords\":";
+    write_json_doubles(out, n->coordinates);
+    out.put(',');
+  }
+  out << "\"id\":";
+  write_json_uint(out, n->id);
+  if (n->name != "") out << ",\"name\":" << json(n->name).dump();
+  out << ",\"values\":";
+  write_json_doubles(out, values_of(n, tmp));
+  out.put('}');
+}
+
+static void write_edge_json(std::ostream &out, const Edge *e)
+{
+  vector <double> tmp;
+
+  out.put('{');
+  if (e->control_point.size() != 0) {
+    out << "\"control_point\":";
+    write_json_doubles(out, e->control_point);
+    out.put(',');
+  }
+  out << "\"from\":";
+  write_json_uint(out, e->from->id);
+  out << ",\"to\":";
+  write_json_uint(out, e->to->id);
+  out << ",\"values\":";
+  write_json_doubles(out, values_of(e, tmp));
+  out.put('}');
+}
+
+/* One node per line, with indent in front of each line. */
+
+void Network::write_pretty_nodes(std::ostream &out, const string &indent) const
+{
+  size_t i;
+  bool use_vector;
+  NodeMap::const_iterator nit;
+
+  out << indent;
+  if (m_nodes.size() == 0) {
+    out << "[]";
+    return;
+  }
+
+  use_vector = (sorted_node_vector.size() != 0);
+
+  nit = m_nodes.begin();
+  for (i = 0; i < m_nodes.size(); i++) {
+    out << ((i == 0) ? "[ " : "  ");
+    write_node_json(out, (use_vector) ? sorted_node_vector[i] : nit->second.get());
+    if (i+1 == m_nodes.size()) {
+      out << " ]";
+    } else {
+      out << ",\n" << indent;
+    }
+    nit++;
+  }
+}
+
+/* One edge per line.  If the nodes are sorted, then the edges are sorted by from, and
+   then to.  Otherwise, they are in the order of the hash table. */
+
+void Network::write_pretty_edges(std::ostream &out, const string &indent) const
+{
+  size_t i, j;
+  bool first;
+  vector <Edge *> edges;
+  EdgeMap::const_iterator eit;
+
+  out << indent;
+  if (num_edges() == 0) {
+    out << "[]";
+    return;
+  }
+
+  first = true;
+  if (sorted_node_vector.size() == 0) {
+    for (eit = m_edges.begin(); eit != m_edges.end(); eit++) {
+      out << ((first) ? "[ " : (",\n" + indent + "  "));
+      write_edge_json(out, eit->second.get());
+      first = false;
+    }
+  } else {
+    for (i = 0; i < sorted_node_vector.size(); i++) {
+      edges = sorted_node_vector[i]->outgoing;
+      std::sort(edges.begin(), edges.end(),
+                [](const Edge *a, const Edge *b) { return a->to->id < b->to->id; });
+      for (j = 0; j < edges.size(); j++) {
+        out << ((first) ? "[ " : (",\n" + indent + "  "));
+        write_edge_json(out, edges[j]);
+        first = false;
+      }
+    }
+  }
+  out << " ]";
+}
+
+string Network::pretty_nodes() const
+{
+  std::ostringstream ss;
+
+  write_pretty_nodes(ss, "");
+  return ss.str();
+}
+
+string Network::pretty_edges() const
+{
+  std::ostringstream ss;
+
+  write_pretty_edges(ss, "");
+  return ss.str();
+}
+
+static void append_and_indent(const string &from, string &to, size_t chars)
+{
+  size_t i, j;
+  char lc;
+
+  lc = '\n';
+  for (i = 0; i < from.size(); i++) {
+    if (lc == '\n') {
+      for (j = 0; j < chars; j++) to.push_back(' ');
+    }
+    to.push_back(from[i]);
+    lc = from[i];
+  }
+}
 
 static string pretty_json_generic(const json &j)
 {
@@ -1218,28 +3589,494 @@ static string pretty_json_generic(const json &j)
   }
 }
 
+void Network::write_json(std::ostream &out, bool pretty) const
+{
+  const json &ad = *m_associated_data;
+  string s;
+  bool first;
+
+  if (pretty) {
+    out << "{ \"Properties\":\n";
+    s.clear();
+    append_and_indent(m_properties.pretty_json(), s, 2);
+    out << s << ",\n \"Nodes\":\n";
+    write_pretty_nodes(out, "  ");
+    out << ",\n \"Edges\":\n";
+    write_pretty_edges(out, "  ");
+    out << ",\n \"Inputs\": ";
+    write_json_uints(out, m_inputs);
+    out << ",\n \"Outputs\": ";
+    write_json_uints(out, m_outputs);
+    out << ",\n \"Network_Values\": ";
+    write_json_doubles(out, values);
+    out << ",\n \"Associated_Data\":\n";
+    s.clear();
+    append_and_indent(pretty_json_generic((ad == nullptr) ? json::object() : ad), s, 2);
+    out << s << "}";
+    return;
+  }
+
+  /* This is as_json().dump(), so the keys are in alphabetical order. */
+
+  out << "{\"Associated_Data\":" << ((ad == nullptr) ? "{}" : ad.dump());
+  out << ",\"Edges\":[";
+  first = true;
+  for (auto &e : m_edges) {
+    if (!first) out.put(',');
+    write_edge_json(out, e.second.get());
+    first = false;
+  }
+  out << "],\"Inputs\":";
+  write_json_uints(out, m_inputs);
+  out << ",\"Network_Values\":";
+  write_json_doubles(out, values);
+  out << ",\"Nodes\":[";
+  first = true;
+  for (auto &n : m_nodes) {
+    if (!first) out.put(',');
+    write_node_json(out, n.second.get());
+    first = false;
+  }
+  out << "],\"Outputs\":";
+  write_json_uints(out, m_outputs);
+  out << ",\"Properties\":" << m_properties.as_json().dump() << "}";
+}
+
 string Network::pretty_json() const
 {
-  json j1;
+  std::ostringstream ss;
+
+  write_json(ss, true);
+  return ss.str();
+}
+
+/* ------------------------------------------------------------ */
+/* The binary network format.  The layout is documented in
+   markdown/network_binary_format.md.  Everything is written in native byte order,
+   and each section starts on an 8-byte boundary, so that a mapped image may be
+   used in place. */
+
+static const char NETWORK_IMAGE_MAGIC[8] = { 'T', 'N', 'N', 'E', 'T', 'B', 'I', 'N' };
+static const uint32_t NETWORK_IMAGE_BYTE_ORDER = 0x01020304;
+
+/* Pad the buffer to an 8-byte boundary, append the bytes, and return their offset. */
+
+static uint64_t bin_section(vector <uint8_t> &buf, const void *bytes, size_t n)
+{
+  uint64_t offset;
+
+  while (buf.size() % 8 != 0) buf.push_back(0);
+  offset = buf.size();
+  bin_put_bytes(buf, bytes, n);
+  return offset;
+}
+
+/* Throw unless count1*count2 elements of the given size fit in the image at offset. */
+
+static void check_image_section(const NetworkImageHeader *h, uint64_t offset, 
+                                uint64_t count1, uint64_t count2, size_t size,
+                                const char *name)
+{
+  uint64_t n;
+  string s;
+
+  s = (string) "Bad binary network - the " + name + " section is out of bounds.";
+  if (offset % 8 != 0 || offset > h->image_size) throw SRE(s);
+  if (count2 != 0 && count1 > UINT64_MAX / count2) throw SRE(s);
+  n = count1 * count2;
+  if (n > (h->image_size - offset) / size) throw SRE(s);
+}
+
+static json parse_image_json(const string &text, const char *name)
+{
+  try {
+    return json::parse(text);
+  } catch (...) {
+    throw SRE((string) "Bad binary network - the " + name + " section is not valid JSON.");
+  }
+}
+
+NetworkImage::~NetworkImage() noexcept
+{
+  close();
+}
+
+void NetworkImage::open(const string &filename)
+{
+  int fd;
+  struct stat st;
+  void *p;
+
+  close();
+  fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw SRE((string) "Couldn't open " + filename);
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    throw SRE((string) "Bad binary network - " + filename + " is empty.");
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw SRE((string) "Couldn't mmap " + filename);
+
+  try {
+    attach(p, st.st_size);
+  } catch (...) {
+    munmap(p, st.st_size);
+    throw;
+  }
+  m_map = p;
+  m_map_size = st.st_size;
+}
+
+void NetworkImage::attach(const void *buf, size_t size)
+{
+  const NetworkImageHeader *h;
+  char ebuf[200];
+
+  close();
+
+  h = (const NetworkImageHeader *) buf;
+  if (((uintptr_t) buf) % 8 != 0) {
+    throw SRE("Bad binary network - the image isn't 8-byte aligned.");
+  }
+  if (size < sizeof(NetworkImageHeader) || memcmp(h->magic, NETWORK_IMAGE_MAGIC, 8) != 0) {
+    throw SRE("Bad binary network - no TNNETBIN header.");
+  }
+  if (h->byte_order != NETWORK_IMAGE_BYTE_ORDER) {
+    throw SRE("Bad binary network - it was written with a different byte order.");
+  }
+  if (h->version != VERSION) {
+    snprintf(ebuf, 200, "Bad binary network - version %u (this code reads version %u).",
+             h->version, VERSION);
+    throw SRE(ebuf);
+  }
+  if (h->image_size != size) {
+    snprintf(ebuf, 200, "Bad binary network - the header's size is %llu, but the image is %llu bytes.",
+             (unsigned long long) h->image_size, (unsigned long long) size);
+    throw SRE(ebuf);
+  }
+  if (h->num_nodes > UINT32_MAX) throw SRE("Bad binary network - too many nodes.");
+
+  check_image_section(h, h->properties_offset, h->properties_size, 1, 1, "properties");
+  check_image_section(h, h->node_ids_offset, h->num_nodes, 1, sizeof(uint32_t), "node id");
+  check_image_section(h, h->node_values_offset, h->num_nodes, h->node_vec_size,
+                      sizeof(double), "node value");
+  check_image_section(h, h->edge_offsets_offset, h->num_nodes + 1, 1, sizeof(uint64_t),
+                      "edge offset");
+  check_image_section(h, h->edge_to_offset, h->num_edges, 1, sizeof(uint32_t), "edge to");
+  check_image_section(h, h->edge_values_offset, h->num_edges, h->edge_vec_size,
+                      sizeof(double), "edge value");
+  check_image_section(h, h->inputs_offset, h->num_inputs, 1, sizeof(uint32_t), "input");
+  check_image_section(h, h->outputs_offset, h->num_outputs, 1, sizeof(uint32_t), "output");
+  check_image_section(h, h->network_values_offset, h->net_vec_size, 1, sizeof(double),
+                      "network value");
+  check_image_section(h, h->extras_offset, h->extras_size, 1, 1, "extras");
+  check_image_section(h, h->associated_data_offset, h->associated_data_size, 1, 1,
+                      "associated data");
+
+  m_base = (const uint8_t *) buf;
+  m_size = size;
+}
+
+void NetworkImage::close()
+{
+  if (m_map != nullptr) munmap(m_map, m_map_size);
+  m_map = nullptr;
+  m_map_size = 0;
+  m_base = nullptr;
+  m_size = 0;
+}
+
+const NetworkImageHeader *NetworkImage::header() const
+{
+  return (const NetworkImageHeader *) m_base;
+}
+
+const uint32_t *NetworkImage::node_ids() const
+{
+  return (const uint32_t *) (m_base + header()->node_ids_offset);
+}
+
+const double *NetworkImage::node_values() const
+{
+  return (const double *) (m_base + header()->node_values_offset);
+}
+
+const uint64_t *NetworkImage::edge_offsets() const
+{
+  return (const uint64_t *) (m_base + header()->edge_offsets_offset);
+}
+
+const uint32_t *NetworkImage::edge_to() const
+{
+  return (const uint32_t *) (m_base + header()->edge_to_offset);
+}
+
+const double *NetworkImage::edge_values() const
+{
+  return (const double *) (m_base + header()->edge_values_offset);
+}
+
+const uint32_t *NetworkImage::inputs() const
+{
+  return (const uint32_t *) (m_base + header()->inputs_offset);
+}
+
+const uint32_t *NetworkImage::outputs() const
+{
+  return (const uint32_t *) (m_base + header()->outputs_offset);
+}
+
+const double *NetworkImage::network_values() const
+{
+  return (const double *) (m_base + header()->network_values_offset);
+}
+
+string NetworkImage::properties_json() const
+{
+  return string((const char *) m_base + header()->properties_offset, header()->properties_size);
+}
+
+string NetworkImage::extras_json() const
+{
+  return string((const char *) m_base + header()->extras_offset, header()->extras_size);
+}
+
+string NetworkImage::associated_data_json() const
+{
+  return string((const char *) m_base + header()->associated_data_offset,
+                header()->associated_data_size);
+}
+
+void Network::to_binary(vector<uint8_t> &buf) const
+{
+  NetworkImageHeader h;
+  vector <Node *> nodes;
+  vector <Edge *> edges;
+  vector <uint32_t> ids, edge_to;
+  vector <uint64_t> edge_offsets;
+  vector <double> node_values, edge_values;
+  tsl::robin_map <uint32_t, uint32_t> index;
+  json extras;
   string s;
+  size_t i, j;
+  Node *n;
+  Edge *e;
+  char ebuf[200];
+  vector <double> tmp;
+
+  /* Number the nodes in order of their ids.  Names and coordinates go into extras. */
+
+  extras = json::object();
+  nodes.reserve(m_nodes.size());
+  for (auto &np : m_nodes) nodes.push_back(np.second.get());
+  std::sort(nodes.begin(), nodes.end(), [](const Node *a, const Node *b) { return a->id < b->id; });
+
+  ids.reserve(nodes.size());
+  node_values.reserve(nodes.size() * m_properties.node_vec_size);
+  index.reserve(nodes.size());
+  for (i = 0; i < nodes.size(); i++) {
+    n = nodes[i];
+    const vector <double> &nv = values_of(n, tmp);
+    if (nv.size() != (size_t) m_properties.node_vec_size) {
+      snprintf(ebuf, 200, "Network::to_binary() - node %u's values don't match the PropertyPack.",
+               n->id);
+      throw SRE(ebuf);
+    }
+    index[n->id] = i;
+    ids.push_back(n->id);
+    node_values.insert(node_values.end(), nv.begin(), nv.end());
+    if (n->name != "") extras["Names"].push_back(json::array({ n->id, n->name }));
+    if (n->coordinates.size() != 0) {
+      extras["Coords"].push_back(json::array({ n->id, n->coordinates }));
+    }
+  }
+
+  /* The edges go in CSR order: grouped by the from node, and sorted by the to node. */
+
+  edge_offsets.reserve(nodes.size() + 1);
+  edge_to.reserve(m_edges.size());
+  edge_values.reserve(m_edges.size() * m_properties.edge_vec_size);
+  edge_offsets.push_back(0);
+  for (i = 0; i < nodes.size(); i++) {
+    edges = nodes[i]->outgoing;
+    std::sort(edges.begin(), edges.end(), 
+              [](const Edge *a, const Edge *b) { return a->to->id < b->to->id; });
+    for (j = 0; j < edges.size(); j++) {
+      e = edges[j];
+      const vector <double> &ev = values_of(e, tmp);
+      if (ev.size() != (size_t) m_properties.edge_vec_size) {
+        snprintf(ebuf, 200, "Network::to_binary() - edge %u -> %u's values don't match the PropertyPack.",
+                 e->from->id, e->to->id);
+        throw SRE(ebuf);
+      }
+      edge_to.push_back(index[e->to->id]);
+      edge_values.insert(edge_values.end(), ev.begin(), ev.end());
+      if (e->control_point.size() != 0) {
+        extras["Control_Points"].push_back(json::array({ e->from->id, e->to->id, e->control_point }));
+      }
+    }
+    edge_offsets.push_back(edge_to.size());
+  }
+
+  /* Reserve room for the header, write the sections, and then fill the header in. */
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, NETWORK_IMAGE_MAGIC, 8);
+  h.version = NetworkImage::VERSION;
+  h.byte_order = NETWORK_IMAGE_BYTE_ORDER;
+  h.num_nodes = nodes.size();
+  h.num_edges = edge_to.size();
+  h.num_inputs = m_inputs.size();
+  h.num_outputs = m_outputs.size();
+  h.node_vec_size = m_properties.node_vec_size;
+  h.edge_vec_size = m_properties.edge_vec_size;
+  h.net_vec_size = values.size();
+
+  buf.clear();
+  buf.resize(sizeof(h), 0);
+
+  s = m_properties.as_json().dump();
+  h.properties_offset = bin_section(buf, s.data(), s.size());
+  h.properties_size = s.size();
+  h.node_ids_offset = bin_section(buf, ids.data(), ids.size() * sizeof(uint32_t));
+  h.node_values_offset = bin_section(buf, node_values.data(), node_values.size() * sizeof(double));
+  h.edge_offsets_offset = bin_section(buf, edge_offsets.data(), edge_offsets.size() * sizeof(uint64_t));
+  h.edge_to_offset = bin_section(buf, edge_to.data(), edge_to.size() * sizeof(uint32_t));
+  h.edge_values_offset = bin_section(buf, edge_values.data(), edge_values.size() * sizeof(double));
+  h.inputs_offset = bin_section(buf, m_inputs.data(), m_inputs.size() * sizeof(uint32_t));
+  h.outputs_offset = bin_section(buf, m_outputs.data(), m_outputs.size() * sizeof(uint32_t));
+  h.network_values_offset = bin_section(buf, values.data(), values.size() * sizeof(double));
+
+  s = extras.dump();
+  h.extras_offset = bin_section(buf, s.data(), s.size());
+  h.extras_size = s.size();
+
+  s = (*m_associated_data == nullptr) ? "{}" : m_associated_data->dump();
+  h.associated_data_offset = bin_section(buf, s.data(), s.size());
+  h.associated_data_size = s.size();
+
+  while (buf.size() % 8 != 0) buf.push_back(0);
+  h.image_size = buf.size();
+  memcpy(buf.data(), &h, sizeof(h));
+}
+
+void Network::from_binary(const NetworkImage &img)
+{
+  const NetworkImageHeader *h;
+  const uint32_t *ids, *to, *io;
+  const uint64_t *offsets;
+  const double *v;
+  json extras;
+  Node *n;
+  Edge *e;
+  uint64_t i, k, nvs, evs;
+  char buf[200];
+
+  h = img.header();
+  if (h == nullptr) throw SRE("Network::from_binary() - the NetworkImage is empty.");
+
+  clear(true);
+
+  m_properties.from_json(parse_image_json(img.properties_json(), "properties"));
+  if (h->node_vec_size != (uint64_t) m_properties.node_vec_size ||
+      h->edge_vec_size != (uint64_t) m_properties.edge_vec_size ||
+      h->net_vec_size != (uint64_t) m_properties.net_vec_size) {
+    throw SRE("Error in binary network: the value counts don't match the Property Pack");
+  }
+  nvs = h->node_vec_size;
+  evs = h->edge_vec_size;
+
+  v = img.network_values();
+  values.assign(v, v + h->net_vec_size);
+
+  /* Nodes.  The offsets are checked before any edges are added. */
+
+  m_nodes.reserve(h->num_nodes);
+  m_edges.reserve(h->num_edges);
+
+  ids = img.node_ids();
+  v = img.node_values();
+  for (i = 0; i < h->num_nodes; i++) {
+    n = add_node(ids[i]);
+    n->values.assign(v + i * nvs, v + (i + 1) * nvs);
+  }
+
+  offsets = img.edge_offsets();
+  if (offsets[0] != 0 || offsets[h->num_nodes] != h->num_edges) {
+    throw SRE("Error in binary network: the edge offsets don't cover the edge table");
+  }
+  for (i = 0; i < h->num_nodes; i++) {
+    if (offsets[i] > offsets[i+1]) {
+      throw SRE("Error in binary network: the edge offsets aren't sorted");
+    }
+  }
+
+  /* Edges */
+
+  to = img.edge_to();
+  v = img.edge_values();
+  for (i = 0; i < h->num_nodes; i++) {
+    for (k = offsets[i]; k < offsets[i+1]; k++) {
+      if (to[k] >= h->num_nodes) {
+        snprintf(buf, 200, "Error in binary network: edge %llu's to index is too big",
+                 (unsigned long long) k);
+        throw SRE(buf);
+      }
+      e = add_edge(ids[i], ids[to[k]]);
+      e->values.assign(v + k * evs, v + (k + 1) * evs);
+    }
+  }
+
+  /* Inputs & outputs */
+
+  io = img.inputs();
+  for (i = 0; i < h->num_inputs; i++) add_input(io[i]);
+  io = img.outputs();
+  for (i = 0; i < h->num_outputs; i++) add_output(io[i]);
+
+  /* Names, coordinates, control points, and the associated data */
+
+  extras = parse_image_json(img.extras_json(), "extras");
+  if (extras.contains("Names")) {
+    for (auto &x : extras["Names"]) get_node(x[0].get<uint32_t>())->name = x[1];
+  }
+  if (extras.contains("Coords")) {
+    for (auto &x : extras["Coords"]) {
+      get_node(x[0].get<uint32_t>())->coordinates = x[1].get< vector <double> >();
+    }
+  }
+  if (extras.contains("Control_Points")) {
+    for (auto &x : extras["Control_Points"]) {
+      get_edge(x[0].get<uint32_t>(), x[1].get<uint32_t>())->control_point = 
+        x[2].get< vector <double> >();
+    }
+  }
+
+  m_associated_data = std::make_shared<json>(parse_image_json(img.associated_data_json(), "associated data"));
+}
+
+void Network::write_binary(const string &filename) const
+{
+  vector <uint8_t> buf;
+  FILE *f;
+  size_t written;
+
+  to_binary(buf);
+  f = fopen(filename.c_str(), "wb");
+  if (f == NULL) throw SRE((string) "Couldn't open " + filename);
+  written = fwrite(buf.data(), 1, buf.size(), f);
+  if (fclose(f) != 0 || written != buf.size()) {
+    throw SRE((string) "Error writing " + filename);
+  }
+}
+
+void Network::read_binary(const string &filename)
+{
+  NetworkImage img;
 
-  j1 = as_json();
-  s = "{ \"Properties\":\n";
-  append_and_indent(m_properties.pretty_json(), s, 2);
-  s += ",\n \"Nodes\":\n";
-  append_and_indent(pretty_nodes(), s, 2);
-  s += ",\n \"Edges\":\n";
-  append_and_indent(pretty_edges(), s, 2);
-  s += ",\n \"Inputs\": ";
-  s += j1["Inputs"].dump();
-  s += ",\n \"Outputs\": ";
-  s += j1["Outputs"].dump();
-  s += ",\n \"Network_Values\": ";
-  s += j1["Network_Values"].dump();
-  s += ",\n \"Associated_Data\":\n";
-  append_and_indent(pretty_json_generic(j1["Associated_Data"]), s, 2);
-  s += "}";
-  return s;
+  img.open(filename);
+  from_binary(img);
 }
 
 }  // End of neuro namespace
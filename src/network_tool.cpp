@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <algorithm>
 #include <unistd.h>
 #include "framework.hpp"
 #include "utils/json_helpers.hpp"
@@ -25,13 +26,20 @@ void print_commands(FILE *f)
   fprintf(f, "\nCreate/Clear Network Commands\n");
   fprintf(f, "FJ json                    - Read a network.\n");
   fprintf(f, "TJ [file]                  - Create JSON from the network.\n");
-  fprintf(f, "COPY_FROM                  - Make a copy of yourself using copy_from.  Print & delete.\n");
+  fprintf(f, "FB file                    - Read a network from the binary format.\n");
+  fprintf(f, "TB file                    - Write the network in the binary format.\n");
+  fprintf(f, "COPY_FROM                  - Make a copy of yourself using copy_from.  Print & keep it.\n");
+  fprintf(f, "SWAP                       - Swap the network with the copy from COPY_FROM.\n");
+  fprintf(f, "DIFF json                  - Print the patch that turns the network into this one.\n");
+  fprintf(f, "PATCH json                 - Apply a patch from DIFF to the network.\n");
   fprintf(f, "DESTROY                    - Delete network, create empty network.\n");
   fprintf(f, "CLEAR                      - Clear network\n");
   fprintf(f, "CLEAR_KP                   - Clear network but keep the property pack intact\n");     
   
   fprintf(f, "\nAccess Network Info Commands\n");
   fprintf(f, "INFO                       - Print some info about the network.\n");
+  fprintf(f, "HASH                       - Print the network's 128-bit fingerprint.\n");
+  fprintf(f, "ANALYZE [delay_property]   - Print levels, cycles, the critical path and fan-in/out as JSON.\n");
   fprintf(f, "NODES [node_id] [...]      - Print the nodes using a kind of user-friendly JSON format.\n");
   fprintf(f, "EDGES [from] [to] [...]    - Print the edges using a kind of user-friendly JSON format.\n");
   fprintf(f, "PROPERTIES/P               - Print the network's property pack.\n");
@@ -42,10 +50,13 @@ void print_commands(FILE *f)
   fprintf(f, "\nNetwork Operation Commands\n");
 
   fprintf(f, "PRUNE                      - Prune the network - remove nodes/edges not on an I/O path.\n");
+  fprintf(f, "RANDOMIZE json             - Replace the network with a random one (see network.md).\n");
   fprintf(f, "AN node_id ...             - Add nodes\n");
   fprintf(f, "AI node_id ...             - Add inputs\n");
   fprintf(f, "AO node_id ...             - Add outputs\n");
   fprintf(f, "AE from to ...             - Add edges \n");
+  fprintf(f, "AN_BATCH node_id ...       - Add nodes with add_nodes(): all of them, or none\n");
+  fprintf(f, "AE_BATCH from to ...       - Add edges with add_edges(): all of them, or none\n");
   fprintf(f, "RN node_id ... [IOE(T|F)]  - Remove nodes. IOE (def:F) flags an error if Input/Output\n");
   fprintf(f, "RE from to ...             - Remove edges\n");
   fprintf(f, "RENAME from to             - Rename nodes\n");
@@ -64,9 +75,18 @@ void print_commands(FILE *f)
   fprintf(f, "SEED val                   - Seed the RNG\n");
   fprintf(f, "SHOW_SEED                  - Show the RNG seed\n");
   fprintf(f, "RE_SEED                    - Re-seed the RNG based on the current time & show seed\n");
+  fprintf(f, "RNG_ENGINE [MT|XOSHIRO]    - Select the RNG's engine and reseed it, or print the engine\n");
+  fprintf(f, "RNG_SUBSTREAM i            - Replace the RNG with its substream i\n");
+  fprintf(f, "RNG_JUMP                   - Jump the RNG ahead 2^128 numbers (xoshiro only)\n");
+  fprintf(f, "RNG_SAVE                   - Save the RNG's engine state\n");
+  fprintf(f, "RNG_RESTORE                - Restore the RNG's engine state from RNG_SAVE\n");
+  fprintf(f, "RANDOM [n]                 - Print n (default 1) random doubles from the RNG\n");
+  fprintf(f, "RANDOM_NODES [k]           - Print a random node, or k distinct random nodes (sorted)\n");
+  fprintf(f, "RANDOM_EDGES [k]           - Print a random edge, or k distinct random edges (sorted)\n");
   fprintf(f, "SPROPERTIES/SP json        - Set the network's property pack\n");
   fprintf(f, "SET_ASSOC key json         - Set the key/val in the network's associated data.\n");
   fprintf(f, "SORT/SORTED [Q]            - Sort the network and print the sorted node id's. Q = no output\n");
+  fprintf(f, "COLUMNS [ON|OFF]           - Turn the column store on or off, or print whether it's on\n");
  
   fprintf(f, "\nHelper Commands\n");
   fprintf(f, "RUN                        - Run the app.\n");
@@ -141,7 +161,7 @@ string get_node_name(Node *n)
 
 int main(int argc, char **argv)
 {
-  Network *n, *n2;
+  Network *n, *n2, *tmp_net;
   Edge *e;
   Node *node;
   PropertyPack pp;
@@ -151,6 +171,7 @@ int main(int argc, char **argv)
 
   istringstream ss;
   ofstream fout;
+  ifstream fin;
   vector <string> sv;
   vector <string> keys;
   vector <double> dv;
@@ -159,6 +180,9 @@ int main(int argc, char **argv)
   string s, l, app_name, proc_name;
   string prompt, cmd;
   json j1;
+  NetworkPatch patch;
+  vector <uint32_t> batch_ids;
+  vector < pair <uint32_t, uint32_t> > batch_edges;
   int lowest_free_id;
   uint32_t seed;
 
@@ -167,6 +191,9 @@ int main(int argc, char **argv)
   size_t i,size;
 
   MOA rng;
+  vector <uint8_t> rng_state;
+  vector <Node *> random_nodes;
+  vector <Edge *> random_edges;
 
   d = 0;
 
@@ -212,23 +239,44 @@ int main(int argc, char **argv)
     /* To / From Json. */
 
     } else if (sv[0] == "FJ") {
-      if (!read_json(sv, 1, j1)) {
-        printf("Bad json.\n");
-      } else {
-        try {
-          node_names.clear();
-          lowest_free_id = 0;
 
-          n->from_json(j1);
+      /* This reads the JSON with from_json_stream(), so that big networks are never
+         held as a json object.  It reads into a new network, so that bad JSON leaves
+         the old one alone. */
 
-          for (nit = n->begin(); nit != n->end(); nit++) {
-            node = nit->second.get();
-            node_names[std::to_string(node->id)] = node->id;
+      tmp_net = new Network;
+      try {
+        if (size > 1) {
+          fin.clear();
+          fin.open(sv[1].c_str());
+          if (fin.fail()) {
+            perror(sv[1].c_str());
+            throw SRE("");
           }
+          tmp_net->from_json_stream(fin);
+          fin.close();
+        } else {
+          tmp_net->from_json_stream(cin);
+          getline(cin, s);
+        }
 
-        } catch (SRE &e) {
-          printf("%s\n", e.what());
+        delete n;
+        n = tmp_net;
+        tmp_net = NULL;
+        node_names.clear();
+        lowest_free_id = 0;
+        for (nit = n->begin(); nit != n->end(); nit++) {
+          node = nit->second.get();
+          node_names[std::to_string(node->id)] = node->id;
         }
+
+      } catch (SRE &e) {
+        if (fin.is_open()) fin.close();
+        delete tmp_net;
+        printf("Bad json.\n");
+        s = e.what();
+        while (s.size() > 0 && s[s.size()-1] == '\n') s.resize(s.size()-1);
+        if (s != "") printf("%s\n", s.c_str());
       }
     } else if (sv[0] == "SEED") {
       if (sv.size() != 2 || sscanf(sv[1].c_str(), "%u", &seed) != 1) {
@@ -237,6 +285,81 @@ int main(int argc, char **argv)
         rng.Seed(seed, "network_tool");
       }
 
+    } else if (sv[0] == "RNG_ENGINE") {
+      if (size == 1) {
+        printf("%s\n", (rng.Get_Engine() == MOA::XOSHIRO256SS) ? "XOSHIRO" : "MT");
+      } else if (size == 2 && (sv[1] == "MT" || sv[1] == "mt")) {
+        rng.Set_Engine(MOA::MT19937);
+      } else if (size == 2 && (sv[1] == "XOSHIRO" || sv[1] == "xoshiro")) {
+        rng.Set_Engine(MOA::XOSHIRO256SS);
+      } else {
+        printf("usage: RNG_ENGINE [MT|XOSHIRO]\n");
+      }
+
+    } else if (sv[0] == "RNG_SUBSTREAM") {
+      if (sv.size() != 2 || !is_number(sv[1])) {
+        printf("usage: RNG_SUBSTREAM i\n");
+      } else {
+        rng = rng.Substream(std::stoull(sv[1]));
+      }
+
+    } else if (sv[0] == "RNG_JUMP") {
+      try {
+        rng.Jump();
+      } catch (const std::runtime_error &e) {
+        printf("%s\n", e.what());
+      }
+
+    } else if (sv[0] == "RNG_SAVE") {
+      rng.Get_Engine_State(rng_state);
+
+    } else if (sv[0] == "RNG_RESTORE") {
+      if (rng_state.empty()) {
+        printf("RNG_RESTORE - no state saved (use RNG_SAVE)\n");
+      } else {
+        rng.Set_Engine_State(rng_state);
+      }
+
+    } else if (sv[0] == "RANDOM") {
+      if (size > 2 || (size == 2 && !is_number(sv[1]))) {
+        printf("usage: RANDOM [n]\n");
+      } else {
+        for (i = (size == 2) ? std::stoul(sv[1]) : 1; i > 0; i--) printf("%.17g\n", rng.Random_Double());
+      }
+
+    } else if (sv[0] == "RANDOM_NODES" || sv[0] == "RANDOM_EDGES") {
+      if (size > 2 || (size == 2 && !is_number(sv[1]))) {
+        printf("usage: %s [k]\n", sv[0].c_str());
+      } else {
+        try {
+          keys.clear();
+          if (sv[0] == "RANDOM_NODES") {
+            if (size == 1) {
+              random_nodes.assign(1, n->get_random_node(rng));
+            } else {
+              random_nodes = n->get_random_nodes(rng, std::stoul(sv[1]));
+            }
+            for (i = 0; i < random_nodes.size(); i++) {
+              keys.push_back(get_node_name(random_nodes[i]));
+            }
+          } else {
+            if (size == 1) {
+              random_edges.assign(1, n->get_random_edge(rng));
+            } else {
+              random_edges = n->get_random_edges(rng, std::stoul(sv[1]));
+            }
+            for (i = 0; i < random_edges.size(); i++) {
+              keys.push_back(get_node_name(random_edges[i]->from) + " -> " +
+                             get_node_name(random_edges[i]->to));
+            }
+          }
+          sort(keys.begin(), keys.end());
+          for (i = 0; i < keys.size(); i++) printf("%s\n", keys[i].c_str());
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      }
+
     } else if (sv[0] == "SHOW_SEED") {
       printf("%u\n", seed);
 
@@ -251,15 +374,50 @@ int main(int argc, char **argv)
           fout.clear();
           fout.open(sv[1].c_str());
           if (fout.fail()) throw SRE((string) "Couldn't open " + sv[1]);
-          fout << n->pretty_json() << endl;
+          n->write_json(fout, true);
+          fout << endl;
           fout.close();
         } else {
-          cout << n->pretty_json() << endl;
+          n->write_json(cout, true);
+          cout << endl;
+        }
+      } catch (SRE &e) {
+        printf("%s\n", e.what());
+      }
+
+    /* To / From the binary format. */
+
+    } else if (sv[0] == "FB") {
+      try {
+        if (size != 2) throw SRE("usage: FB file");
+        tmp_net = new Network;
+        try {
+          tmp_net->read_binary(sv[1]);
+        } catch (SRE &e) {
+          delete tmp_net;
+          throw;
+        }
+
+        delete n;
+        n = tmp_net;
+        node_names.clear();
+        lowest_free_id = 0;
+        for (nit = n->begin(); nit != n->end(); nit++) {
+          node = nit->second.get();
+          node_names[std::to_string(node->id)] = node->id;
         }
       } catch (SRE &e) {
         printf("%s\n", e.what());
       }
 
+    } else if (sv[0] == "TB") {
+      try {
+        if (size != 2) throw SRE("usage: TB file");
+        n->write_binary(sv[1]);
+      } catch (SRE &e) {
+        printf("%s\n", e.what());
+      }
+
     } else if (sv[0] == "PRUNE") {
       try {
         if (size != 1) throw SRE("usage: PRUNE");
@@ -279,12 +437,76 @@ int main(int argc, char **argv)
         printf("%s\n", e.what());
       }
 
+    } else if (sv[0] == "RANDOMIZE") {
+      if (!read_json(sv, 1, j1)) {
+        printf("RANDOMIZE: Bad json.\n");
+      } else {
+        try {
+          n->randomize(j1, rng);
+          node_names.clear();
+          lowest_free_id = 0;
+          for (nit = n->begin(); nit != n->end(); nit++) {
+            node = nit->second.get();
+            node_names[std::to_string(node->id)] = node->id;
+          }
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      }
+
     } else if (sv[0] == "COPY_FROM") {
       *n2 = *n;
       j1 = json::object();
       n2->to_json(j1);
       cout << j1.dump(2) << endl;
 
+    } else if (sv[0] == "SWAP") {
+      tmp_net = n;
+      n = n2;
+      n2 = tmp_net;
+      node_names.clear();
+      lowest_free_id = 0;
+      for (nit = n->begin(); nit != n->end(); nit++) {
+        node = nit->second.get();
+        node_names[std::to_string(node->id)] = node->id;
+      }
+
+    } else if (sv[0] == "DIFF") {
+      if (!read_json(sv, 1, j1)) {
+        printf("DIFF: Bad json.\n");
+      } else {
+        try {
+          n2->from_json(j1);
+          cout << n->diff(*n2).as_json().dump(2) << endl;
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      }
+
+    } else if (sv[0] == "PATCH") {
+      if (!read_json(sv, 1, j1)) {
+        printf("PATCH: Bad json.\n");
+      } else {
+        try {
+          patch.from_json(j1);
+          n->apply_patch(patch);
+
+          /* Like PRUNE, clear removed nodes out of the name map, and then add the new ones. */
+
+          tmp_map.clear();
+          for (it = node_names.begin(); it != node_names.end(); ++it) {
+            if (n->is_node(it->second)) tmp_map[it->first] = it->second;
+          }
+          node_names = tmp_map;
+          for (i = 0; i < patch.added_nodes.size(); i++) {
+            node_names[std::to_string(patch.added_nodes[i].id)] = patch.added_nodes[i].id;
+          }
+          lowest_free_id = 0;
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      }
+
     } else if (sv[0] == "DESTROY") {
       delete n;
       n = new Network;
@@ -302,7 +524,7 @@ int main(int argc, char **argv)
             if (id == -1) throw SRE(sv[i] + " is not a valid node");
             node = n->get_node(id);
             j1 = { {"id", node->id}, 
-                   {"values", node->values} };
+                   {"values", node->get_values()} };
             if (node->coordinates.size() != 0) j1["coords"] = j1["coords"] = node->coordinates;
             cout << j1.dump() << endl;
           } catch (SRE &e) {
@@ -348,6 +570,21 @@ int main(int argc, char **argv)
         printf("\n");
       }
 
+    } else if (sv[0] == "COLUMNS") {
+      if (size == 1) {
+        printf("%s\n", (n->columns_enabled()) ? "ON" : "OFF");
+      } else if (size == 2 && (sv[1] == "ON" || sv[1] == "on")) {
+        try {
+          n->enable_columns();
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      } else if (size == 2 && (sv[1] == "OFF" || sv[1] == "off")) {
+        n->disable_columns();
+      } else {
+        printf("usage: COLUMNS [ON|OFF]\n");
+      }
+
     } else if (sv[0] == "PROPERTIES" || sv[0] == "P") {
       cout << n->get_properties().pretty_json() << endl;
 
@@ -363,6 +600,20 @@ int main(int argc, char **argv)
         }
       }
 
+    } else if (sv[0] == "HASH") {
+      printf("%s\n", n->hash().as_string().c_str());
+
+    } else if (sv[0] == "ANALYZE") {
+      if (sv.size() > 2) {
+        printf("usage: ANALYZE [delay_property]\n");
+      } else {
+        try {
+          cout << n->analyze((sv.size() == 2) ? sv[1] : "Delay").as_json().dump() << endl;
+        } catch (SRE &e) {
+          printf("%s\n", e.what());
+        }
+      }
+
     } else if (sv[0] == "INFO") {
 
       printf("Nodes:   %8d\n", (int) n->num_nodes());
@@ -484,9 +735,13 @@ int main(int argc, char **argv)
 
       } else {
         prop = n->get_edge_property(sv[size-2]);
-        for (eit = n->edges_begin(); eit != n->edges_end(); eit++) {
-          e = eit->second.get();
-          e->set(prop->index, d);
+        if (n->columns_enabled()) {
+          std::fill(n->edge_column(prop->index), n->edge_column(prop->index) + n->num_edges(), d);
+        } else {
+          for (eit = n->edges_begin(); eit != n->edges_end(); eit++) {
+            e = eit->second.get();
+            e->set(prop->index, d);
+          }
         }
       }
 
@@ -528,9 +783,13 @@ int main(int argc, char **argv)
 
       } else {
         prop = n->get_node_property(sv[size-2]);
-        for (nit = n->begin(); nit != n->end(); nit++) {
-          node = nit->second.get();
-          node->set(prop->index, d);
+        if (n->columns_enabled()) {
+          std::fill(n->node_column(prop->index), n->node_column(prop->index) + n->num_nodes(), d);
+        } else {
+          for (nit = n->begin(); nit != n->end(); nit++) {
+            node = nit->second.get();
+            node->set(prop->index, d);
+          }
         }
       }
 
@@ -567,6 +826,45 @@ int main(int argc, char **argv)
          
       }
       
+    } else if (sv[0] == "AN_BATCH") { // add_nodes()
+      if (size < 2) {
+        printf("usage: AN_BATCH node_id1 node_id2 ...\n");
+      } else {
+        try {
+          batch_ids.clear();
+          for (i = 1; i < size; i++) {
+            if (!is_number(sv[i])) throw SRE((string) "AN_BATCH - " + sv[i] + " is not a node id");
+            batch_ids.push_back(stoi(sv[i]));
+          }
+          n->add_nodes(batch_ids);
+          for (i = 1; i < size; i++) node_names[sv[i]] = batch_ids[i-1];
+        } catch (SRE &e) {
+          printf("%s\n",e.what());
+        }
+      }
+
+    } else if (sv[0] == "AE_BATCH") { // add_edges()
+      if ((size - 1) % 2 != 0 || size < 3) {
+        printf("usage: AE_BATCH from1 to1 from2 to2 ...\n");
+      } else {
+        try {
+          batch_edges.clear();
+          for (i = 1; i < size; i += 2) {
+            from = get_node_id_by_name(sv[i], node_names);
+            to = get_node_id_by_name(sv[i+1], node_names);
+            if (from == -1 && is_number(sv[i])) from = stoi(sv[i]);
+            if (to == -1 && is_number(sv[i+1])) to = stoi(sv[i+1]);
+            if (from == -1 || to == -1) {
+              throw SRE(sv[i] + " -> " + sv[i+1] + " is not a valid edge");
+            }
+            batch_edges.push_back(make_pair((uint32_t) from, (uint32_t) to));
+          }
+          n->add_edges(batch_edges);
+        } catch (SRE &e) {
+          printf("%s\n",e.what());
+        }
+      }
+
     } else if (sv[0] == "AI") { // add_input()
       if (size < 2) {
         printf("usage: AI node_id1 node_id2 ...\n");
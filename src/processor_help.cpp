@@ -6,6 +6,8 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
 typedef std::runtime_error SRE;
 
@@ -252,7 +254,7 @@ Network *pull_network(Processor *p, Network *n, int network_id)
   nn = new Network(*n);
   for (i = 0; i < pres.size(); i++) {
     e = nn->get_edge(pres[i], posts[i]);
-    e->values[prop->index] = vals[i];
+    e->set(prop->index, vals[i]);
   }
   return nn;
 }
@@ -285,6 +287,84 @@ json run_and_track(int duration, Processor *p, int network_id)
   return rv;
 }
 
+/* Percentiles use the nearest-rank method on the sorted times. */
+
+static double percentile(const vector <double> &sorted, double pct)
+{
+  size_t rank;
+
+  if (sorted.size() == 0) return 0;
+  rank = (size_t) ceil(pct / 100.0 * sorted.size());
+  if (rank < 1) rank = 1;
+  return sorted[rank-1];
+}
+
+json run_realtime(int duration, double timestep_period, Processor *p, int network_id)
+{
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration <double> Seconds;
+
+  int i, misses;
+  json rv;
+  Clock::time_point start, scheduled, deadline, before, after;
+  vector <double> compute, late;
+  double sum, sumsq, mean;
+
+  if (duration < 0) throw SRE("run_realtime() - duration must be >= 0");
+  if (timestep_period <= 0) throw SRE("run_realtime() - timestep_period must be > 0");
+
+  compute.resize(duration);
+  late.resize(duration);
+  misses = 0;
+
+  start = Clock::now();
+  for (i = 0; i < duration; i++) {
+    scheduled = start + std::chrono::duration_cast <Clock::duration>(Seconds(i * timestep_period));
+    std::this_thread::sleep_until(scheduled);
+    before = Clock::now();
+    p->run(1, network_id);
+    after = Clock::now();
+
+    compute[i] = Seconds(after - before).count();
+    late[i] = Seconds(before - scheduled).count();
+
+    /* A call that starts late can miss its deadline without taking a whole period. */
+
+    deadline = start + std::chrono::duration_cast <Clock::duration>(Seconds((i+1) * timestep_period));
+    if (after > deadline) misses++;
+  }
+
+  rv["timesteps"] = duration;
+  rv["timestep_period"] = timestep_period;
+  rv["deadline_misses"] = misses;
+  rv["wall_time"] = Seconds(Clock::now() - start).count();
+
+  /* Jitter is from the start times, so it has to be computed before the sort. */
+
+  sum = 0;
+  sumsq = 0;
+  for (i = 0; i < duration; i++) {
+    sum += late[i];
+    sumsq += late[i] * late[i];
+  }
+  mean = (duration == 0) ? 0 : sum / duration;
+  rv["jitter"]["mean"] = mean;
+  rv["jitter"]["stddev"] = (duration == 0) ? 0 : sqrt(std::max(0.0, sumsq / duration - mean * mean));
+  rv["jitter"]["max"] = (duration == 0) ? 0 : *std::max_element(late.begin(), late.end());
+
+  sort(compute.begin(), compute.end());
+  sum = 0;
+  for (i = 0; i < duration; i++) sum += compute[i];
+  rv["compute_time"]["min"] = (duration == 0) ? 0 : compute[0];
+  rv["compute_time"]["mean"] = (duration == 0) ? 0 : sum / duration;
+  rv["compute_time"]["p50"] = percentile(compute, 50);
+  rv["compute_time"]["p90"] = percentile(compute, 90);
+  rv["compute_time"]["p99"] = percentile(compute, 99);
+  rv["compute_time"]["max"] = (duration == 0) ? 0 : compute[duration-1];
+
+  return rv;
+}
+
 void apply_spike_raster(Processor *p, int in_neuron, const vector <char> &sr, int network_id)
 {
   size_t i;
@@ -298,5 +378,262 @@ void apply_spike_raster(Processor *p, int in_neuron, const vector <char> &sr, in
   }
 }
 
+/* SpikeBatch and BatchResult */
+
+void SpikeBatch::add_sample()
+{
+  starts.push_back(ids.size());
+}
+
+void SpikeBatch::add_sample(const vector <Spike> &s)
+{
+  size_t i;
+
+  starts.push_back(ids.size());
+  reserve(ids.size() + s.size());
+  for (i = 0; i < s.size(); i++) add_spike(s[i]);
+}
+
+void SpikeBatch::add_sample(const int32_t *_ids, const int32_t *_times, const double *_values,
+                            size_t n)
+{
+  starts.push_back(ids.size());
+  ids.insert(ids.end(), _ids, _ids + n);
+  times.insert(times.end(), _times, _times + n);
+  values.insert(values.end(), _values, _values + n);
+}
+
+void SpikeBatch::add_spike(int32_t id, int32_t time, double value)
+{
+  if (starts.empty()) starts.push_back(0);
+  ids.push_back(id);
+  times.push_back(time);
+  values.push_back(value);
+}
+
+void SpikeBatch::add_spike(const Spike &s)
+{
+  add_spike(s.id, (int32_t) s.time, s.value);
+}
+
+void SpikeBatch::reserve(size_t spikes)
+{
+  ids.reserve(spikes);
+  times.reserve(spikes);
+  values.reserve(spikes);
+}
+
+size_t SpikeBatch::num_spikes() const
+{
+  return ids.size();
+}
+
+size_t SpikeBatch::num_samples() const
+{
+  return starts.size();
+}
+
+size_t SpikeBatch::sample_begin(size_t i) const
+{
+  return starts[i];
+}
+
+size_t SpikeBatch::sample_end(size_t i) const
+{
+  return (i + 1 < starts.size()) ? starts[i+1] : ids.size();
+}
+
+void SpikeBatch::clear()
+{
+  ids.clear();
+  times.clear();
+  values.clear();
+  starts.clear();
+}
+
+void BatchResult::resize(size_t samples, size_t outputs)
+{
+  num_samples = samples;
+  num_outputs = outputs;
+  counts.resize(samples * outputs);
+  last_fires.resize(samples * outputs);
+}
+
+int BatchResult::count(size_t sample, size_t output) const
+{
+  return counts[sample * num_outputs + output];
+}
+
+double BatchResult::last_fire(size_t sample, size_t output) const
+{
+  return last_fires[sample * num_outputs + output];
+}
+
+/* Default implementations of the optional Processor methods.  Processors that
+   support these features override them. */
+
+void Processor::set_synapse_weights(const vector <uint32_t> &pres,
+                                    const vector <uint32_t> &posts,
+                                    const vector <double> &vals,
+                                    int network_id)
+{
+  (void) pres;
+  (void) posts;
+  (void) vals;
+  (void) network_id;
+  throw SRE(get_name() + ": set_synapse_weights() is not supported by this processor.");
+}
+
+void Processor::set_neuron_thresholds(const vector <uint32_t> &ids,
+                                      const vector <double> &vals,
+                                      int network_id)
+{
+  (void) ids;
+  (void) vals;
+  (void) network_id;
+  throw SRE(get_name() + ": set_neuron_thresholds() is not supported by this processor.");
+}
+
+bool Processor::apply_network_patch(const NetworkPatch &patch, int network_id)
+{
+  (void) patch;
+  (void) network_id;
+  return false;
+}
+
+void Processor::apply_spikes(const SpikeBatch &batch, int network_id)
+{
+  size_t i;
+
+  for (i = 0; i < batch.num_spikes(); i++) {
+    apply_spike(Spike(batch.ids[i], batch.times[i], batch.values[i]), batch.normalized, network_id);
+  }
+}
+
+BatchResult Processor::run_batch(const SpikeBatch &batch, double duration, int network_id)
+{
+  BatchResult rv;
+  vector <Spike> s;
+  vector <int> counts;
+  vector <double> last_fires;
+  size_t i, j;
+
+  for (i = 0; i < batch.num_samples(); i++) {
+    clear_activity(network_id);
+    s.clear();
+    for (j = batch.sample_begin(i); j < batch.sample_end(i); j++) {
+      s.push_back(Spike(batch.ids[j], batch.times[j], batch.values[j]));
+    }
+    apply_spikes(s, batch.normalized, network_id);
+    run(duration, network_id);
+    counts = output_counts(network_id);
+    last_fires = output_last_fires(network_id);
+    if (i == 0) rv.resize(batch.num_samples(), counts.size());
+    if (counts.size() != rv.num_outputs || last_fires.size() != rv.num_outputs) {
+      throw SRE(get_name() + ": run_batch() - output_counts() and output_last_fires() disagree on the number of outputs.");
+    }
+    std::copy(counts.begin(), counts.end(), rv.counts.begin() + i * rv.num_outputs);
+    std::copy(last_fires.begin(), last_fires.end(), rv.last_fires.begin() + i * rv.num_outputs);
+  }
+  return rv;
+}
+
+/* The buffer versions of the output and neuron methods. */
+
+template <class T> static size_t copy_to_buffer(const vector <T> &v, T *buf, size_t n,
+                                                const string &who)
+{
+  char b[100];
+
+  if (v.size() > n) {
+    snprintf(b, 100, "() - the buffer has %lu entries, but %lu are needed.",
+             (unsigned long) n, (unsigned long) v.size());
+    throw SRE(who + b);
+  }
+  std::copy(v.begin(), v.end(), buf);
+  return v.size();
+}
+
+size_t Processor::output_last_fires(double *buf, size_t n, int network_id)
+{
+  return copy_to_buffer(output_last_fires(network_id), buf, n, get_name() + ": output_last_fires");
+}
+
+size_t Processor::output_counts(int *buf, size_t n, int network_id)
+{
+  return copy_to_buffer(output_counts(network_id), buf, n, get_name() + ": output_counts");
+}
+
+size_t Processor::output_vectors(double *times, size_t n, size_t *counts, size_t num_counts,
+                                 int network_id)
+{
+  vector < vector <double> > ov;
+  vector <size_t> c;
+  vector <double> t;
+  size_t i;
+
+  ov = output_vectors(network_id);
+  for (i = 0; i < ov.size(); i++) {
+    c.push_back(ov[i].size());
+    t.insert(t.end(), ov[i].begin(), ov[i].end());
+  }
+  copy_to_buffer(c, counts, num_counts, get_name() + ": output_vectors");
+  return copy_to_buffer(t, times, n, get_name() + ": output_vectors");
+}
+
+size_t Processor::neuron_counts(int *buf, size_t n, int network_id)
+{
+  return copy_to_buffer(neuron_counts(network_id), buf, n, get_name() + ": neuron_counts");
+}
+
+size_t Processor::neuron_last_fires(double *buf, size_t n, int network_id)
+{
+  return copy_to_buffer(neuron_last_fires(network_id), buf, n, get_name() + ": neuron_last_fires");
+}
+
+size_t Processor::neuron_charges(double *buf, size_t n, int network_id)
+{
+  return copy_to_buffer(neuron_charges(network_id), buf, n, get_name() + ": neuron_charges");
+}
+
+void Processor::clone_network(int src_network_id, int dst_network_id)
+{
+  (void) src_network_id;
+  (void) dst_network_id;
+  throw SRE(get_name() + ": clone_network() is not supported by this processor.");
+}
+
+vector <uint8_t> Processor::save_state(int network_id)
+{
+  (void) network_id;
+  throw SRE(get_name() + ": save_state() is not supported by this processor.");
+}
+
+void Processor::restore_state(const vector <uint8_t> &state, int network_id)
+{
+  (void) state;
+  (void) network_id;
+  throw SRE(get_name() + ": restore_state() is not supported by this processor.");
+}
+
+void Processor::open_spike_streams(size_t capacity, int network_id)
+{
+  (void) capacity;
+  (void) network_id;
+  throw SRE(get_name() + ": open_spike_streams() is not supported by this processor.");
+}
+
+SpikeStream *Processor::input_stream(int network_id)
+{
+  (void) network_id;
+  throw SRE(get_name() + ": input_stream() is not supported by this processor.");
+}
+
+SpikeStream *Processor::output_stream(int network_id)
+{
+  (void) network_id;
+  throw SRE(get_name() + ": output_stream() is not supported by this processor.");
+}
+
 /* End of namespace */
 }
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <map>
 #include <unordered_set>
 #include <unistd.h>
@@ -57,8 +59,17 @@ void print_commands(FILE *f)
   fprintf(f, "ASV node_id spike_time spike_val .. - Apply unnormalized spikes to the network (note: node_id, not input_id)\n");
   fprintf(f, "ASR node_id spike_raster_string     - Apply spike raster to the network (note: node_id, not input_id)\n");
   fprintf(f, "RUN simulation_time                 - Run the network for \"simulation_time\" cycles\n");
+  fprintf(f, "OPEN_STREAMS capacity               - Open the streaming spike ports (0 closes them)\n");
+  fprintf(f, "SI node_id delay spike_val ...      - Push normalized spikes onto the input stream (note: node_id)\n");
+  fprintf(f, "SO                                  - Pop and print the output fires, and any dropped input spikes\n");
   fprintf(f, "RSC/RUN_SR_CH sim_time [node] [...] - Run, and then print spike raster and charge information in columns\n");
+  fprintf(f, "RRT/RUN_REALTIME sim_time period    - Run one timestep every period seconds, and print timing statistics\n");
+  fprintf(f, "RB/RUN_BATCH sim_time spikes | ...  - Run each sample of spikes (node_id time val ...) from cleared state\n");
   fprintf(f, "CLEAR-A/CA                          - Clear the network's internal state \n");
+  fprintf(f, "SAVE_STATE [file]                   - Snapshot the network's internal state (in memory or to a file)\n");
+  fprintf(f, "RESTORE_STATE [file]                - Restore the snapshot from SAVE_STATE\n");
+  fprintf(f, "CLONE src dst                       - Copy network id src, with its state, to network id dst\n");
+  fprintf(f, "NET [network_id]                    - Use network_id for the other commands (empty=print it)\n");
   fprintf(f, "CLEAR/C                             - Remove the network from processor\n");
   
 
@@ -83,10 +94,15 @@ void print_commands(FILE *f)
   fprintf(f, "NCJ                                 - Print the neuron count json\n");
   fprintf(f, "NVJ type(V/S)                       - Print the neuron vector json\n");
   fprintf(f, "NCHJ                                - Print the neuron charge json\n");
+  fprintf(f, "BUFFERS                             - Compare the buffer versions of the output/neuron calls with the vector ones\n");
 
   fprintf(f, "TRACK_N [node_id] [...]             - Track neuron events for specified neurons (empty=all)\n");
   fprintf(f, "UNTRACK_N [node_id] [...]           - Untrack neuron events for specified neurons (empty=all)\n");
   fprintf(f, "SW [from to]                        - Show synapse weights (or just one synapse).\n");
+  fprintf(f, "SSW from to weight ...              - Set synapse weights on the processor (not the network).\n");
+  fprintf(f, "SNT node_id threshold ...           - Set neuron thresholds on the processor (not the network).\n");
+  fprintf(f, "PATCH network_json                  - Change the loaded network to this one, in place if possible.\n");
+  fprintf(f, "APPLY_PATCH patch_json              - Apply a patch (from network_tool's DIFF) to the loaded network.\n");
   fprintf(f, "PULL_NETWORK file                   - Pull the network off the processor and store in  file.\n");
   fprintf(f, "\n");
 
@@ -122,6 +138,18 @@ int max_node_name_len(Network *net)
  
 }
 
+/* For BUFFERS: print whether the first n entries of buf are the same as v. */
+
+template <class T> void print_buffer_check(const string &name, const vector <T> &v,
+                                           const vector <T> &buf, size_t n)
+{
+  bool same;
+
+  same = (n == v.size() && std::equal(v.begin(), v.end(), buf.begin()));
+  printf("%-18s %s (%lu entries)\n", (name + ":").c_str(), (same) ? "same" : "DIFFERENT",
+         (unsigned long) n);
+}
+
 void to_uppercase(string &s) 
 {
   size_t i;
@@ -264,7 +292,7 @@ void safe_exit(Processor *p, Network *n)
 int main(int argc, char **argv) 
 {
   Processor *p;
-  Network *net, *pulled; 
+  Network *net, *pulled, *new_net; 
   NodeMap::iterator nit;
   Node *node, *n;
   char buf[50];
@@ -274,6 +302,7 @@ int main(int argc, char **argv)
   string l,s;
 
   ofstream fout;
+  ifstream fin;
 
   istringstream ss;
  
@@ -281,6 +310,7 @@ int main(int argc, char **argv)
   int k;
   int node_id, output_id, spike_id, from, to;
   int max_name_len;
+  int net_id;                                  // The network_id for the processor calls
   double spike_time, spike_val;
   double sim_time;
   double val;
@@ -302,11 +332,20 @@ int main(int argc, char **argv)
   vector <double> charges;
   vector <double> data;
   vector <char> sr;
+  vector <uint8_t> saved_state;
+  vector <int> int_buf;                       // For BUFFERS
+  vector <double> double_buf;
+  vector <size_t> size_buf, counts_buf;
+  StreamSpike stream_spike;
+  NetworkPatch patch;
+  SpikeBatch batch;
+  BatchResult batch_result;
   map <int, double>::iterator mit;
   map <int, string> aliases; // Aliases for input/output nodes.
   map <int, string>::iterator ait;
   bool gsr_hidden_nodes;
   bool normalized;
+  bool applied;
   unordered_set <int> gsr_nodes;
   
   json proc_params, network_json;
@@ -329,6 +368,7 @@ int main(int argc, char **argv)
   p = nullptr;
   net = nullptr;
   max_name_len = 0;
+  net_id = 0;
 
   while(1) {
     try {
@@ -363,6 +403,7 @@ int main(int argc, char **argv)
   
             net = load_network(&p, network_json);
             max_name_len = max_node_name_len(net);
+            net_id = 0;
   
           } catch (const SRE &e) {
             printf("%s\n",e.what());
@@ -395,6 +436,7 @@ int main(int argc, char **argv)
           } else {
             try {
               p = Processor::make(proc_name, proc_params);
+              net_id = 0;
   
             } catch (const SRE &e) {
               printf("%s\n",e.what());
@@ -416,6 +458,7 @@ int main(int argc, char **argv)
           try {
             net = load_network(&p, network_json);
             max_name_len = max_node_name_len(net);
+            net_id = 0;
 
           } catch (const SRE &e) {
             printf("%s\n",e.what());
@@ -446,7 +489,7 @@ int main(int argc, char **argv)
                 } 
                 spike_validation(Spike(spike_id, spike_time, spike_val), net, normalized);
                 
-                p->apply_spike(Spike(net->get_node(spike_id)->input_id, spike_time, spike_val), normalized);
+                p->apply_spike(Spike(net->get_node(spike_id)->input_id, spike_time, spike_val), normalized, net_id);
                 spikes_array.push_back(Spike(spike_id, spike_time, spike_val));
   
               } catch (const SRE &e) {
@@ -475,7 +518,7 @@ int main(int argc, char **argv)
                 throw SRE((string) "Bad neuron id: " + sv[1]);
               }
               spike_validation(Spike(spike_id, 0, 0), net, true);
-              apply_spike_raster(p, net->get_node(spike_id)->input_id, sr);
+              apply_spike_raster(p, net->get_node(spike_id)->input_id, sr, net_id);
   
             } catch (const SRE &e) {
               printf("%s\n",e.what());
@@ -495,12 +538,122 @@ int main(int argc, char **argv)
             printf("usage: RUN sim_time. sim_time >= 0\n");
           } else {
             
-            p->run(sim_time);
+            p->run(sim_time, net_id);
             spikes_array.clear();
             
           }
         }
   
+      } else if (sv[0] == "RUN_REALTIME" || sv[0] == "RRT") { // run_realtime()
+
+        if (network_processor_validation(net, p)) {
+          if (sv.size() != 3 || sscanf(sv[1].c_str(), "%lf", &sim_time) != 1 || sim_time < 0 ||
+              sscanf(sv[2].c_str(), "%lf", &val) != 1 || val <= 0) {
+            printf("usage: RUN_REALTIME sim_time period. sim_time >= 0, period (seconds) > 0\n");
+          } else {
+            j1 = run_realtime(sim_time, val, p, net_id);
+            spikes_array.clear();
+            printf("%s\n", j1.dump(2).c_str());
+          }
+        }
+
+      } else if (sv[0] == "RUN_BATCH" || sv[0] == "RB") { // run_batch()
+
+        if (network_processor_validation(net, p)) {
+          if (sv.size() < 2 || sscanf(sv[1].c_str(), "%lf", &sim_time) != 1 || sim_time < 0) {
+            printf("usage: RUN_BATCH/RB sim_time node_id spike_time spike_val ... [| node_id ...]. sim_time >= 0\n");
+          } else {
+            try {
+              batch.clear();
+              batch.add_sample();
+              i = 2;
+              while (i < sv.size()) {
+                if (sv[i] == "|") {
+                  batch.add_sample();
+                  i++;
+                } else {
+                  if (i + 3 > sv.size() ||
+                      sscanf(sv[i].c_str(), "%d", &spike_id) != 1 ||
+                      sscanf(sv[i+1].c_str(), "%lf", &spike_time) != 1 ||
+                      sscanf(sv[i+2].c_str(), "%lf", &spike_val) != 1) {
+                    throw SRE((string) "RUN_BATCH - bad spike starting with " + sv[i]);
+                  }
+                  spike_validation(Spike(spike_id, spike_time, spike_val), net, true);
+                  batch.add_spike(Spike(net->get_node(spike_id)->input_id, spike_time, spike_val));
+                  i += 3;
+                }
+              }
+              batch_result = p->run_batch(batch, sim_time, net_id);
+              spikes_array.clear();
+              for (i = 0; i < batch_result.num_samples; i++) {
+                for (j = 0; j < batch_result.num_outputs; j++) {
+                  node = net->get_output(j);
+                  printf("sample %d node %s spike counts: %d last fire time: %.1lf\n", (int) i,
+                         node_name(node).c_str(), batch_result.count(i, j),
+                         batch_result.last_fire(i, j));
+                }
+              }
+            } catch (const SRE &e) {
+              printf("%s\n",e.what());
+            }
+          }
+        }
+
+      } else if (sv[0] == "OPEN_STREAMS") { // open_spike_streams()
+
+        if (network_processor_validation(net, p)) {
+          if (sv.size() != 2 || sscanf(sv[1].c_str(), "%d", &node_id) != 1 || node_id < 0) {
+            printf("usage: OPEN_STREAMS capacity. capacity >= 0\n");
+          } else {
+            p->open_spike_streams(node_id, net_id);
+          }
+        }
+
+      } else if (sv[0] == "SI") { // push onto input_stream()
+
+        if (network_processor_validation(net, p)) {
+          if (sv.size() < 2 || (sv.size() - 1) % 3 != 0) {
+            printf("usage: SI node_id delay spike_val node_id1 delay1 spike_val1 ...\n");
+          } else if (p->input_stream(net_id) == NULL) {
+            printf("SI - the streams aren't open (use OPEN_STREAMS)\n");
+          } else {
+            for (i = 0; i < (sv.size() - 1) / 3; i++) {
+              try {
+                if (sscanf(sv[i*3 + 1].c_str(), "%d", &spike_id) != 1 ||
+                    sscanf(sv[i*3 + 2].c_str(), "%lf", &spike_time) != 1 || spike_time < 0 ||
+                    sscanf(sv[i*3 + 3].c_str(), "%lf", &spike_val) != 1 ) {
+                  throw SRE((string) "Invalid spike [ " + sv[i*3 + 1] + "," + sv[i*3 + 2] + "," +
+                                       sv[i*3 + 3] + "]\n");
+                } 
+                spike_validation(Spike(spike_id, spike_time, spike_val), net, true);
+                stream_spike.id = net->get_node(spike_id)->input_id;
+                stream_spike.time = spike_time;
+                stream_spike.value = spike_val;
+                if (!p->input_stream(net_id)->push(stream_spike)) printf("SI - the input stream is full\n");
+              } catch (const SRE &e) {
+                printf("%s\n",e.what());
+              }   
+            }
+          }
+        }
+
+      } else if (sv[0] == "SO") { // pop from output_stream()
+
+        if (network_processor_validation(net, p)) {
+          if (p->output_stream(net_id) == NULL) {
+            printf("SO - the streams aren't open (use OPEN_STREAMS)\n");
+          } else {
+            while (p->output_stream(net_id)->pop(stream_spike)) {
+              node = net->get_output(stream_spike.id);
+              printf("node %s fired at time %u\n", node_name(node).c_str(), stream_spike.time);
+            }
+            if (p->input_stream(net_id)->rejected() != 0) {
+              printf("bad input spikes dropped: %llu\n",
+                     (unsigned long long) p->input_stream(net_id)->rejected());
+            }
+          }
+        }
+
       } else if (sv[0] == "RUN_SR_CH" || sv[0] == "RSC") {
         
         if (network_processor_validation(net, p)) {
@@ -517,7 +670,7 @@ int main(int argc, char **argv)
               }
             }
 
-            j1 = run_and_track(sim_time, p);
+            j1 = run_and_track(sim_time, p, net_id);
 
             // Print the names of the nodes, twice.
             printf("Time");
@@ -566,7 +719,7 @@ int main(int argc, char **argv)
            Caspian will get the sum to running time. GNP will get the simulation time
         */
         if (network_processor_validation(net, p)) 
-          printf("time: %.1lf\n", p->get_time());
+          printf("time: %.1lf\n", p->get_time(net_id));
   
       } else if (sv[0] == "NLF") { // test neuron_last_fires
   
@@ -574,7 +727,7 @@ int main(int argc, char **argv)
           printf("usage: NLF show_nonfiring - Last fire times for all neurons. show_nonfiring=T/F\n");
         } else if (network_processor_validation(net, p)) {
           net->make_sorted_node_vector();
-          output_times = p->neuron_last_fires();
+          output_times = p->neuron_last_fires(net_id);
           if (output_times.size() == 0) {
             printf("Recording last fire times for neurons is not implemented by %s.\n",
                    p->get_name().c_str());
@@ -595,7 +748,7 @@ int main(int argc, char **argv)
            Caspian will get the sum to running time. GNP will get the simulation time
         */
         if (network_processor_validation(net, p)) 
-          printf("time: %.1lf\n", p->get_time());
+          printf("time: %.1lf\n", p->get_time(net_id));
   
       } else if (sv[0] == "NLF") { // test neuron_last_fires
   
@@ -603,7 +756,7 @@ int main(int argc, char **argv)
           printf("usage: NLF show_nonfiring - Last fire times for all neurons. show_nonfiring=T/F\n");
         } else if (network_processor_validation(net, p)) {
           net->make_sorted_node_vector();
-          output_times = p->neuron_last_fires();
+          output_times = p->neuron_last_fires(net_id);
           if (output_times.size() == 0) {
             printf("Recording last fire times for neurons is not implemented by %s.\n",
                    p->get_name().c_str());
@@ -622,14 +775,14 @@ int main(int argc, char **argv)
         if (sv.size() != 1) {
           printf("usage: TNC - Total fire counts for all neurons.\n");
         } else if (network_processor_validation(net, p)) {
-          printf("%lld\n", p->total_neuron_counts());
+          printf("%lld\n", p->total_neuron_counts(net_id));
         }
 
       } else if (sv[0] == "TNA") { // test total_neuron_counts
         if (sv.size() != 1) {
           printf("usage: TNA - Total accumulates for all neurons.\n");
         } else if (network_processor_validation(net, p)) {
-          printf("%lld\n", p->total_neuron_accumulates());
+          printf("%lld\n", p->total_neuron_accumulates(net_id));
         }
 
       } else if (sv[0] == "NC") { // test neuron_counts
@@ -638,7 +791,7 @@ int main(int argc, char **argv)
           printf("usage: NC show_nonfiring - Fire counts for all neurons. show_nonfiring=T/F\n");
         } else if (network_processor_validation(net, p)) {
           net->make_sorted_node_vector();
-          event_counts = p->neuron_counts();
+          event_counts = p->neuron_counts(net_id);
           if (event_counts.size() == 0) {
               printf("Recording event counts for neurons is not implemented by %s.\n",
                      p->get_name().c_str());
@@ -658,7 +811,7 @@ int main(int argc, char **argv)
   
         if (network_processor_validation(net, p)) {
           net->make_sorted_node_vector();
-          charges = p->neuron_charges();
+          charges = p->neuron_charges(net_id);
           if (charges.size() == 0) {
               printf("Recording charges for neurons is not implemented by %s.\n",
                      p->get_name().c_str());
@@ -691,7 +844,7 @@ int main(int argc, char **argv)
           } else {
             from = -1;
           }
-          p->synapse_weights(pres, posts, weights);
+          p->synapse_weights(pres, posts, weights, net_id);
 
           /* Since the previous call is O(synapses anyway), I'm not embarrased of
              this loop when from/to are specified. */
@@ -703,6 +856,96 @@ int main(int argc, char **argv)
           }
         }
   
+      } else if (sv[0] == "SSW") { // test set_synapse_weights
+  
+        if (sv.size() < 4 || (sv.size() - 1) % 3 != 0) {
+          printf("usage: SSW from to weight [from to weight ...]\n");
+        } else if (network_processor_validation(net, p)) {
+          pres.clear();
+          posts.clear();
+          weights.clear();
+          for (i = 1; i < sv.size(); i += 3) {
+            if (sscanf(sv[i].c_str(), "%d", &from) != 1 || from < 0 ||
+                sscanf(sv[i+1].c_str(), "%d", &to) != 1 || to < 0 ||
+                sscanf(sv[i+2].c_str(), "%lf", &val) != 1) {
+              throw SRE((string) "SSW - Invalid synapse [ " + sv[i] + "," + sv[i+1] + "," +
+                        sv[i+2] + "]");
+            }
+            pres.push_back(from);
+            posts.push_back(to);
+            weights.push_back(val);
+          }
+          p->set_synapse_weights(pres, posts, weights, net_id);
+        }
+  
+      } else if (sv[0] == "SNT") { // test set_neuron_thresholds
+  
+        if (sv.size() < 3 || (sv.size() - 1) % 2 != 0) {
+          printf("usage: SNT node_id threshold [node_id threshold ...]\n");
+        } else if (network_processor_validation(net, p)) {
+          pres.clear();
+          data.clear();
+          for (i = 1; i < sv.size(); i += 2) {
+            if (sscanf(sv[i].c_str(), "%d", &node_id) != 1 || node_id < 0 ||
+                sscanf(sv[i+1].c_str(), "%lf", &val) != 1) {
+              throw SRE((string) "SNT - Invalid neuron [ " + sv[i] + "," + sv[i+1] + "]");
+            }
+            pres.push_back(node_id);
+            data.push_back(val);
+          }
+          p->set_neuron_thresholds(pres, data, net_id);
+        }
+  
+      } else if (sv[0] == "PATCH") { // apply_network_patch()
+
+        if (!read_json(sv, 1, network_json)) {
+          printf("usage: PATCH network_json. Bad json\n");
+        } else if (network_processor_validation(net, p)) {
+          new_net = new Network();
+          try {
+            new_net->from_json(network_json);
+            if (!p->apply_network_patch(net->diff(*new_net), net_id)) {
+              if (!p->load_network(new_net, net_id)) throw SRE("load_network() failed");
+            }
+            track_all_neuron_events(p, new_net, net_id);
+            delete net;
+            net = new_net;
+            max_name_len = max_node_name_len(net);
+          } catch (const SRE &e) {
+            printf("%s\n",e.what());
+            delete new_net;
+          }
+        }
+
+      } else if (sv[0] == "APPLY_PATCH") { // apply_network_patch() with a NetworkPatch
+
+        if (!read_json(sv, 1, network_json)) {
+          printf("usage: APPLY_PATCH patch_json. Bad json\n");
+        } else if (network_processor_validation(net, p)) {
+          new_net = new Network(*net);
+          try {
+            patch.from_json(network_json);
+            applied = p->apply_network_patch(patch, net_id);
+            try {
+              new_net->apply_patch(patch);
+            } catch (const SRE &e) {
+              if (applied) {      // Put the processor back the way it was.
+                p->load_network(net, net_id);
+                track_all_neuron_events(p, net, net_id);
+              }
+              throw;
+            }
+            if (!applied && !p->load_network(new_net, net_id)) throw SRE("load_network() failed");
+            track_all_neuron_events(p, new_net, net_id);
+            delete net;
+            net = new_net;
+            max_name_len = max_node_name_len(net);
+          } catch (const SRE &e) {
+            printf("%s\n",e.what());
+            delete new_net;
+          }
+        }
+
       } else if (sv[0] == "PULL_NETWORK") { // test pull_network
   
         if (sv.size() != 2) {
@@ -713,7 +956,7 @@ int main(int argc, char **argv)
           if (fout.fail()) {
             perror(sv[1].c_str());
           } else {
-            pulled = pull_network(p, net);
+            pulled = pull_network(p, net, net_id);
             fout << pulled->as_json() << endl;
             fout.close();
             delete pulled;
@@ -727,7 +970,7 @@ int main(int argc, char **argv)
         } else if (network_processor_validation(net, p)) {
           net->make_sorted_node_vector();
           try {
-            neuron_times = p->neuron_vectors();
+            neuron_times = p->neuron_vectors(net_id);
             if (neuron_times.size() == 0) {
               printf("Recording events for neurons is not implemented by %s.\n",
                      p->get_name().c_str());
@@ -756,7 +999,7 @@ int main(int argc, char **argv)
         if (network_processor_validation(net, p)) {
   
           if (sv.size() == 1) {
-            output_times = p->output_last_fires();
+            output_times = p->output_last_fires(net_id);
             for (i = 0; i < (size_t)net->num_outputs(); i++) {
               node = net->get_output(i);
               printf("node %s last fire time: %.1lf\n", node_name(node).c_str(), output_times[i]);
@@ -771,7 +1014,7 @@ int main(int argc, char **argv)
                 output_node_id_validation(node_id, net);
                 output_id = net->get_node(node_id)->output_id;
                 node = net->get_node(node_id);
-                printf("node %s last fire time: %.1lf\n", node_name(node).c_str(), p->output_last_fire(output_id));
+                printf("node %s last fire time: %.1lf\n", node_name(node).c_str(), p->output_last_fire(output_id, net_id));
     
               } catch (const SRE &e) {
                 printf("%s\n",e.what());
@@ -783,7 +1026,7 @@ int main(int argc, char **argv)
       } else if (sv[0] == "OC") {   // Test output_count and output_counts
         if (network_processor_validation(net, p)) {
           if (sv.size() == 1) {
-            event_counts = p->output_counts();
+            event_counts = p->output_counts(net_id);
             for (i = 0; i < (size_t)net->num_outputs(); i++) {
               node = net->get_output(i);
               printf("node %s spike counts: %d\n", node_name(node).c_str(), event_counts[i]);
@@ -799,7 +1042,7 @@ int main(int argc, char **argv)
     
                 output_id = net->get_node(node_id)->output_id;
                 node = net->get_node(node_id);
-                printf("node %s spike counts: %d\n", node_name(node).c_str(), p->output_count(output_id));
+                printf("node %s spike counts: %d\n", node_name(node).c_str(), p->output_count(output_id, net_id));
               } catch (const SRE &e) {
                 printf("%s\n",e.what());
               }
@@ -811,9 +1054,9 @@ int main(int argc, char **argv)
         if (network_processor_validation(net, p)) {
           if (sv.size() == 1) {
             if (sv[0][0] == 'T') {
-              (void) track_all_output_events(p, net);
+              (void) track_all_output_events(p, net, net_id);
             } else {
-              for (i = 0; i < (size_t)net->num_outputs(); i++) p->track_output_events(i, false);
+              for (i = 0; i < (size_t)net->num_outputs(); i++) p->track_output_events(i, false, net_id);
             } 
           } else {
             for (i = 1; i < sv.size(); i++) {
@@ -824,7 +1067,7 @@ int main(int argc, char **argv)
                 output_node_id_validation(node_id, net);
     
                 output_id = net->get_node(node_id)->output_id;
-                if (!p->track_output_events(output_id, (sv[0][0] == 'T'))) {
+                if (!p->track_output_events(output_id, (sv[0][0] == 'T'), net_id)) {
                   snprintf(buf, 50, "%d, %d) failed.", output_id, (sv[0][0] == 'T'));
                   throw SRE((string) "track_output_events(" + buf);
                 }
@@ -839,12 +1082,12 @@ int main(int argc, char **argv)
         if (network_processor_validation(net, p)) {
           if (sv.size() == 1) {
             if (sv[0][0] == 'T') {
-              if (!track_all_neuron_events(p, net)) {
+              if (!track_all_neuron_events(p, net, net_id)) {
                 printf("track_all_neuron_events() not supported by processor.\n");
               }
             } else {
               for (nit = net->begin(); nit != net->end(); nit++) {
-                p->track_neuron_events(nit->second->id, false);
+                p->track_neuron_events(nit->second->id, false, net_id);
               }
             } 
           } else {
@@ -853,7 +1096,7 @@ int main(int argc, char **argv)
                 if (sscanf(sv[i].c_str(), "%d", &node_id) != 1 || node_id < 0) {
                   throw SRE(sv[i] + " is not a valid node id");
                 }
-                if (!p->track_neuron_events(node_id, (sv[0][0] == 'T'))) {
+                if (!p->track_neuron_events(node_id, (sv[0][0] == 'T'), net_id)) {
                   snprintf(buf, 50, "%d, %d) failed.", node_id, (sv[0][0] == 'T'));
                   throw SRE((string) "track_neuron_events(" + buf);
                 }
@@ -872,7 +1115,7 @@ int main(int argc, char **argv)
   
           if (sv.size() == 1) {
             try {
-              all_output_times = p->output_vectors();
+              all_output_times = p->output_vectors(net_id);
               if (all_output_times.size() == 0) {
                 throw SRE("Processor error -- p->output_vectors returned a vector of size zero");
               } 
@@ -901,7 +1144,7 @@ int main(int argc, char **argv)
                 output_node_id_validation(node_id, net);
                 output_id = net->get_node(node_id)->output_id;
     
-                output_times = p->output_vector(output_id);
+                output_times = p->output_vector(output_id, net_id);
                 node = net->get_node(node_id);
                 printf("node %s spike times: ", node_name(node).c_str());
                 for (j = 0; j < output_times.size(); j++) {
@@ -922,8 +1165,65 @@ int main(int argc, char **argv)
       } else if (sv[0] == "CA" || sv[0] == "CLEAR-A") { // clear_activity
   
         if (network_processor_validation(net, p)) 
-          p->clear_activity();
+          p->clear_activity(net_id);
+  
+      } else if (sv[0] == "SAVE_STATE") { // save_state
   
+        if (sv.size() > 2) {
+          printf("usage: SAVE_STATE [file]\n");
+        } else if (network_processor_validation(net, p)) {
+          saved_state = p->save_state(net_id);
+          if (sv.size() == 2) {
+            fout.clear();
+            fout.open(sv[1].c_str(), ios::binary);
+            if (fout.fail()) {
+              perror(sv[1].c_str());
+            } else {
+              fout.write((const char *) saved_state.data(), saved_state.size());
+              fout.close();
+            }
+          }
+        }
+  
+      } else if (sv[0] == "RESTORE_STATE") { // restore_state
+  
+        if (sv.size() > 2) {
+          printf("usage: RESTORE_STATE [file]\n");
+        } else if (network_processor_validation(net, p)) {
+          if (sv.size() == 2) {
+            fin.clear();
+            fin.open(sv[1].c_str(), ios::binary);
+            if (fin.fail()) {
+              throw SRE("RESTORE_STATE - can't open " + sv[1] + ": " + strerror(errno));
+            }
+            saved_state.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+            fin.close();
+          } else if (saved_state.size() == 0) {
+            throw SRE("RESTORE_STATE - no state has been saved");
+          }
+          p->restore_state(saved_state, net_id);
+          spikes_array.clear();
+        }
+
+      } else if (sv[0] == "CLONE") { // clone_network()
+
+        if (sv.size() != 3 || sscanf(sv[1].c_str(), "%d", &from) != 1 ||
+            sscanf(sv[2].c_str(), "%d", &to) != 1 || from < 0 || to < 0) {
+          printf("usage: CLONE src_network_id dst_network_id\n");
+        } else if (network_processor_validation(net, p)) {
+          p->clone_network(from, to);
+        }
+
+      } else if (sv[0] == "NET") { // the network_id that the other commands use
+
+        if (sv.size() == 1) {
+          printf("%d\n", net_id);
+        } else if (sv.size() != 2 || sscanf(sv[1].c_str(), "%d", &k) != 1 || k < 0) {
+          printf("usage: NET [network_id]\n");
+        } else {
+          net_id = k;
+        }
+
       } else if (sv[0] == "CLEAR" || sv[0] == "C") {
   
         if (network_processor_validation(net, p)) {
@@ -974,9 +1274,11 @@ int main(int argc, char **argv)
           net->set_data("other", j1);
           net->set_data("proc_params", p->get_params());
           if (sv.size() == 1) {
-            cout << net->pretty_json() << endl;
+            net->write_json(cout, true);
+            cout << endl;
           } else {
-            fout << net->as_json() << endl;
+            net->write_json(fout);
+            fout << endl;
             fout.close();
           }
         }
@@ -1015,7 +1317,7 @@ int main(int argc, char **argv)
         if (network_processor_validation(net, p)) {
 
           net->make_sorted_node_vector();
-          neuron_times = p->neuron_vectors();
+          neuron_times = p->neuron_vectors(net_id);
           spike_raster = neuron_vectors_to_json(neuron_times, "S", net);
           spike_strings = spike_raster["Spikes"].get<vector <string>>();
 
@@ -1038,6 +1340,58 @@ int main(int argc, char **argv)
         }
   
          
+      } else if (sv[0] == "BUFFERS") { // the buffer versions of output_counts() etc.
+
+        /* Each buffer is one entry bigger than it needs to be, so that the count that
+           comes back is checked too.  Then a buffer that's too small has to throw. */
+
+        if (network_processor_validation(net, p)) {
+          try {
+            v = p->output_counts(net_id);
+            int_buf.assign(v.size() + 1, -1);
+            print_buffer_check("output_counts", v, int_buf,
+                               p->output_counts(int_buf.data(), int_buf.size(), net_id));
+
+            data = p->output_last_fires(net_id);
+            double_buf.assign(data.size() + 1, -2);
+            print_buffer_check("output_last_fires", data, double_buf,
+                               p->output_last_fires(double_buf.data(), double_buf.size(), net_id));
+
+            all_output_times = p->output_vectors(net_id);
+            data.clear();
+            size_buf.clear();
+            for (i = 0; i < all_output_times.size(); i++) {
+              data.insert(data.end(), all_output_times[i].begin(), all_output_times[i].end());
+              size_buf.push_back(all_output_times[i].size());
+            }
+            double_buf.assign(data.size() + 1, -2);
+            counts_buf.assign(size_buf.size() + 1, 0);
+            j = p->output_vectors(double_buf.data(), double_buf.size(),
+                                  counts_buf.data(), counts_buf.size(), net_id);
+            print_buffer_check("output_vectors", data, double_buf, j);
+            print_buffer_check("  (counts)", size_buf, counts_buf, size_buf.size());
+
+            v = p->neuron_counts(net_id);
+            int_buf.assign(v.size() + 1, -1);
+            print_buffer_check("neuron_counts", v, int_buf,
+                               p->neuron_counts(int_buf.data(), int_buf.size(), net_id));
+
+            data = p->neuron_last_fires(net_id);
+            double_buf.assign(data.size() + 1, -2);
+            print_buffer_check("neuron_last_fires", data, double_buf,
+                               p->neuron_last_fires(double_buf.data(), double_buf.size(), net_id));
+
+            charges = p->neuron_charges(net_id);
+            double_buf.assign(charges.size() + 1, -2);
+            print_buffer_check("neuron_charges", charges, double_buf,
+                               p->neuron_charges(double_buf.data(), double_buf.size(), net_id));
+
+            if (!charges.empty()) p->neuron_charges(double_buf.data(), charges.size() - 1, net_id);
+          } catch (const SRE &e) {
+            printf("%s\n", e.what());
+          }
+        }
+
       } else if (sv[0] == "INFO") { // print input,hidden and output nodes id.
   
         if (network_processor_validation(net, p)) {
@@ -1068,13 +1422,13 @@ int main(int argc, char **argv)
       } else if (sv[0] == "NCJ") { // test neuron_counts_to_json()
   
         if (network_processor_validation(net, p)) {
-          cout << neuron_counts_to_json(p->neuron_counts(), net) << endl;
+          cout << neuron_counts_to_json(p->neuron_counts(net_id), net) << endl;
         }
   
       } else if (sv[0] == "NCHJ") { // test neuron_charges_to_json()
   
         if (network_processor_validation(net, p)) {
-          cout << neuron_charges_to_json(p->neuron_charges(), net) << endl;
+          cout << neuron_charges_to_json(p->neuron_charges(net_id), net) << endl;
         }
   
       } else if (sv[0] == "NVJ") { // test neuron_vectors_to_json()
@@ -1086,7 +1440,7 @@ int main(int argc, char **argv)
         } else if (network_processor_validation(net, p)) {
   
           try {
-            cout << neuron_vectors_to_json(p->neuron_vectors(), sv[1], net) << endl;
+            cout << neuron_vectors_to_json(p->neuron_vectors(net_id), sv[1], net) << endl;
           } catch (const SRE &e) {
             printf("%s\n",e.what());
           } catch (...) {
@@ -1097,7 +1451,7 @@ int main(int argc, char **argv)
       } else if (sv[0] == "NLFJ") { // test neuron_last_fires_to_json()
   
         if (network_processor_validation(net, p)) {
-          cout << neuron_last_fires_to_json(p->neuron_last_fires(), net) << endl;
+          cout << neuron_last_fires_to_json(p->neuron_last_fires(net_id), net) << endl;
         }
   
       } else {
@@ -238,6 +238,39 @@ namespace neuro
         }
         return s;
     }
+    /* Handles copy what Node/Edge get() and set() need from the property, so that they
+       don't have to find it in the map. */
+
+    static PropertyHandle make_handle(const PropertyMap &pm, const string &name,
+                                      PropertyHandle::Kind kind)
+    {
+      PropertyMap::const_iterator pit;
+      PropertyHandle h;
+
+      pit = pm.find(name);
+      if (pit == pm.end()) {
+        throw SRE((string) "Cannot find " + ((kind == PropertyHandle::NODE) ? "node" : "edge") +
+                  " property: " + name);
+      }
+      h.kind = kind;
+      h.index = pit->second.index;
+      h.min_value = pit->second.min_value;
+      h.max_value = pit->second.max_value;
+      h.type = pit->second.type;
+      h.name = name;
+      return h;
+    }
+
+    PropertyHandle PropertyPack::node_handle(const string& name) const
+    {
+      return make_handle(nodes, name, PropertyHandle::NODE);
+    }
+
+    PropertyHandle PropertyPack::edge_handle(const string& name) const
+    {
+      return make_handle(edges, name, PropertyHandle::EDGE);
+    }
+
     int PropertyPack::add_node_property(const string& name, double dmin, double dmax, Property::Type type, int cnt)
     {
         // starting index
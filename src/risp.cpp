@@ -2,7 +2,10 @@
 #include <cmath>
 #include "risp.hpp"
 #include "utils/json_helpers.hpp"
+#include "utils/binary_helpers.hpp"
 #include <random>
+#include <algorithm>
+#include <unordered_set>
 
 typedef std::runtime_error SRE;
 using namespace std;
@@ -27,6 +30,7 @@ static json risp_spec = {
   { "weights", "A"},
   { "inputs_from_weights", "B"},
   { "noisy_seed", "I" },
+  { "noisy_engine", "S" },         /* "mt19937", "xoshiro256**" */
   { "stds", "A"},
     { "Necessary", { "max_delay", 
                      "min_threshold",
@@ -43,7 +47,9 @@ Neuron::Neuron(uint32_t node_id, double t, bool l)
     fire_counts(0),
     leak(l),
     id(node_id),
-    check(false) {};
+    output_id(-1),
+    check(false),
+    track(false) {};
 
 Synapse::Synapse(double w, uint32_t d, Neuron* to_n) : weight(w), to(to_n), delay(d) {};
 
@@ -66,6 +72,7 @@ Network::Network(neuro::Network *net,
                  bool _inputs_from_weights, 
                  uint32_t _noisy_seed,
                  double _noisy_stddev,
+                 MOA::Engine _noisy_engine,
                  vector <double> & _weights, 
                  vector < double> & _stds) {
 
@@ -74,6 +81,7 @@ Network::Network(neuro::Network *net,
   neuro::Edge *edge;
   EdgeMap::iterator eit;
   Neuron *n;
+  vector <double> thresholds, leaks, weights_v, delays;
   leak_mode = leak;
   bool neuron_leak;
 
@@ -91,32 +99,105 @@ Network::Network(neuro::Network *net,
   overall_run_time = 0;
   neuron_fire_counter = 0;
   neuron_accum_counter = 0;
+  in_stream = NULL;
+  out_stream = NULL;
+  run_start_time = 0;
+  rng.Set_Engine(_noisy_engine);
   rng.Seed(noisy_seed, "noisy_risp");
 
+  /* Pull each property out of the network at once, with handles, rather than looking
+     up its name for every neuron and synapse. */
+
+  net->get_all(net->node_handle("Threshold"), thresholds);
+  if (leak_mode == 'c') net->get_all(net->node_handle("Leak"), leaks);
+  net->get_all(net->edge_handle("Weight"), weights_v);
+  net->get_all(net->edge_handle("Delay"), delays);
+
   /* Add neurons */
-  net->make_sorted_node_vector();
 
   for(i = 0; i < net->sorted_node_vector.size(); i++) {
     node = net->sorted_node_vector[i];
 
     if (leak_mode == 'c') {
-      neuron_leak = (node->get("Leak") != 0);
+      neuron_leak = (leaks[i] != 0);
     } else {
       neuron_leak = (leak_mode == 'a');
     }
 
-    n = add_neuron(node->id, node->get("Threshold"), neuron_leak);
+    n = add_neuron(node->id, thresholds[i], neuron_leak);
     if (node->is_input()) add_input(node->id, node->input_id);
     if (node->is_output()) add_output(node->id, node->output_id);
 
+    n->index = sorted_neuron_vector.size();
     sorted_neuron_vector.push_back(n);
   }
 
-  /* Add synpases */
-  for (eit = net->edges_begin(); eit != net->edges_end(); ++eit) {
+  /* Add synpases.  get_all() goes through the edges in this same order. */
+  for (i = 0, eit = net->edges_begin(); eit != net->edges_end(); ++eit, i++) {
     edge = eit->second.get();
-    add_synpase(edge->from->id, edge->to->id, edge->get("Weight"), edge->get("Delay"));
+    add_synpase(edge->from->id, edge->to->id, weights_v[i], delays[i]);
+  }
+}
+
+/* Copy an already-built network, including its dynamic state.  Neurons are copied
+   by value, and then every Neuron pointer (synapse targets, events, to_fire) is
+   redirected to the new copy, using the neuron's index in sorted_neuron_vector.
+   This never touches the neuro::Network, so it's much cheaper than converting
+   the network again.  The copy doesn't get src's spike streams. */
+
+Network::Network(const Network &src)
+  : inputs(src.inputs),
+    outputs(src.outputs),
+    events(src.events),
+    neuron_fire_counter(src.neuron_fire_counter),
+    neuron_accum_counter(src.neuron_accum_counter),
+    overall_run_time(src.overall_run_time),
+    run_time_inclusive(src.run_time_inclusive),
+    threshold_inclusive(src.threshold_inclusive),
+    min_potential(src.min_potential),
+    fire_like_ravens(src.fire_like_ravens),
+    discrete(src.discrete),
+    inputs_from_weights(src.inputs_from_weights),
+    leak_mode(src.leak_mode),
+    weights(src.weights),
+    noisy_stddev(src.noisy_stddev),
+    noisy_seed(src.noisy_seed),
+    rng(src.rng),
+    stds(src.stds),
+    spike_value_factor(src.spike_value_factor),
+    to_fire(src.to_fire),
+    in_stream(NULL),
+    out_stream(NULL),
+    run_start_time(src.run_start_time)
+{
+  size_t i, j;
+  Neuron *n;
+  Synapse *syn;
+
+  sorted_neuron_vector.resize(src.sorted_neuron_vector.size());
+  neuron_map.reserve(src.neuron_map.size());
+
+  for (i = 0; i < sorted_neuron_vector.size(); i++) {
+    n = new Neuron(*src.sorted_neuron_vector[i]);
+    sorted_neuron_vector[i] = n;
+    neuron_map[n->id] = n;
   }
+
+  for (i = 0; i < sorted_neuron_vector.size(); i++) {
+    n = sorted_neuron_vector[i];
+    for (j = 0; j < n->synapses.size(); j++) {
+      syn = n->synapses[j];
+      n->synapses[j] = new Synapse(syn->weight, syn->delay, 
+                                   sorted_neuron_vector[syn->to->index]);
+    }
+  }
+
+  for (i = 0; i < events.size(); i++) {
+    for (j = 0; j < events[i].size(); j++) {
+      events[i][j].first = sorted_neuron_vector[events[i][j].first->index];
+    }
+  }
+  for (i = 0; i < to_fire.size(); i++) to_fire[i] = sorted_neuron_vector[to_fire[i]->index];
 }
 
 Neuron* Network::get_neuron(uint32_t node_id) 
@@ -177,6 +258,8 @@ Network::~Network() {
     for (i = 0; i < n->synapses.size(); i++) delete n->synapses[i];
     delete n;
   }
+  delete in_stream;
+  delete out_stream;
 }
 
 Synapse* Network::add_synpase(uint32_t from_id, uint32_t to_id, double weight, uint32_t delay) {
@@ -215,6 +298,7 @@ void Network::add_input(uint32_t node_id, int input_id)
   if (input_id < 0) throw SRE("risp::Network::add_input() - input_id < 0");
   if (input_id >= (int) inputs.size()) inputs.resize(input_id + 1, -1);
   inputs[input_id] = node_id;
+  input_neurons.clear();
 }
 
 
@@ -228,6 +312,7 @@ void Network::add_output(uint32_t node_id, int output_id)
   if (output_id < 0) throw SRE("risp::Network::add_output() - output_id < 0");
   if (output_id >= (int) outputs.size()) outputs.resize(output_id + 1, -1);
   outputs[output_id] = node_id;
+  get_neuron(node_id)->output_id = output_id;
 }
 
 void Network::process_events(uint32_t time) 
@@ -257,7 +342,10 @@ void Network::process_events(uint32_t time)
 
   /* Cause neurons to fire if we're firing like RAVENS */
 
-  for (i = 0; i < to_fire.size(); i++) to_fire[i]->perform_fire(time);
+  for (i = 0; i < to_fire.size(); i++) {
+    to_fire[i]->perform_fire(time);
+    if (out_stream != NULL) stream_fire(to_fire[i], time);
+  }
   neuron_fire_counter += to_fire.size();
   to_fire.clear();
   
@@ -306,9 +394,9 @@ void Network::process_events(uint32_t time)
           } else if (stds.size() == 0) {
             weight = weights[int(syn->weight)];
           } else {
-            weight = rng.Random_Normal(weights[int(syn->weight)], stds[int(syn->weight)]);
+            weight = noise(weights[int(syn->weight)], stds[int(syn->weight)]);
           }
-          if (noisy_stddev != 0) weight = rng.Random_Normal(weight, noisy_stddev);
+          if (noisy_stddev != 0) weight = noise(weight, noisy_stddev);
 
           events[to_time].push_back(make_pair(syn->to, weight));
           
@@ -319,6 +407,7 @@ void Network::process_events(uint32_t time)
         } else {
           neuron_fire_counter++;
           n->perform_fire(time);
+          if (out_stream != NULL) stream_fire(n, time);
         }
       }
       n->check = false;
@@ -345,13 +434,184 @@ void Network::clear_activity() {
   overall_run_time = 0;
 }
 
+/* This does what Processor::run_batch() does by default, but it skips the virtual
+   calls, the conversion of each sample's spikes, and the output vectors.  The output
+   neurons are looked up once, and the counts and last fires go straight into rv. */
+
+void Network::run_batch(const SpikeBatch &batch, double duration, BatchResult &rv)
+{
+  vector <Neuron *> outs;
+  size_t i, o;
+
+  for (i = 0; i < outputs.size(); i++) {
+    if (outputs[i] != -1) outs.push_back(neuron_map[outputs[i]]);
+  }
+  rv.resize(batch.num_samples(), outs.size());
+
+  for (i = 0; i < batch.num_samples(); i++) {
+    clear_activity();
+    apply_spikes(batch, batch.sample_begin(i), batch.sample_end(i));
+    run(duration);
+    for (o = 0; o < outs.size(); o++) {
+      rv.counts[i * outs.size() + o] = outs[o]->fire_counts;
+      rv.last_fires[i * outs.size() + o] = outs[o]->last_fire;
+    }
+  }
+}
+
+/* The state blob holds everything that clear_activity() resets, plus the RNG if the
+   network is noisy.  Neurons are referred to by their index in sorted_neuron_vector,
+   so a blob can only be restored onto a network with the same neurons.  The layout is:
+
+     - A magic number and the number of neurons.
+     - overall_run_time, neuron_fire_counter and neuron_accum_counter.
+     - For each neuron: charge, last_check, last_fire, fire_counts, check and fire_times.
+     - The events: the number of timesteps, and then for each timestep, the number
+       of events followed by (neuron index, charge) pairs.
+     - The to_fire vector, as neuron indices.
+     - A byte that says whether the RNG state follows, and then the RNG state. */
+
+static const uint32_t risp_state_magic = 0x50534952;   // "RISP"
+
+void Network::save_state(vector <uint8_t> &state)
+{
+  size_t i, j;
+  Neuron *n;
+  vector <uint8_t> rng_state;
+  bool noisy;
+
+  state.clear();
+  bin_put(state, risp_state_magic);
+  bin_put(state, (uint32_t) sorted_neuron_vector.size());
+  bin_put(state, overall_run_time);
+  bin_put(state, neuron_fire_counter);
+  bin_put(state, neuron_accum_counter);
+
+  for (i = 0; i < sorted_neuron_vector.size(); i++) {
+    n = sorted_neuron_vector[i];
+    bin_put(state, n->charge);
+    bin_put(state, n->last_check);
+    bin_put(state, n->last_fire);
+    bin_put(state, n->fire_counts);
+    bin_put(state, (uint8_t) n->check);
+    bin_put(state, (uint32_t) n->fire_times.size());
+    bin_put_bytes(state, n->fire_times.data(), n->fire_times.size() * sizeof(double));
+  }
+
+  bin_put(state, (uint32_t) events.size());
+  for (i = 0; i < events.size(); i++) {
+    bin_put(state, (uint32_t) events[i].size());
+    for (j = 0; j < events[i].size(); j++) {
+      bin_put(state, events[i][j].first->index);
+      bin_put(state, events[i][j].second);
+    }
+  }
+
+  bin_put(state, (uint32_t) to_fire.size());
+  for (i = 0; i < to_fire.size(); i++) bin_put(state, to_fire[i]->index);
+
+  noisy = (noisy_stddev != 0 || stds.size() != 0);
+  bin_put(state, (uint8_t) noisy);
+  if (noisy) {
+    rng.Get_Engine_State(rng_state);
+    bin_put(state, (uint32_t) rng_state.size());
+    bin_put_bytes(state, rng_state.data(), rng_state.size());
+  }
+}
+
+void Network::restore_state(const vector <uint8_t> &state)
+{
+  size_t i, j, off;
+  uint32_t num, ne, idx;
+  Neuron *n;
+  vector <uint8_t> rng_state;
+  MOA new_rng;
+  vector < vector < std::pair<Neuron *, double> > > new_events;
+  vector <Neuron *> new_to_fire;
+  string rsn = "risp::Network::restore_state() - ";
+
+  /* Parse and check everything before touching the network, 
+     so that a bad blob leaves the network unchanged. */
+
+  try {
+    off = 0;
+    if (bin_get<uint32_t>(state, off) != risp_state_magic) {
+      throw SRE(rsn + "the state was not saved by RISP");
+    }
+    if (bin_get<uint32_t>(state, off) != sorted_neuron_vector.size()) {
+      throw SRE(rsn + "the state was saved from a network with a different number of neurons");
+    }
+    (void) bin_get<int>(state, off);
+    (void) bin_get<long long>(state, off);
+    (void) bin_get<long long>(state, off);
+    for (i = 0; i < sorted_neuron_vector.size(); i++) {
+      off += sizeof(double) + 2 * sizeof(int) + sizeof(uint32_t) + sizeof(uint8_t);
+      num = bin_get<uint32_t>(state, off);
+      off += num * sizeof(double);
+    }
+
+    num = bin_get<uint32_t>(state, off);
+    new_events.resize(num);
+    for (i = 0; i < num; i++) {
+      ne = bin_get<uint32_t>(state, off);
+      new_events[i].reserve(ne);
+      for (j = 0; j < ne; j++) {
+        idx = bin_get<uint32_t>(state, off);
+        if (idx >= sorted_neuron_vector.size()) throw SRE(rsn + "bad neuron index in an event");
+        new_events[i].push_back(make_pair(sorted_neuron_vector[idx], bin_get<double>(state, off)));
+      }
+    }
+
+    num = bin_get<uint32_t>(state, off);
+    for (i = 0; i < num; i++) {
+      idx = bin_get<uint32_t>(state, off);
+      if (idx >= sorted_neuron_vector.size()) throw SRE(rsn + "bad neuron index in to_fire");
+      new_to_fire.push_back(sorted_neuron_vector[idx]);
+    }
+
+    new_rng = rng;
+    if (bin_get<uint8_t>(state, off)) {
+      num = bin_get<uint32_t>(state, off);
+      rng_state.resize(num);
+      bin_get_bytes(state.data(), state.size(), off, rng_state.data(), num);
+      new_rng.Set_Engine_State(rng_state);
+    }
+    if (off != state.size()) throw SRE(rsn + "the state has extra bytes at the end");
+
+  } catch (const SRE &e) {
+    if (string(e.what()).compare(0, rsn.size(), rsn) == 0) throw;
+    throw SRE(rsn + e.what());
+  }
+
+  /* Now, set the state for real. */
+
+  off = 2 * sizeof(uint32_t);
+  overall_run_time = bin_get<int>(state, off);
+  neuron_fire_counter = bin_get<long long>(state, off);
+  neuron_accum_counter = bin_get<long long>(state, off);
+
+  for (i = 0; i < sorted_neuron_vector.size(); i++) {
+    n = sorted_neuron_vector[i];
+    n->charge = bin_get<double>(state, off);
+    n->last_check = bin_get<int>(state, off);
+    n->last_fire = bin_get<int>(state, off);
+    n->fire_counts = bin_get<uint32_t>(state, off);
+    n->check = (bin_get<uint8_t>(state, off) != 0);
+    num = bin_get<uint32_t>(state, off);
+    n->fire_times.resize(num);
+    bin_get_bytes(state.data(), state.size(), off, n->fire_times.data(), num * sizeof(double));
+  }
+
+  events = std::move(new_events);
+  to_fire = std::move(new_to_fire);
+  rng = new_rng;
+}
+
 void Network::apply_spike(const Spike& s, bool normalized) 
 {
   Neuron *n;
   double v;
   char buf[24];
-  size_t index;
-  string es;
 
   if (normalized && (s.value < 0 || s.value > 1)) {
     snprintf(buf, 24, "%lg", s.value);
@@ -365,36 +625,170 @@ void Network::apply_spike(const Spike& s, bool normalized)
 
   n = get_neuron(inputs[s.id]);
   if (s.time >= events.size()) events.resize(s.time + 1);
+  v = input_charge(s.value, normalized);
+  events[s.time].push_back(std::make_pair(n,v));
+}
+
+/* The noise.  Mersenne Twister keeps Random_Normal(), so its streams are the same as
+   they've always been.  Xoshiro256** uses MOA's ziggurat (Fill_Normals()), which is
+   faster than Random_Normal()'s polar method.  The ziggurat keeps no state between
+   normals, so save_state() only needs the engine's state. */
+
+double Network::noise(double mean, double stddev)
+{
+  double v;
+
+  if (rng.Get_Engine() == MOA::MT19937) return rng.Random_Normal(mean, stddev);
+  rng.Fill_Normals(&v, 1, mean, stddev);
+  return v;
+}
+
+/* Turn an input spike's value into the charge that it adds to its neuron. */
+
+double Network::input_charge(double value, bool normalized)
+{
+  double v;
+  char buf[24];
+  size_t index;
+  string es;
+
   if (inputs_from_weights) {
     if (!normalized) {
-      index = s.value;
-      if (index >= weights.size()) {
+      if (value < 0 || value >= weights.size()) {
         snprintf(buf, 24, "%d", ((int) weights.size()) - 1);
         es = "risp::Network::apply_spike() - value must be between 0 and ";
         es += buf;
-        snprintf(buf, 24, "%d", (int) index);
+        snprintf(buf, 24, "%lg", value);
         es += ". Value given: ";
         es += buf;
-        throw SRE(buf);
+        throw SRE(es);
       }
+      index = value;
     } else {
-      index = (s.value * weights.size());
+      index = (value * weights.size());
       if (index >= weights.size()) index = weights.size()-1;
     }
     if (stds.size() != 0) {
-      v = rng.Random_Normal(weights[index], stds[index]);
+      v = noise(weights[index], stds[index]);
     } else {
       v = weights[index];
     }
   } else {
     if (normalized) {
-      v = (discrete) ? floor(s.value * spike_value_factor) : s.value * spike_value_factor;
+      v = (discrete) ? floor(value * spike_value_factor) : value * spike_value_factor;
     } else {
-      v = s.value;
+      v = value;
     }
   }
-  if (noisy_stddev != 0) v = rng.Random_Normal(v, noisy_stddev);
-  events[s.time].push_back(std::make_pair(n,v));
+  if (noisy_stddev != 0) v = noise(v, noisy_stddev);
+  return v;
+}
+
+/* The bulk version of apply_spike(), for spikes begin to end-1 of a SpikeBatch.  Every
+   spike is checked first, so that either all of them are applied, or none are.  Then
+   the event buffer is grown once, and the input neurons come from input_neurons rather
+   than from the hash table.  The charges, and the random numbers of noisy networks,
+   are exactly what apply_spike() would give, spike by spike. */
+
+void Network::apply_spikes(const SpikeBatch &batch, size_t begin, size_t end)
+{
+  size_t i;
+  int32_t max_time;
+  double v;
+  char buf[200];
+
+  if (batch.times.size() != batch.ids.size() || batch.values.size() != batch.ids.size() ||
+      end > batch.ids.size() || begin > end) {
+    throw SRE("risp::Network::apply_spikes() - bad SpikeBatch (its vectors differ in size) or range.");
+  }
+
+  if (input_neurons.size() != inputs.size()) {
+    input_neurons.resize(inputs.size());
+    for (i = 0; i < inputs.size(); i++) {
+      input_neurons[i] = (inputs[i] == -1) ? NULL : get_neuron(inputs[i]);
+    }
+  }
+
+  max_time = -1;
+  for (i = begin; i < end; i++) {
+    if (!is_valid_input_id(batch.ids[i])) {
+      snprintf(buf, 200, "risp::Network::apply_spikes() - input_id %d is not valid", batch.ids[i]);
+      throw SRE((string) buf);
+    }
+    if (batch.times[i] < 0) {
+      snprintf(buf, 200, "risp::Network::apply_spikes() - time %d is negative", batch.times[i]);
+      throw SRE((string) buf);
+    }
+    v = batch.values[i];
+    if (batch.normalized && (v < 0 || v > 1)) {
+      snprintf(buf, 200, "risp::Network::apply_spikes() - value (%lg) must be in [-1,1].", v);
+      throw SRE((string) buf);
+    }
+    if (inputs_from_weights && !batch.normalized && (v < 0 || v >= weights.size())) {
+      snprintf(buf, 200, "risp::Network::apply_spikes() - value must be between 0 and %d. Value given: %lg",
+               ((int) weights.size()) - 1, v);
+      throw SRE((string) buf);
+    }
+    if (batch.times[i] > max_time) max_time = batch.times[i];
+  }
+
+  if (max_time >= (int32_t) events.size()) events.resize(max_time + 1);
+
+  for (i = begin; i < end; i++) {
+    v = input_charge(batch.values[i], batch.normalized);
+    events[batch.times[i]].push_back(std::make_pair(input_neurons[batch.ids[i]], v));
+  }
+}
+
+/* The streaming ports.  Spikes from the input stream go through apply_spike(), so
+   they're scaled exactly like spikes from apply_spike().  They're checked here first,
+   though, because run() shouldn't throw halfway through:  a bad spike is dropped, and
+   counted with the stream's reject(). */
+
+void Network::open_spike_streams(size_t capacity)
+{
+  delete in_stream;
+  delete out_stream;
+  in_stream = NULL;
+  out_stream = NULL;
+  if (capacity > 0) {
+    in_stream = new SpikeStream(capacity);
+    out_stream = new SpikeStream(capacity);
+  }
+}
+
+SpikeStream *Network::input_stream()
+{
+  return in_stream;
+}
+
+SpikeStream *Network::output_stream()
+{
+  return out_stream;
+}
+
+void Network::drain_input_stream(uint32_t time)
+{
+  StreamSpike ss;
+
+  while (in_stream->pop(ss)) {
+    if (!is_valid_input_id(ss.id) || !(ss.value >= 0 && ss.value <= 1)) {
+      in_stream->reject();
+    } else {
+      apply_spike(Spike(ss.id, time + ss.time, ss.value), true);
+    }
+  }
+}
+
+void Network::stream_fire(Neuron *n, int time)
+{
+  StreamSpike ss;
+
+  if (n->output_id < 0) return;
+  ss.id = n->output_id;
+  ss.time = run_start_time + time;
+  ss.value = 1;
+  out_stream->push(ss);
 }
 
 void Network::clear_tracking_info()
@@ -421,6 +815,7 @@ void Network::run(double duration) {
   if (overall_run_time != 0) clear_tracking_info();
 
   run_time = (run_time_inclusive) ? duration : duration-1;
+  run_start_time = overall_run_time;
   overall_run_time += (run_time+1);
 
   /* expand the event buffer */
@@ -429,6 +824,7 @@ void Network::run(double duration) {
   }
 
   for (i = 0; i <= (uint32_t) run_time; i++) {
+    if (in_stream != NULL) drain_input_stream(i);
     process_events(i);
   }
 
@@ -599,6 +995,98 @@ vector <double> Network::neuron_last_fires() {
   return rv;
 }
 
+/* The buffer versions of the methods above.  They don't allocate memory, unless they
+   throw because the buffer is too small. */
+
+static void check_buffer(const char *method, size_t n, size_t needed)
+{
+  char buf[200];
+
+  if (n < needed) {
+    snprintf(buf, 200, "risp::Network::%s() - the buffer has %lu entries, but %lu are needed.",
+             method, (unsigned long) n, (unsigned long) needed);
+    throw SRE((string) buf);
+  }
+}
+
+size_t Network::output_last_fires(double *buf, size_t n)
+{
+  size_t i, j;
+
+  for (i = 0, j = 0; i < outputs.size(); i++) if (outputs[i] != -1) j++;
+  check_buffer("output_last_fires", n, j);
+
+  for (i = 0, j = 0; i < outputs.size(); i++) {
+    if (outputs[i] != -1) buf[j++] = neuron_map[outputs[i]]->last_fire;
+  }
+  return j;
+}
+
+size_t Network::output_counts(int *buf, size_t n)
+{
+  size_t i, j;
+
+  for (i = 0, j = 0; i < outputs.size(); i++) if (outputs[i] != -1) j++;
+  check_buffer("output_counts", n, j);
+
+  for (i = 0, j = 0; i < outputs.size(); i++) {
+    if (outputs[i] != -1) buf[j++] = neuron_map[outputs[i]]->fire_counts;
+  }
+  return j;
+}
+
+size_t Network::output_vectors(double *times, size_t n, size_t *counts, size_t num_counts)
+{
+  size_t i, j, total;
+  Neuron *nr;
+
+  for (i = 0, j = 0, total = 0; i < outputs.size(); i++) {
+    if (outputs[i] != -1) {
+      j++;
+      total += neuron_map[outputs[i]]->fire_times.size();
+    }
+  }
+  check_buffer("output_vectors", num_counts, j);
+  check_buffer("output_vectors", n, total);
+
+  for (i = 0, j = 0, total = 0; i < outputs.size(); i++) {
+    if (outputs[i] != -1) {
+      nr = neuron_map[outputs[i]];
+      counts[j++] = nr->fire_times.size();
+      std::copy(nr->fire_times.begin(), nr->fire_times.end(), times + total);
+      total += nr->fire_times.size();
+    }
+  }
+  return total;
+}
+
+size_t Network::neuron_counts(int *buf, size_t n)
+{
+  size_t i;
+
+  check_buffer("neuron_counts", n, sorted_neuron_vector.size());
+  for (i = 0; i < sorted_neuron_vector.size(); i++) buf[i] = sorted_neuron_vector[i]->fire_counts;
+  return i;
+}
+
+size_t Network::neuron_last_fires(double *buf, size_t n)
+{
+  size_t i;
+
+  check_buffer("neuron_last_fires", n, sorted_neuron_vector.size());
+  for (i = 0; i < sorted_neuron_vector.size(); i++) buf[i] = sorted_neuron_vector[i]->last_fire;
+  return i;
+}
+
+size_t Network::neuron_charges(double *buf, size_t n)
+{
+  size_t i;
+
+  check_buffer("neuron_charges", n, sorted_neuron_vector.size());
+  for (i = 0; i < sorted_neuron_vector.size(); i++) buf[i] = sorted_neuron_vector[i]->charge;
+  return i;
+}
+
 void Network::synapse_weights(vector <uint32_t> &pres,
                               vector <uint32_t> &posts,
                               vector <double> &vals) {
@@ -619,6 +1107,315 @@ void Network::synapse_weights(vector <uint32_t> &pres,
   }
 }
 
+/* The synapse map lets set_synapse_weights() find a synapse in constant time.
+   It's only built the first time that it's needed, since most networks never
+   have their weights changed after they're loaded. */
+
+static inline uint64_t synapse_key(uint32_t from_id, uint32_t to_id)
+{
+  return (((uint64_t) from_id) << 32) | to_id;
+}
+
+void Network::make_synapse_map()
+{
+  size_t i, j;
+  Neuron *n;
+
+  synapse_map.clear();
+  for (i = 0; i < sorted_neuron_vector.size(); i++) {
+    n = sorted_neuron_vector[i];
+    for (j = 0; j < n->synapses.size(); j++) {
+      synapse_map[synapse_key(n->id, n->synapses[j]->to->id)] = n->synapses[j];
+    }
+  }
+}
+
+/* If the synapse map hasn't been built, this looks through from's synapses instead,
+   which is faster when there are only a few to find.  It returns NULL if the synapse
+   isn't there. */
+
+Synapse *Network::find_synapse(uint32_t from_id, uint32_t to_id)
+{
+  unordered_map <uint64_t, Synapse*>::const_iterator it;
+  Neuron *n;
+  size_t i;
+
+  if (!synapse_map.empty()) {
+    it = synapse_map.find(synapse_key(from_id, to_id));
+    return (it == synapse_map.end()) ? NULL : it->second;
+  }
+  n = get_neuron(from_id);
+  for (i = 0; i < n->synapses.size(); i++) {
+    if (n->synapses[i]->to->id == to_id) return n->synapses[i];
+  }
+  return NULL;
+}
+
+/* Both of these find all of the synapses/neurons first, so that if one is missing,
+   the network isn't changed. */
+
+void Network::set_synapse_weights(const vector <uint32_t> &pres,
+                                  const vector <uint32_t> &posts,
+                                  const vector <double> &vals)
+{
+  size_t i;
+  vector <Synapse *> syns;
+  unordered_map <uint64_t, Synapse*>::const_iterator it;
+  char buf[200];
+
+  if (pres.size() != posts.size() || pres.size() != vals.size()) {
+    throw SRE("risp::Network::set_synapse_weights() - pres, posts and vals must be the same size");
+  }
+  if (synapse_map.empty()) make_synapse_map();
+
+  syns.resize(pres.size());
+  for (i = 0; i < pres.size(); i++) {
+    it = synapse_map.find(synapse_key(pres[i], posts[i]));
+    if (it == synapse_map.end()) {
+      snprintf(buf, 200, "risp::Network::set_synapse_weights() - no synapse from %u to %u",
+               pres[i], posts[i]);
+      throw SRE((string) buf);
+    }
+    syns[i] = it->second;
+  }
+
+  for (i = 0; i < syns.size(); i++) syns[i]->weight = vals[i];
+}
+
+void Network::set_neuron_thresholds(const vector <uint32_t> &ids, const vector <double> &vals)
+{
+  size_t i;
+  vector <Neuron *> ns;
+
+  if (ids.size() != vals.size()) {
+    throw SRE("risp::Network::set_neuron_thresholds() - ids and vals must be the same size");
+  }
+
+  ns.resize(ids.size());
+  for (i = 0; i < ids.size(); i++) ns[i] = get_neuron(ids[i]);
+
+  /* This is the same adjustment that add_neuron() makes. */
+
+  for (i = 0; i < ns.size(); i++) {
+    ns[i]->threshold = vals[i];
+    if (!threshold_inclusive) {
+      ns[i]->threshold = (discrete) ? (vals[i]+1) : (vals[i] + 0.0000001);
+    }
+  }
+}
+
+/* This changes the network in place to match a NetworkPatch.  Everything that the patch
+   refers to is checked first, so that a bad patch throws without changing the network.
+   The indices say where each property is in the patch's value vectors (leak_idx is
+   only used when leak_mode is 'c').  The synapse map is kept up to date if it has
+   been built, but this doesn't build it.  If neurons are added or removed, sorted_neuron_vector
+   is re-sorted and renumbered, and the removed neurons are purged from the events. */
+
+void Network::apply_patch(const NetworkPatch &patch, int threshold_idx, int leak_idx,
+                          int weight_idx, int delay_idx)
+{
+  size_t i, j;
+  Neuron *n;
+  Synapse *syn;
+  vector <Synapse *> removed_syns, changed_syns;
+  vector <Neuron *> removed_neurons, changed_neurons;
+  unordered_set <uint32_t> removed_ids, added_ids;
+  unordered_set <uint64_t> removed_keys, added_keys;
+  unordered_set <Neuron *> dead;
+  char buf[200];
+
+  input_neurons.clear();    // apply_spikes() rebuilds this when it needs it.
+
+  /* Find everything, and check the patch.  A synapse may be removed and added back,
+     as in neuro::Network::apply_patch(), but nothing may be removed or added twice, and
+     nothing that is removed may be changed. */
+
+  for (i = 0; i < patch.removed_edges.size(); i++) {
+    syn = find_synapse(patch.removed_edges[i].first, patch.removed_edges[i].second);
+    if (syn == NULL) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - no synapse from %u to %u", 
+               patch.removed_edges[i].first, patch.removed_edges[i].second);
+      throw SRE((string) buf);
+    }
+    if (!removed_keys.insert(synapse_key(patch.removed_edges[i].first,
+                                         patch.removed_edges[i].second)).second) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - the synapse from %u to %u is removed twice", 
+               patch.removed_edges[i].first, patch.removed_edges[i].second);
+      throw SRE((string) buf);
+    }
+    removed_syns.push_back(syn);
+  }
+  for (i = 0; i < patch.removed_nodes.size(); i++) {
+    removed_neurons.push_back(get_neuron(patch.removed_nodes[i]));
+    if (!removed_ids.insert(patch.removed_nodes[i]).second) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - node %u is removed twice",
+               patch.removed_nodes[i]);
+      throw SRE((string) buf);
+    }
+  }
+  for (i = 0; i < patch.added_nodes.size(); i++) {
+    if (is_neuron(patch.added_nodes[i].id) || !added_ids.insert(patch.added_nodes[i].id).second) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - node %u is already in the network",
+               patch.added_nodes[i].id);
+      throw SRE((string) buf);
+    }
+  }
+  for (i = 0; i < patch.added_edges.size(); i++) {
+    const NetworkPatch::EdgeValues &e = patch.added_edges[i];
+    if ((!is_neuron(e.from) && added_ids.find(e.from) == added_ids.end()) || 
+        (!is_neuron(e.to) && added_ids.find(e.to) == added_ids.end()) ||
+        removed_ids.find(e.from) != removed_ids.end() ||
+        removed_ids.find(e.to) != removed_ids.end() ||
+        !added_keys.insert(synapse_key(e.from, e.to)).second ||
+        (is_neuron(e.from) && find_synapse(e.from, e.to) != NULL &&
+         removed_keys.find(synapse_key(e.from, e.to)) == removed_keys.end())) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - can't add a synapse from %u to %u",
+               e.from, e.to);
+      throw SRE((string) buf);
+    }
+  }
+  for (i = 0; i < patch.changed_nodes.size(); i++) {
+    if (removed_ids.find(patch.changed_nodes[i].id) != removed_ids.end()) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - node %u is removed and changed",
+               patch.changed_nodes[i].id);
+      throw SRE((string) buf);
+    }
+    changed_neurons.push_back(get_neuron(patch.changed_nodes[i].id));
+  }
+  for (i = 0; i < patch.changed_edges.size(); i++) {
+    syn = find_synapse(patch.changed_edges[i].from, patch.changed_edges[i].to);
+    if (syn == NULL ||
+        removed_keys.find(synapse_key(patch.changed_edges[i].from,
+                                      patch.changed_edges[i].to)) != removed_keys.end() ||
+        removed_ids.find(patch.changed_edges[i].from) != removed_ids.end() ||
+        removed_ids.find(patch.changed_edges[i].to) != removed_ids.end()) {
+      snprintf(buf, 200, "risp::Network::apply_patch() - no synapse from %u to %u",
+               patch.changed_edges[i].from, patch.changed_edges[i].to);
+      throw SRE((string) buf);
+    }
+    changed_syns.push_back(syn);
+  }
+  if (patch.io_changed) {
+    for (i = 0; i < patch.inputs.size() + patch.outputs.size(); i++) {
+      j = (i < patch.inputs.size()) ? patch.inputs[i] : patch.outputs[i - patch.inputs.size()];
+      if (j != (uint32_t) -1 && (removed_ids.find(j) != removed_ids.end() || 
+                                 (!is_neuron(j) && added_ids.find(j) == added_ids.end()))) {
+        snprintf(buf, 200, "risp::Network::apply_patch() - input/output node %u does not exist",
+                 (uint32_t) j);
+        throw SRE((string) buf);
+      }
+    }
+  }
+
+  /* Remove synapses. */
+
+  for (i = 0; i < patch.removed_edges.size(); i++) {
+    n = get_neuron(patch.removed_edges[i].first);
+    syn = removed_syns[i];
+    n->synapses.erase(std::find(n->synapses.begin(), n->synapses.end(), syn));
+    synapse_map.erase(synapse_key(patch.removed_edges[i].first, patch.removed_edges[i].second));
+    delete syn;
+  }
+
+  /* Remove neurons, along with any synapses to or from them that the patch didn't list,
+     and anything in the events or to_fire that refers to them. */
+
+  if (!removed_neurons.empty()) {
+    for (i = 0; i < removed_neurons.size(); i++) dead.insert(removed_neurons[i]);
+
+    for (i = 0; i < sorted_neuron_vector.size(); i++) {
+      n = sorted_neuron_vector[i];
+      for (j = 0; j < n->synapses.size(); j++) {
+        syn = n->synapses[j];
+        if (dead.find(n) != dead.end() || dead.find(syn->to) != dead.end()) {
+          synapse_map.erase(synapse_key(n->id, syn->to->id));
+          delete syn;
+          n->synapses[j] = NULL;
+        }
+      }
+      n->synapses.erase(std::remove(n->synapses.begin(), n->synapses.end(), (Synapse *) NULL),
+                        n->synapses.end());
+    }
+
+    auto is_dead = [&dead](const std::pair <Neuron *, double> &e) 
+                   { return dead.find(e.first) != dead.end(); };
+    for (i = 0; i < events.size(); i++) {
+      events[i].erase(std::remove_if(events[i].begin(), events[i].end(), is_dead), events[i].end());
+    }
+    to_fire.erase(std::remove_if(to_fire.begin(), to_fire.end(),
+                                 [&dead](Neuron *t) { return dead.find(t) != dead.end(); }),
+                  to_fire.end());
+
+    for (i = 0; i < inputs.size(); i++) {
+      if (inputs[i] != -1 && removed_ids.find(inputs[i]) != removed_ids.end()) inputs[i] = -1;
+    }
+    for (i = 0; i < outputs.size(); i++) {
+      if (outputs[i] != -1 && removed_ids.find(outputs[i]) != removed_ids.end()) outputs[i] = -1;
+    }
+
+    for (i = 0; i < removed_neurons.size(); i++) {
+      neuron_map.erase(removed_neurons[i]->id);
+      delete removed_neurons[i];
+    }
+  }
+
+  /* Add neurons, and then redo sorted_neuron_vector. */
+
+  for (i = 0; i < patch.added_nodes.size(); i++) {
+    const vector <double> &v = patch.added_nodes[i].values;
+    add_neuron(patch.added_nodes[i].id, v[threshold_idx],
+               (leak_mode == 'c') ? (v[leak_idx] != 0) : (leak_mode == 'a'));
+  }
+
+  if (!removed_neurons.empty() || !patch.added_nodes.empty()) {
+    sorted_neuron_vector.clear();
+    for (auto &p : neuron_map) sorted_neuron_vector.push_back(p.second);
+    std::sort(sorted_neuron_vector.begin(), sorted_neuron_vector.end(),
+              [](const Neuron *a, const Neuron *b) { return a->id < b->id; });
+    for (i = 0; i < sorted_neuron_vector.size(); i++) sorted_neuron_vector[i]->index = i;
+  }
+
+  /* Add synapses */
+
+  for (i = 0; i < patch.added_edges.size(); i++) {
+    const NetworkPatch::EdgeValues &e = patch.added_edges[i];
+    syn = add_synpase(e.from, e.to, e.values[weight_idx], e.values[delay_idx]);
+    if (!synapse_map.empty()) synapse_map[synapse_key(e.from, e.to)] = syn;
+  }
+
+  /* Changed values.  Thresholds get the same adjustment that add_neuron() makes. */
+
+  for (i = 0; i < changed_neurons.size(); i++) {
+    const vector <double> &v = patch.changed_nodes[i].values;
+    n = changed_neurons[i];
+    n->threshold = v[threshold_idx];
+    if (!threshold_inclusive) {
+      n->threshold = (discrete) ? (n->threshold+1) : (n->threshold + 0.0000001);
+    }
+    if (leak_mode == 'c') n->leak = (v[leak_idx] != 0);
+  }
+  for (i = 0; i < changed_syns.size(); i++) {
+    changed_syns[i]->weight = patch.changed_edges[i].values[weight_idx];
+    changed_syns[i]->delay = patch.changed_edges[i].values[delay_idx];
+  }
+
+  /* New inputs and outputs replace the old ones. */
+
+  if (patch.io_changed) {
+    for (i = 0; i < sorted_neuron_vector.size(); i++) sorted_neuron_vector[i]->output_id = -1;
+    inputs.clear();
+    outputs.clear();
+    for (i = 0; i < patch.inputs.size(); i++) {
+      if (patch.inputs[i] != (uint32_t) -1) add_input(patch.inputs[i], i);
+    }
+    for (i = 0; i < patch.outputs.size(); i++) {
+      if (patch.outputs[i] != (uint32_t) -1) add_output(patch.outputs[i], i);
+    }
+    inputs.resize(patch.inputs.size(), -1);
+    outputs.resize(patch.outputs.size(), -1);
+  }
+}
+
 static bool is_integer(double v)
 {
   int iv;
@@ -671,6 +1468,7 @@ Processor::Processor(json &params)
   fire_like_ravens = false;
   noisy_seed = 0;
   noisy_stddev = 0;
+  noisy_engine = MOA::MT19937;
   inputs_from_weights = false;
 
   /* You don't have to check for these, because they are required in the JSON. */
@@ -759,6 +1557,16 @@ Processor::Processor(json &params)
   if (params.contains("stds")) stds = params["stds"].get< vector <double> >(); 
   if (params.contains("noisy_stddev")) noisy_stddev = params["noisy_stddev"]; 
 
+  if (params.contains("noisy_engine")) {
+    if (params["noisy_engine"] == "mt19937") {
+      noisy_engine = MOA::MT19937;
+    } else if (params["noisy_engine"] == "xoshiro256**") {
+      noisy_engine = MOA::XOSHIRO256SS;
+    } else {
+      throw SRE("Reading processor json - bad noisy_engine.  Must be mt19937 or xoshiro256**");
+    }
+  }
+
   if (leak_mode != "all" && leak_mode != "none" && leak_mode != "configurable") {
     throw SRE("Reading processor json - bad leak_mode.  Must be all, none or configurable");
   }
@@ -823,6 +1631,7 @@ Processor::Processor(json &params)
   saved_params["threshold_inclusive"] = threshold_inclusive;
   if (noisy_seed != 0) saved_params["noisy_seed"] = noisy_seed;
   if (noisy_stddev != 0) saved_params["noisy_stddev"] = noisy_stddev;
+  if (noisy_engine != MOA::MT19937) saved_params["noisy_engine"] = "xoshiro256**";
   if (stds.size() != 0) saved_params["stds"] = stds;
 
 };
@@ -874,6 +1683,7 @@ bool Processor::load_network(neuro::Network* net, int network_id) {
                                inputs_from_weights,
                                noisy_seed, 
                                noisy_stddev,
+                               noisy_engine,
                                weights,
                                stds);
   networks[network_id] = risp_net;
@@ -937,6 +1747,10 @@ void Processor::apply_spikes(const vector<Spike>& s,
   }
 }
 
+void Processor::apply_spikes(const SpikeBatch &batch, int network_id) {
+  get_risp_network(network_id)->apply_spikes(batch, 0, batch.num_spikes());
+}
+
   
 void Processor::run(double duration, int network_id) {
   get_risp_network(network_id)->run(duration);
@@ -1010,6 +1824,31 @@ vector <double> Processor::neuron_last_fires(int network_id) {
   return get_risp_network(network_id)->neuron_last_fires();
 }
 
+size_t Processor::output_last_fires(double *buf, size_t n, int network_id) {
+  return get_risp_network(network_id)->output_last_fires(buf, n);
+}
+
+size_t Processor::output_counts(int *buf, size_t n, int network_id) {
+  return get_risp_network(network_id)->output_counts(buf, n);
+}
+
+size_t Processor::output_vectors(double *times, size_t n, size_t *counts, size_t num_counts,
+                                 int network_id) {
+  return get_risp_network(network_id)->output_vectors(times, n, counts, num_counts);
+}
+
+size_t Processor::neuron_counts(int *buf, size_t n, int network_id) {
+  return get_risp_network(network_id)->neuron_counts(buf, n);
+}
+
+size_t Processor::neuron_last_fires(double *buf, size_t n, int network_id) {
+  return get_risp_network(network_id)->neuron_last_fires(buf, n);
+}
+
+size_t Processor::neuron_charges(double *buf, size_t n, int network_id) {
+  return get_risp_network(network_id)->neuron_charges(buf, n);
+}
+
 void  Processor::synapse_weights(vector <uint32_t> &pres,
                                vector <uint32_t> &posts,
                                vector <double> &vals,
@@ -1019,11 +1858,142 @@ void  Processor::synapse_weights(vector <uint32_t> &pres,
 }
 
 
+/* The processor checks the values against the network properties, and the network
+   checks that the synapses and neurons exist. */
+
+void Processor::set_synapse_weights(const vector <uint32_t> &pres,
+                                    const vector <uint32_t> &posts,
+                                    const vector <double> &vals,
+                                    int network_id)
+{
+  size_t i;
+  risp::Network *risp_net;
+  char buf[200];
+
+  risp_net = get_risp_network(network_id);
+
+  for (i = 0; i < vals.size(); i++) {
+    if (weights.size() > 0) {
+      if (!is_integer(vals[i]) || vals[i] < 0 || vals[i] >= weights.size()) {
+        snprintf(buf, 200, "risp::Processor::set_synapse_weights() - weight %lg must be an "
+                 "index into weights (0 to %d)", vals[i], (int) weights.size() - 1);
+        throw SRE((string) buf);
+      }
+    } else if (vals[i] < min_weight || vals[i] > max_weight || (discrete && !is_integer(vals[i]))) {
+      snprintf(buf, 200, "risp::Processor::set_synapse_weights() - bad weight %lg", vals[i]);
+      throw SRE((string) buf);
+    }
+  }
+  risp_net->set_synapse_weights(pres, posts, vals);
+}
+
+void Processor::set_neuron_thresholds(const vector <uint32_t> &ids,
+                                      const vector <double> &vals,
+                                      int network_id)
+{
+  size_t i;
+  risp::Network *risp_net;
+  char buf[200];
+
+  risp_net = get_risp_network(network_id);
+
+  for (i = 0; i < vals.size(); i++) {
+    if (vals[i] < min_threshold || vals[i] > max_threshold || 
+        (discrete && !is_integer(vals[i]))) {
+      snprintf(buf, 200, "risp::Processor::set_neuron_thresholds() - bad threshold %lg", vals[i]);
+      throw SRE((string) buf);
+    }
+  }
+  risp_net->set_neuron_thresholds(ids, vals);
+}
+
+/* Any patch can be applied in place.  As with load_network(), the values aren't
+   checked against the properties -- just their sizes. */
+
+bool Processor::apply_network_patch(const NetworkPatch &patch, int network_id)
+{
+  risp::Network *risp_net;
+  PropertyPack pp;
+  size_t i;
+
+  risp_net = get_risp_network(network_id);
+  pp = get_network_properties();
+
+  for (i = 0; i < patch.added_nodes.size(); i++) {
+    if (patch.added_nodes[i].values.size() != pp.node_vec_size) {
+      throw SRE("risp::Processor::apply_network_patch() - node values don't match the properties");
+    }
+  }
+  for (i = 0; i < patch.changed_nodes.size(); i++) {
+    if (patch.changed_nodes[i].values.size() != pp.node_vec_size) {
+      throw SRE("risp::Processor::apply_network_patch() - node values don't match the properties");
+    }
+  }
+  for (i = 0; i < patch.added_edges.size(); i++) {
+    if (patch.added_edges[i].values.size() != pp.edge_vec_size) {
+      throw SRE("risp::Processor::apply_network_patch() - edge values don't match the properties");
+    }
+  }
+  for (i = 0; i < patch.changed_edges.size(); i++) {
+    if (patch.changed_edges[i].values.size() != pp.edge_vec_size) {
+      throw SRE("risp::Processor::apply_network_patch() - edge values don't match the properties");
+    }
+  }
+
+  risp_net->apply_patch(patch,
+                        pp.node_handle("Threshold").index,
+                        (leak_mode[0] == 'c') ? pp.node_handle("Leak").index : -1,
+                        pp.edge_handle("Weight").index,
+                        pp.edge_handle("Delay").index);
+  return true;
+}
+
 /* Remove state, keep network loaded */
 void Processor::clear_activity(int network_id) {
   get_risp_network(network_id)->clear_activity();
 }
 
+BatchResult Processor::run_batch(const SpikeBatch &batch, double duration, int network_id) {
+  BatchResult rv;
+
+  get_risp_network(network_id)->run_batch(batch, duration, rv);
+  return rv;
+}
+
+void Processor::clone_network(int src_network_id, int dst_network_id) {
+  risp::Network *risp_net;
+
+  risp_net = get_risp_network(src_network_id);
+  if (src_network_id == dst_network_id) return;
+
+  risp_net = new risp::Network(*risp_net);
+  if (networks.find(dst_network_id) != networks.end()) delete networks[dst_network_id];
+  networks[dst_network_id] = risp_net;
+}
+
+vector <uint8_t> Processor::save_state(int network_id) {
+  vector <uint8_t> state;
+
+  get_risp_network(network_id)->save_state(state);
+  return state;
+}
+
+void Processor::restore_state(const vector <uint8_t> &state, int network_id) {
+  get_risp_network(network_id)->restore_state(state);
+}
+
+void Processor::open_spike_streams(size_t capacity, int network_id) {
+  get_risp_network(network_id)->open_spike_streams(capacity);
+}
+
+SpikeStream *Processor::input_stream(int network_id) {
+  return get_risp_network(network_id)->input_stream();
+}
+
+SpikeStream *Processor::output_stream(int network_id) {
+  return get_risp_network(network_id)->output_stream();
+}
+
 PropertyPack Processor::get_network_properties() const 
 {
   PropertyPack pp;
@@ -1,10 +1,13 @@
 #include "vrisp.hpp"
 #include "framework.hpp"
 #include "utils/alignment_helpers.hpp"
+#include "utils/binary_helpers.hpp"
 #include "utils/json_helpers.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <unordered_set>
 #if defined(RISCVV_FULL) || defined(RISCVV_FIRED) || defined(RISCVV_SYNAPSES)
 #include <riscv_vector.h>
 #endif
@@ -55,6 +58,11 @@ static void set_leak(vector<uint8_t, AlignmentAllocator<uint8_t>>& leak_vec,
     leak_vec[index / 8] |= 1 << (index % 8);
 }
 
+static void clear_leak(vector<uint8_t, AlignmentAllocator<uint8_t>>& leak_vec,
+                       size_t index) {
+    leak_vec[index / 8] &= ~(1 << (index % 8));
+}
+
 Network::Network(neuro::Network* net, double _min_potential, char leak,
                  size_t tracked_timesteps, double _spike_value_factor) {
     leak_mode = leak;
@@ -63,8 +71,18 @@ Network::Network(neuro::Network* net, double _min_potential, char leak,
 
     min_potential = _min_potential;
     current_timestep = 0;
-
-    net->make_sorted_node_vector();
+    in_stream = NULL;
+    out_stream = NULL;
+
+    /* Pull each property out of the network at once, with handles, rather
+     * than looking up its name for every neuron and synapse. */
+    vector<double> thresholds, leaks, weights, delays;
+    net->get_all(net->node_handle("Threshold"), thresholds);
+    if (leak_mode == 'c') {
+        net->get_all(net->node_handle("Leak"), leaks);
+    }
+    net->get_all(net->edge_handle("Weight"), weights);
+    net->get_all(net->edge_handle("Delay"), delays);
 
     neuron_count = net->sorted_node_vector.size() != 0
                        ? net->sorted_node_vector.back()->id + 1
@@ -79,8 +97,9 @@ Network::Network(neuro::Network* net, double _min_potential, char leak,
     output_fire_count.resize(allocation_size, 0);
     output_last_fire_timestep.resize(allocation_size, -1);
     neuron_threshold.resize(allocation_size, INT8_MAX);
-    synapse_to.resize(allocation_size);
-    synapse_delay.resize(allocation_size);
+    shared_ptr<Topology> new_topology(new Topology);
+    new_topology->synapse_to.resize(allocation_size);
+    new_topology->synapse_delay.resize(allocation_size);
     synapse_weight.resize(allocation_size);
     neuron_charge_buffer = (int8_t*)aligned_alloc(
         16, sizeof(*neuron_charge_buffer) * tracked_timesteps_count *
@@ -97,7 +116,7 @@ Network::Network(neuro::Network* net, double _min_potential, char leak,
         neuron_mappings.push_back(node->id);
 
         if (leak_mode == 'c') {
-            if (node->get("Leak") != 0) {
+            if (leaks[i] != 0) {
                 set_leak(neuron_leak, node->id);
             }
         } else {
@@ -106,7 +125,7 @@ Network::Network(neuro::Network* net, double _min_potential, char leak,
             }
         }
 
-        neuron_threshold[node->id] = node->get("Threshold");
+        neuron_threshold[node->id] = thresholds[i];
 
         if (node->is_input()) {
             inputs[node->id] = true;
@@ -125,18 +144,49 @@ Network::Network(neuro::Network* net, double _min_potential, char leak,
         output_mappings.push_back(net->get_output(i)->id);
     }
 
-    /* Add synapses */
+    /* Add synapses.  get_all() goes through the edges in this same order. */
+    size_t k = 0;
     for (EdgeMap::iterator eit = net->edges_begin(); eit != net->edges_end();
-         ++eit) {
+         ++eit, k++) {
         neuro::Edge* edge = eit->second.get();
 
-        synapse_to[edge->from->id].push_back(edge->to->id);
-        synapse_delay[edge->from->id].push_back(edge->get("Delay"));
-        synapse_weight[edge->from->id].push_back(edge->get("Weight"));
+        new_topology->synapse_to[edge->from->id].push_back(edge->to->id);
+        new_topology->synapse_delay[edge->from->id].push_back(delays[k]);
+        synapse_weight[edge->from->id].push_back(weights[k]);
     }
+    topology = new_topology;
 }
 
-Network::~Network() { free(neuron_charge_buffer); }
+/** Everything that can change is copied (the charge buffer with one memcpy), and
+ * the topology is shared with src.  The spike streams aren't copied. */
+Network::Network(const Network& src)
+    : inputs(src.inputs), outputs(src.outputs),
+      input_mappings(src.input_mappings),
+      output_mappings(src.output_mappings),
+      neuron_mappings(src.neuron_mappings), neuron_count(src.neuron_count),
+      allocation_size(src.allocation_size),
+      tracked_timesteps_count(src.tracked_timesteps_count),
+      output_fire_count(src.output_fire_count),
+      output_last_fire_timestep(src.output_last_fire_timestep),
+      neuron_threshold(src.neuron_threshold), topology(src.topology),
+      synapse_weight(src.synapse_weight), neuron_leak(src.neuron_leak),
+      current_timestep(src.current_timestep),
+      min_potential(src.min_potential), leak_mode(src.leak_mode),
+      spike_value_factor(src.spike_value_factor), in_stream(NULL),
+      out_stream(NULL) {
+    size_t bytes;
+
+    bytes = sizeof(*neuron_charge_buffer) * tracked_timesteps_count *
+            allocation_size;
+    neuron_charge_buffer = (int8_t*)aligned_alloc(16, bytes);
+    memcpy(neuron_charge_buffer, src.neuron_charge_buffer, bytes);
+}
+
+Network::~Network() {
+    free(neuron_charge_buffer);
+    delete in_stream;
+    delete out_stream;
+}
 
 void Network::apply_spike(const Spike& s, bool normalized) {
     if (!normalized && !is_integer(s.value)) {
@@ -165,12 +215,61 @@ void Network::apply_spike(const Spike& s, bool normalized) {
                          input_mappings[s.id]] += spike_value;
 }
 
+/* The bulk version of apply_spike(), for spikes begin to end-1 of a SpikeBatch.  The
+   spikes are all checked first, so that either all of them are applied, or none are. */
+void Network::apply_spikes(const SpikeBatch& batch, size_t begin, size_t end) {
+    if (batch.times.size() != batch.ids.size() ||
+        batch.values.size() != batch.ids.size() || end > batch.ids.size() ||
+        begin > end) {
+        throw SRE("vrisp::Network::apply_spikes() - bad SpikeBatch (its "
+                  "vectors differ in size) or range.");
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        double v = batch.values[i];
+
+        if (batch.ids[i] < 0 || (size_t)batch.ids[i] >= input_mappings.size()) {
+            throw SRE("vrisp::Network::apply_spikes() - input_id " +
+                      to_string(batch.ids[i]) + " is not valid");
+        }
+        if (batch.times[i] < 0 ||
+            (size_t)batch.times[i] >= tracked_timesteps_count) {
+            throw SRE("vrisp::Network::apply_spikes() - time (" +
+                      to_string(batch.times[i]) +
+                      ") must be >= 0 and < tracked_timesteps_count (" +
+                      to_string(tracked_timesteps_count) + ")");
+        }
+        if (!batch.normalized && !is_integer(v)) {
+            throw SRE("vrisp::Network::apply_spikes() only supports integer "
+                      "spike values - value (" + to_string(v) +
+                      ") is not valid.");
+        }
+        if (batch.normalized && (v < -1 || v > 1)) {
+            throw SRE("vrisp::Network::apply_spikes() - value (" +
+                      to_string(v) + ") must be in [-1,1].");
+        }
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        double v = batch.values[i];
+        int32_t spike_value = (batch.normalized) ? v * spike_value_factor : v;
+
+        neuron_charge_buffer[((current_timestep + batch.times[i]) %
+                              tracked_timesteps_count) *
+                                 allocation_size +
+                             input_mappings[batch.ids[i]]] += spike_value;
+    }
+}
+
 void Network::run(size_t duration) {
     if (current_timestep != 0) {
         clear_output_tracking();
     }
 
     for (size_t i = 0; i < duration; i++) {
+        if (in_stream != NULL) {
+            drain_input_stream(i);
+        }
         process_events(i);
     }
 
@@ -188,6 +287,10 @@ void Network::run(size_t duration) {
 }
 
 void Network::process_events(uint32_t time) {
+    const vector<vector<uint16_t, AlignmentAllocator<uint16_t>>>& synapse_to =
+        topology->synapse_to;
+    const vector<vector<uint8_t, AlignmentAllocator<uint8_t>>>& synapse_delay =
+        topology->synapse_delay;
 
     size_t internal_timestep =
         (current_timestep + time) % tracked_timesteps_count;
@@ -213,6 +316,9 @@ void Network::process_events(uint32_t time) {
             if (outputs[i]) {
                 output_last_fire_timestep[i] = time;
                 output_fire_count[i]++;
+                if (out_stream != NULL) {
+                    stream_fire(i, time);
+                }
             }
         } else {
             if (!get_leak(neuron_leak, i)) {
@@ -282,6 +388,9 @@ void Network::process_events(uint32_t time) {
             if (outputs[i + j]) {
                 output_last_fire_timestep[i + j] = time;
                 output_fire_count[i + j]++;
+                if (out_stream != NULL) {
+                    stream_fire(i + j, time);
+                }
             }
 
             size_t num_outgoing = synapse_to[i + j].size();
@@ -373,6 +482,9 @@ void Network::process_events(uint32_t time) {
             if (outputs[i + j]) {
                 output_last_fire_timestep[i + j] = time;
                 output_fire_count[i + j]++;
+                if (out_stream != NULL) {
+                    stream_fire(i + j, time);
+                }
             }
 
             for (size_t k = 0; k < synapse_to[i + j].size(); k++) {
@@ -399,6 +511,9 @@ void Network::process_events(uint32_t time) {
             if (outputs[i]) {
                 output_last_fire_timestep[i] = time;
                 output_fire_count[i]++;
+                if (out_stream != NULL) {
+                    stream_fire(i, time);
+                }
             }
 
             size_t num_outgoing = synapse_to[i].size();
@@ -511,8 +626,69 @@ vector<double> Network::neuron_charges() {
 /** synapse_weights() returns three vectors, pres, posts and vals. Each entry
  * represents a synapse weight -- pres[i] is the id of the pre-neuron, posts[i]
  * is the id of the post-neuron, and vas[i] is the weight of the synapse.*/
+/* The buffer versions.  VRISP doesn't track firing times, or neuron counts and last
+   fires, so those write nothing (output_vectors() sets each output's count to 0). */
+
+static void check_buffer(const char* method, size_t n, size_t needed) {
+    if (n < needed) {
+        throw SRE("vrisp::Network::" + string(method) + "() - the buffer has " +
+                  to_string(n) + " entries, but " + to_string(needed) +
+                  " are needed.");
+    }
+}
+
+size_t Network::output_last_fires(double* buf, size_t n) {
+    check_buffer("output_last_fires", n, output_mappings.size());
+    for (size_t i = 0; i < output_mappings.size(); i++) {
+        buf[i] = output_last_fire_timestep[output_mappings[i]];
+    }
+    return output_mappings.size();
+}
+
+size_t Network::output_counts(int* buf, size_t n) {
+    check_buffer("output_counts", n, output_mappings.size());
+    for (size_t i = 0; i < output_mappings.size(); i++) {
+        buf[i] = output_fire_count[output_mappings[i]];
+    }
+    return output_mappings.size();
+}
+
+size_t Network::output_vectors(double* times, size_t n, size_t* counts,
+                               size_t num_counts) {
+    (void)times;
+    (void)n;
+    check_buffer("output_vectors", num_counts, output_mappings.size());
+    for (size_t i = 0; i < output_mappings.size(); i++) counts[i] = 0;
+    return 0;
+}
+
+size_t Network::neuron_counts(int* buf, size_t n) {
+    (void)buf;
+    (void)n;
+    return 0;
+}
+
+size_t Network::neuron_last_fires(double* buf, size_t n) {
+    (void)buf;
+    (void)n;
+    return 0;
+}
+
+size_t Network::neuron_charges(double* buf, size_t n) {
+    size_t row = (current_timestep % tracked_timesteps_count) * allocation_size;
+
+    check_buffer("neuron_charges", n, neuron_mappings.size());
+    for (size_t i = 0; i < neuron_mappings.size(); i++) {
+        buf[i] = neuron_charge_buffer[row + neuron_mappings[i]];
+    }
+    return neuron_mappings.size();
+}
+
 void Network::synapse_weights(vector<uint32_t>& pres, vector<uint32_t>& posts,
                               vector<double>& vals) {
+    const vector<vector<uint16_t, AlignmentAllocator<uint16_t>>>& synapse_to =
+        topology->synapse_to;
+
     pres.clear();
     posts.clear();
     vals.clear();
@@ -527,6 +703,292 @@ void Network::synapse_weights(vector<uint32_t>& pres, vector<uint32_t>& posts,
     }
 }
 
+/** The synapse index maps (from << 32 | to) to the synapse's position in
+ * synapse_to[from].  It's built the first time set_synapse_weights() is called. */
+static inline uint64_t synapse_key(uint32_t from, uint32_t to) {
+    return (((uint64_t)from) << 32) | to;
+}
+
+void Network::make_synapse_index() {
+    const vector<vector<uint16_t, AlignmentAllocator<uint16_t>>>& synapse_to =
+        topology->synapse_to;
+
+    synapse_index.clear();
+    for (size_t i = 0; i < neuron_count; i++) {
+        for (size_t j = 0; j < synapse_to[i].size(); j++) {
+            synapse_index[synapse_key(i, synapse_to[i][j])] = j;
+        }
+    }
+}
+
+bool Network::is_neuron(uint32_t node_id) {
+    return binary_search(neuron_mappings.begin(), neuron_mappings.end(),
+                         (size_t)node_id);
+}
+
+/** These look everything up before changing anything, so an error leaves the
+ * network unchanged. */
+void Network::set_synapse_weights(const vector<uint32_t>& pres,
+                                  const vector<uint32_t>& posts,
+                                  const vector<double>& vals) {
+    unordered_map<uint64_t, uint32_t>::const_iterator it;
+    vector<uint32_t> indices;
+
+    if (pres.size() != posts.size() || pres.size() != vals.size()) {
+        throw SRE("vrisp::Network::set_synapse_weights() - pres, posts and "
+                  "vals must be the same size");
+    }
+    if (synapse_index.empty()) {
+        make_synapse_index();
+    }
+
+    indices.resize(pres.size());
+    for (size_t i = 0; i < pres.size(); i++) {
+        it = synapse_index.find(synapse_key(pres[i], posts[i]));
+        if (it == synapse_index.end()) {
+            throw SRE("vrisp::Network::set_synapse_weights() - no synapse from " +
+                      to_string(pres[i]) + " to " + to_string(posts[i]));
+        }
+        indices[i] = it->second;
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        synapse_weight[pres[i]][indices[i]] = vals[i];
+    }
+}
+
+void Network::set_neuron_thresholds(const vector<uint32_t>& ids,
+                                    const vector<double>& vals) {
+    if (ids.size() != vals.size()) {
+        throw SRE("vrisp::Network::set_neuron_thresholds() - ids and vals "
+                  "must be the same size");
+    }
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (!is_neuron(ids[i])) {
+            throw SRE("vrisp::Network::set_neuron_thresholds() - neuron " +
+                      to_string(ids[i]) + " does not exist");
+        }
+    }
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        neuron_threshold[ids[i]] = vals[i];
+    }
+}
+
+/** Without the synapse index, this searches synapse_to[from], which is quicker
+ * than building the index when there are only a few synapses to find.  It
+ * returns the synapse's position in synapse_to[from], or -1. */
+int Network::find_synapse(uint32_t from, uint32_t to) {
+    unordered_map<uint64_t, uint32_t>::const_iterator it;
+
+    if (from >= neuron_count) {
+        return -1;
+    }
+    const vector<uint16_t, AlignmentAllocator<uint16_t>>& targets =
+        topology->synapse_to[from];
+
+    if (!synapse_index.empty()) {
+        it = synapse_index.find(synapse_key(from, to));
+        return (it == synapse_index.end()) ? -1 : (int)it->second;
+    }
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (targets[i] == to) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** Patches that add or remove neurons, or change the inputs or outputs, would
+ * change the size of everything, so the processor reloads for those.  This does
+ * the rest.  Everything is looked up before anything changes, and a synapse may be
+ * removed and added back, but not removed or added twice.  If synapses are
+ * added or removed, the topology is copied first when it's shared with a clone. */
+void Network::apply_patch(const NetworkPatch& patch, int threshold_idx,
+                          int leak_idx, int weight_idx, int delay_idx) {
+    vector<uint32_t> removed, changed;
+    unordered_set<uint64_t> removed_keys, added_keys;
+    int j;
+    shared_ptr<Topology> t;
+
+    if (patch.structure_changed()) {
+        throw SRE("vrisp::Network::apply_patch() - the patch can't add or "
+                  "remove neurons, or change the inputs or outputs");
+    }
+    for (size_t i = 0; i < patch.removed_edges.size(); i++) {
+        j = find_synapse(patch.removed_edges[i].first,
+                         patch.removed_edges[i].second);
+        if (j < 0) {
+            throw SRE("vrisp::Network::apply_patch() - no synapse from " +
+                      to_string(patch.removed_edges[i].first) + " to " +
+                      to_string(patch.removed_edges[i].second));
+        }
+        if (!removed_keys.insert(synapse_key(patch.removed_edges[i].first,
+                                             patch.removed_edges[i].second)).second) {
+            throw SRE("vrisp::Network::apply_patch() - the synapse from " +
+                      to_string(patch.removed_edges[i].first) + " to " +
+                      to_string(patch.removed_edges[i].second) +
+                      " is removed twice");
+        }
+        removed.push_back(j);
+    }
+    for (size_t i = 0; i < patch.changed_edges.size(); i++) {
+        j = find_synapse(patch.changed_edges[i].from,
+                         patch.changed_edges[i].to);
+        if (j < 0 || removed_keys.count(synapse_key(patch.changed_edges[i].from,
+                                                    patch.changed_edges[i].to))) {
+            throw SRE("vrisp::Network::apply_patch() - no synapse from " +
+                      to_string(patch.changed_edges[i].from) + " to " +
+                      to_string(patch.changed_edges[i].to));
+        }
+        changed.push_back(j);
+    }
+    for (size_t i = 0; i < patch.added_edges.size(); i++) {
+        const NetworkPatch::EdgeValues& e = patch.added_edges[i];
+        if (!is_neuron(e.from) || !is_neuron(e.to) ||
+            !added_keys.insert(synapse_key(e.from, e.to)).second ||
+            (find_synapse(e.from, e.to) >= 0 &&
+             !removed_keys.count(synapse_key(e.from, e.to)))) {
+            throw SRE("vrisp::Network::apply_patch() - can't add a synapse "
+                      "from " + to_string(e.from) + " to " + to_string(e.to));
+        }
+    }
+    for (size_t i = 0; i < patch.changed_nodes.size(); i++) {
+        if (!is_neuron(patch.changed_nodes[i].id)) {
+            throw SRE("vrisp::Network::apply_patch() - neuron " +
+                      to_string(patch.changed_nodes[i].id) +
+                      " does not exist");
+        }
+    }
+
+    /* Values first, while the synapse indices are still good. */
+    for (size_t i = 0; i < changed.size(); i++) {
+        const NetworkPatch::EdgeValues& e = patch.changed_edges[i];
+        synapse_weight[e.from][changed[i]] = e.values[weight_idx];
+    }
+    for (size_t i = 0; i < patch.changed_nodes.size(); i++) {
+        const NetworkPatch::NodeValues& n = patch.changed_nodes[i];
+        neuron_threshold[n.id] = n.values[threshold_idx];
+        if (leak_mode == 'c') {
+            if (n.values[leak_idx] != 0) {
+                set_leak(neuron_leak, n.id);
+            } else {
+                clear_leak(neuron_leak, n.id);
+            }
+        }
+    }
+
+    /* Delays are in the topology, so changing one changes it too. */
+    bool delays_changed = false;
+    for (size_t i = 0; i < changed.size() && !delays_changed; i++) {
+        const NetworkPatch::EdgeValues& e = patch.changed_edges[i];
+        delays_changed = (topology->synapse_delay[e.from][changed[i]] !=
+                          (uint8_t)e.values[delay_idx]);
+    }
+    if (removed.empty() && patch.added_edges.empty() && !delays_changed) {
+        return;
+    }
+
+    if (topology.use_count() == 1) {
+        t = const_pointer_cast<Topology>(topology);
+    } else {
+        t = make_shared<Topology>(*topology);
+        topology = t;
+    }
+
+    for (size_t i = 0; i < changed.size(); i++) {
+        const NetworkPatch::EdgeValues& e = patch.changed_edges[i];
+        t->synapse_delay[e.from][changed[i]] = e.values[delay_idx];
+    }
+
+    /* Removing a synapse moves the last one from the same neuron into its
+     * place, so this looks for each one again. */
+    for (size_t i = 0; i < patch.removed_edges.size(); i++) {
+        uint32_t from = patch.removed_edges[i].first;
+        uint32_t to = patch.removed_edges[i].second;
+        size_t last = t->synapse_to[from].size() - 1;
+
+        j = find_synapse(from, to);
+        if (!synapse_index.empty()) {
+            synapse_index[synapse_key(from, t->synapse_to[from][last])] = j;
+            synapse_index.erase(synapse_key(from, to));
+        }
+        t->synapse_to[from][j] = t->synapse_to[from][last];
+        t->synapse_delay[from][j] = t->synapse_delay[from][last];
+        synapse_weight[from][j] = synapse_weight[from][last];
+        t->synapse_to[from].pop_back();
+        t->synapse_delay[from].pop_back();
+        synapse_weight[from].pop_back();
+    }
+
+    for (size_t i = 0; i < patch.added_edges.size(); i++) {
+        const NetworkPatch::EdgeValues& e = patch.added_edges[i];
+        if (!synapse_index.empty()) {
+            synapse_index[synapse_key(e.from, e.to)] =
+                t->synapse_to[e.from].size();
+        }
+        t->synapse_to[e.from].push_back(e.to);
+        t->synapse_delay[e.from].push_back(e.values[delay_idx]);
+        synapse_weight[e.from].push_back(e.values[weight_idx]);
+    }
+}
+
+/** Streamed input spikes are scaled like apply_spike()'s normalized spikes, but
+ * they go straight into the charge buffer, because apply_spike() only knows about
+ * times relative to the start of run().  A streamed spike that apply_spike() would
+ * reject is dropped, and counted with the stream's reject(), rather than throwing
+ * in the middle of run(). */
+void Network::open_spike_streams(size_t capacity) {
+    delete in_stream;
+    delete out_stream;
+    in_stream = NULL;
+    out_stream = NULL;
+    node_output_ids.clear();
+
+    if (capacity > 0) {
+        in_stream = new SpikeStream(capacity);
+        out_stream = new SpikeStream(capacity);
+        node_output_ids.resize(allocation_size, -1);
+        for (size_t i = 0; i < output_mappings.size(); i++) {
+            node_output_ids[output_mappings[i]] = i;
+        }
+    }
+}
+
+SpikeStream* Network::input_stream() { return in_stream; }
+
+SpikeStream* Network::output_stream() { return out_stream; }
+
+void Network::drain_input_stream(uint32_t time) {
+    StreamSpike ss;
+
+    while (in_stream->pop(ss)) {
+        if (ss.id < 0 || (size_t)ss.id >= input_mappings.size() ||
+            !(ss.value >= -1 && ss.value <= 1) ||
+            (size_t)ss.time >= tracked_timesteps_count) {
+            in_stream->reject();
+            continue;
+        }
+
+        int32_t spike_value = ss.value * spike_value_factor;
+
+        neuron_charge_buffer[((current_timestep + time + ss.time) %
+                              tracked_timesteps_count) *
+                                 allocation_size +
+                             input_mappings[ss.id]] += spike_value;
+    }
+}
+
+void Network::stream_fire(size_t node_id, uint32_t time) {
+    StreamSpike ss;
+
+    ss.id = node_output_ids[node_id];
+    ss.time = current_timestep + time;
+    ss.value = 1;
+    out_stream->push(ss);
+}
+
 void Network::clear_activity() {
     memset(neuron_charge_buffer, 0,
            sizeof(*neuron_charge_buffer) * tracked_timesteps_count *
@@ -539,12 +1001,80 @@ void Network::clear_activity() {
     current_timestep = 0;
 }
 
+/* The same as Processor::run_batch()'s default, without the virtual calls, the
+   conversion of each sample's spikes, or the output vectors. */
+void Network::run_batch(const SpikeBatch& batch, size_t duration,
+                        BatchResult& rv) {
+    size_t n = output_mappings.size();
+
+    rv.resize(batch.num_samples(), n);
+
+    for (size_t i = 0; i < batch.num_samples(); i++) {
+        clear_activity();
+        apply_spikes(batch, batch.sample_begin(i), batch.sample_end(i));
+        run(duration);
+        for (size_t o = 0; o < n; o++) {
+            rv.counts[i * n + o] = output_fire_count[output_mappings[o]];
+            rv.last_fires[i * n + o] =
+                output_last_fire_timestep[output_mappings[o]];
+        }
+    }
+}
+
 void Network::clear_output_tracking() {
     fill(output_last_fire_timestep.begin(), output_last_fire_timestep.end(),
          -1);
     fill(output_fire_count.begin(), output_fire_count.end(), 0);
 }
 
+/** The state blob is a magic number, allocation_size and tracked_timesteps_count
+ * (to make sure that the blob matches the network), current_timestep, and then the
+ * raw charge ring buffer and output tracking vectors. */
+static const uint32_t vrisp_state_magic = 0x50535256; // "VRSP"
+
+void Network::save_state(vector<uint8_t>& state) {
+    state.clear();
+    bin_put(state, vrisp_state_magic);
+    bin_put(state, (uint64_t)allocation_size);
+    bin_put(state, (uint64_t)tracked_timesteps_count);
+    bin_put(state, (uint64_t)current_timestep);
+    bin_put_bytes(state, neuron_charge_buffer,
+                  sizeof(*neuron_charge_buffer) * tracked_timesteps_count *
+                      allocation_size);
+    bin_put_bytes(state, output_fire_count.data(), output_fire_count.size());
+    bin_put_bytes(state, output_last_fire_timestep.data(),
+                  output_last_fire_timestep.size());
+}
+
+void Network::restore_state(const vector<uint8_t>& state) {
+    size_t off = 0;
+    size_t buffer_size = sizeof(*neuron_charge_buffer) *
+                         tracked_timesteps_count * allocation_size;
+    string rsn = "vrisp::Network::restore_state() - ";
+
+    if (state.size() != sizeof(vrisp_state_magic) + 3 * sizeof(uint64_t) +
+                            buffer_size + output_fire_count.size() +
+                            output_last_fire_timestep.size()) {
+        throw SRE(rsn + "the state is the wrong size for this network");
+    }
+    if (bin_get<uint32_t>(state, off) != vrisp_state_magic) {
+        throw SRE(rsn + "the state was not saved by VRISP");
+    }
+    if (bin_get<uint64_t>(state, off) != allocation_size ||
+        bin_get<uint64_t>(state, off) != tracked_timesteps_count) {
+        throw SRE(rsn + "the state was saved from a different network");
+    }
+
+    current_timestep = bin_get<uint64_t>(state, off);
+    bin_get_bytes(state.data(), state.size(), off, neuron_charge_buffer,
+                  buffer_size);
+    bin_get_bytes(state.data(), state.size(), off, output_fire_count.data(),
+                  output_fire_count.size());
+    bin_get_bytes(state.data(), state.size(), off,
+                  output_last_fire_timestep.data(),
+                  output_last_fire_timestep.size());
+}
+
 Processor::Processor(json& params) {
     Parameter_Check_Json_T(params, vrisp_spec);
 
@@ -733,6 +1263,10 @@ void Processor::apply_spikes(const vector<Spike>& s,
     }
 }
 
+void Processor::apply_spikes(const SpikeBatch& batch, int network_id) {
+    get_vrisp_network(network_id)->apply_spikes(batch, 0, batch.num_spikes());
+}
+
 void Processor::run(double duration, int network_id) {
     if (duration < 0) {
         throw SRE("vrisp::Processor::run called with a negative duration (" +
@@ -815,15 +1349,177 @@ vector<double> Processor::neuron_last_fires(int network_id) {
     return get_vrisp_network(network_id)->neuron_last_fires();
 }
 
+size_t Processor::output_last_fires(double* buf, size_t n, int network_id) {
+    return get_vrisp_network(network_id)->output_last_fires(buf, n);
+}
+
+size_t Processor::output_counts(int* buf, size_t n, int network_id) {
+    return get_vrisp_network(network_id)->output_counts(buf, n);
+}
+
+size_t Processor::output_vectors(double* times, size_t n, size_t* counts,
+                                 size_t num_counts, int network_id) {
+    return get_vrisp_network(network_id)->output_vectors(times, n, counts,
+                                                         num_counts);
+}
+
+size_t Processor::neuron_counts(int* buf, size_t n, int network_id) {
+    return get_vrisp_network(network_id)->neuron_counts(buf, n);
+}
+
+size_t Processor::neuron_last_fires(double* buf, size_t n, int network_id) {
+    return get_vrisp_network(network_id)->neuron_last_fires(buf, n);
+}
+
+size_t Processor::neuron_charges(double* buf, size_t n, int network_id) {
+    return get_vrisp_network(network_id)->neuron_charges(buf, n);
+}
+
 void Processor::synapse_weights(vector<uint32_t>& pre, vector<uint32_t>& posts,
                                 vector<double>& vals, int network_id) {
     return get_vrisp_network(network_id)->synapse_weights(pre, posts, vals);
 }
 
+/** Weights and thresholds are stored as int8_t's, so they have to be integers
+ * within the processor's ranges. */
+void Processor::set_synapse_weights(const vector<uint32_t>& pres,
+                                    const vector<uint32_t>& posts,
+                                    const vector<double>& vals,
+                                    int network_id) {
+    vrisp::Network* vrisp_net = get_vrisp_network(network_id);
+
+    for (size_t i = 0; i < vals.size(); i++) {
+        if (!is_integer(vals[i]) || vals[i] < min_weight ||
+            vals[i] > max_weight) {
+            throw SRE("vrisp::Processor::set_synapse_weights() - weight (" +
+                      to_string(vals[i]) + ") must be an integer in [" +
+                      to_string((int)min_weight) + "," +
+                      to_string((int)max_weight) + "]");
+        }
+    }
+    vrisp_net->set_synapse_weights(pres, posts, vals);
+}
+
+void Processor::set_neuron_thresholds(const vector<uint32_t>& ids,
+                                      const vector<double>& vals,
+                                      int network_id) {
+    vrisp::Network* vrisp_net = get_vrisp_network(network_id);
+
+    for (size_t i = 0; i < vals.size(); i++) {
+        if (!is_integer(vals[i]) || vals[i] < min_threshold ||
+            vals[i] > max_threshold) {
+            throw SRE("vrisp::Processor::set_neuron_thresholds() - threshold (" +
+                      to_string(vals[i]) + ") must be an integer in [" +
+                      to_string((int)min_threshold) + "," +
+                      to_string((int)max_threshold) + "]");
+        }
+    }
+    vrisp_net->set_neuron_thresholds(ids, vals);
+}
+
+/** Patches that change the neurons or the inputs and outputs return false, so
+ * that the caller reloads.  The values are checked like set_synapse_weights(). */
+bool Processor::apply_network_patch(const NetworkPatch& patch,
+                                    int network_id) {
+    vrisp::Network* vrisp_net = get_vrisp_network(network_id);
+    PropertyPack pp = get_network_properties();
+    int threshold_idx = pp.node_handle("Threshold").index;
+    int leak_idx = (leak_mode[0] == 'c') ? pp.node_handle("Leak").index : -1;
+    int weight_idx = pp.edge_handle("Weight").index;
+    int delay_idx = pp.edge_handle("Delay").index;
+
+    if (patch.structure_changed()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < patch.changed_nodes.size(); i++) {
+        const vector<double>& v = patch.changed_nodes[i].values;
+        if (v.size() != pp.node_vec_size || !is_integer(v[threshold_idx]) ||
+            v[threshold_idx] < min_threshold ||
+            v[threshold_idx] > max_threshold) {
+            throw SRE("vrisp::Processor::apply_network_patch() - bad values "
+                      "for neuron " + to_string(patch.changed_nodes[i].id));
+        }
+    }
+    for (size_t i = 0; i < patch.added_edges.size() + patch.changed_edges.size();
+         i++) {
+        const NetworkPatch::EdgeValues& e =
+            (i < patch.added_edges.size())
+                ? patch.added_edges[i]
+                : patch.changed_edges[i - patch.added_edges.size()];
+        if (e.values.size() != pp.edge_vec_size ||
+            !is_integer(e.values[weight_idx]) ||
+            e.values[weight_idx] < min_weight ||
+            e.values[weight_idx] > max_weight ||
+            !is_integer(e.values[delay_idx]) ||
+            e.values[delay_idx] < min_delay ||
+            e.values[delay_idx] > max_delay) {
+            throw SRE("vrisp::Processor::apply_network_patch() - bad values "
+                      "for the synapse from " + to_string(e.from) + " to " +
+                      to_string(e.to));
+        }
+    }
+
+    vrisp_net->apply_patch(patch, threshold_idx, leak_idx, weight_idx,
+                           delay_idx);
+    return true;
+}
+
 void Processor::clear_activity(int network_id) {
     get_vrisp_network(network_id)->clear_activity();
 }
 
+BatchResult Processor::run_batch(const SpikeBatch& batch, double duration,
+                                 int network_id) {
+    BatchResult rv;
+
+    if (duration < 0) {
+        throw SRE("vrisp::Processor::run_batch called with a negative duration (" +
+                  to_string(duration) + ").");
+    }
+
+    get_vrisp_network(network_id)->run_batch(
+        batch, static_cast<size_t>(duration), rv);
+    return rv;
+}
+
+void Processor::clone_network(int src_network_id, int dst_network_id) {
+    vrisp::Network* vrisp_net = get_vrisp_network(src_network_id);
+
+    if (src_network_id == dst_network_id) {
+        return;
+    }
+
+    vrisp_net = new vrisp::Network(*vrisp_net);
+    if (networks.find(dst_network_id) != networks.end()) {
+        delete networks[dst_network_id];
+    }
+    networks[dst_network_id] = vrisp_net;
+}
+
+vector<uint8_t> Processor::save_state(int network_id) {
+    vector<uint8_t> state;
+
+    get_vrisp_network(network_id)->save_state(state);
+    return state;
+}
+
+void Processor::restore_state(const vector<uint8_t>& state, int network_id) {
+    get_vrisp_network(network_id)->restore_state(state);
+}
+
+void Processor::open_spike_streams(size_t capacity, int network_id) {
+    get_vrisp_network(network_id)->open_spike_streams(capacity);
+}
+
+SpikeStream* Processor::input_stream(int network_id) {
+    return get_vrisp_network(network_id)->input_stream();
+}
+
+SpikeStream* Processor::output_stream(int network_id) {
+    return get_vrisp_network(network_id)->output_stream();
+}
+
 PropertyPack Processor::get_network_properties() const {
     PropertyPack pp;
 
@@ -0,0 +1 @@
+sed 's/none/all/' params/risp_f_plus.txt
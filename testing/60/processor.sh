@@ -0,0 +1 @@
+sed '/min_weight/s/$/ "noisy_stddev": 0.01, "noisy_seed": 1, "noisy_engine": "xoshiro256**",/' params/risp_f.txt
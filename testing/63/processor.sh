@@ -0,0 +1 @@
+cat params/risp_f_plus.txt
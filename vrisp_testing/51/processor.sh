@@ -0,0 +1 @@
+sed 's/none/all/' params/vrisp_15_plus.json | sed 's/1.0/15.0/'
@@ -0,0 +1 @@
+sed 's/1.0/15.0/' params/vrisp_15_plus.json